@@ -0,0 +1,177 @@
+#pragma once
+
+// Minimal benchmark harness: timed loops with heap allocation counting.
+// Include from exactly one translation unit per binary, before any Metro
+// header; it turns on METRO_TRACK_ALLOCATIONS so the global operator new
+// hook from alloc_tracker.h counts allocations by request phase.
+
+#ifndef METRO_TRACK_ALLOCATIONS
+#define METRO_TRACK_ALLOCATIONS
+#endif
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "alloc_tracker.h"
+
+namespace Bench {
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Measures one operation. The body receives a State and calls
+   * `state.start()` / `state.stop()` around the measured part when it has
+   * per-iteration setup that must not be counted (e.g. feeding a socket).
+   */
+  class State {
+    public:
+    using Tracker = Metro::AllocationTracker;
+
+    void start() {
+      atStart_ = Tracker::thread();
+      startedAt_ = Clock::now();
+    }
+
+    void stop() {
+      elapsed_ += Clock::now() - startedAt_;
+      auto now = Tracker::thread();
+      for (size_t i = 0; i < Tracker::PHASES; ++i) {
+        phases_[i].allocations += now[i].allocations - atStart_[i].allocations;
+        phases_[i].bytes += now[i].bytes - atStart_[i].bytes;
+      }
+    }
+
+    Clock::duration elapsed() const { return elapsed_; }
+    const Tracker::Snapshot& phases() const { return phases_; }
+
+    uint64_t allocationCount() const {
+      uint64_t total = 0;
+      for (const auto& phase : phases_) total += phase.allocations;
+      return total;
+    }
+
+    uint64_t allocationBytes() const {
+      uint64_t total = 0;
+      for (const auto& phase : phases_) total += phase.bytes;
+      return total;
+    }
+
+    private:
+    Clock::time_point startedAt_;
+    Clock::duration elapsed_{};
+    Tracker::Snapshot atStart_{};
+    Tracker::Snapshot phases_{};
+  };
+
+  struct Case {
+    std::string name;
+    std::function<void(State&)> body;
+  };
+
+  inline std::vector<Case>& registry() {
+    static std::vector<Case> cases;
+    return cases;
+  }
+
+  inline void add(std::string name, std::function<void(State&)> body) {
+    registry().push_back({std::move(name), std::move(body)});
+  }
+
+  // Runs each case matching `filter` (substring) for roughly `targetMs` after a short warm-up
+  inline int run(const char* filter, int targetMs = 300) {
+    std::printf("%-44s %12s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op", "bytes/op");
+
+    for (auto& benchCase : registry()) {
+      if (filter && benchCase.name.find(filter) == std::string::npos) continue;
+
+      for (int i = 0; i < 100; ++i) {
+        State warmup;
+        benchCase.body(warmup);
+      }
+
+      State state;
+      uint64_t iterations = 0;
+      auto deadline = Clock::now() + std::chrono::milliseconds(targetMs);
+      while (Clock::now() < deadline) {
+        for (int i = 0; i < 64; ++i) benchCase.body(state);
+        iterations += 64;
+      }
+
+      double ns = std::chrono::duration<double, std::nano>(state.elapsed()).count() / static_cast<double>(iterations);
+      std::printf("%-44s %12llu %12.1f %12.2f %12.1f\n",
+        benchCase.name.c_str(),
+        static_cast<unsigned long long>(iterations),
+        ns,
+        static_cast<double>(state.allocationCount()) / static_cast<double>(iterations),
+        static_cast<double>(state.allocationBytes()) / static_cast<double>(iterations));
+
+      // Cases that run through the server also get allocs/op per request phase
+      const auto& phases = state.phases();
+      if (state.allocationCount() != phases[0].allocations) {
+        std::printf("  %-42s", "phases (allocs/op)");
+        for (size_t i = 0; i < State::Tracker::PHASES; ++i) {
+          std::printf(" %s=%.2f",
+            State::Tracker::name(static_cast<State::Tracker::Phase>(i)),
+            static_cast<double>(phases[i].allocations) / static_cast<double>(iterations));
+        }
+        std::printf("\n");
+      }
+    }
+    return 0;
+  }
+
+  // Connected AF_UNIX stream pair standing in for a client connection
+  class SocketPair {
+    public:
+    SocketPair() {
+      if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds_) < 0) {
+        std::perror("socketpair");
+        std::exit(1);
+      }
+      int size = 4 * 1024 * 1024;
+      setsockopt(fds_[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+      setsockopt(fds_[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+
+    ~SocketPair() {
+      close(fds_[0]);
+      close(fds_[1]);
+    }
+
+    SocketPair(const SocketPair&) = delete;
+    SocketPair& operator=(const SocketPair&) = delete;
+
+    int client() const { return fds_[0]; }
+    int server() const { return fds_[1]; }
+
+    void send(const std::string& bytes) const {
+      size_t offset = 0;
+      while (offset < bytes.size()) {
+        ssize_t written = ::write(fds_[0], bytes.data() + offset, bytes.size() - offset);
+        if (written <= 0) std::exit(1);
+        offset += static_cast<size_t>(written);
+      }
+    }
+
+    // Reads whatever the server side wrote; returns the byte count
+    size_t drain() const {
+      char buffer[65536];
+      size_t total = 0;
+      while (true) {
+        ssize_t got = recv(fds_[0], buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (got <= 0) return total;
+        total += static_cast<size_t>(got);
+      }
+    }
+
+    private:
+    int fds_[2];
+  };
+}
@@ -0,0 +1,473 @@
+// HTTP/1.1 load generator with coordinated-omission-corrected latency.
+//
+// Open-loop mode (--rate > 0) schedules every request at a fixed interval per
+// connection and measures latency from the *intended* send time, so a stalled
+// server is charged for the requests it delayed (as wrk2 does). Closed-loop
+// mode (--rate 0) sends as fast as responses arrive.
+//
+//   bin/loadgen --url http://127.0.0.1:3012/keepalive-test --rate 5000
+//               --connections 4 --threads 2 --duration 10 --pipeline 1
+//
+// (one command line). --pipeline keeps that many requests in flight per
+// connection; Metro answers pipelined requests in order.
+//
+// Prints a JSON report on stdout.
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Log-linear histogram of nanosecond values in the HdrHistogram layout:
+   * values below 2048 are exact, above that each power of two is split into
+   * 1024 linear sub-buckets (< 0.1% relative error).
+   */
+  class Histogram {
+    public:
+    static constexpr int SUB_BITS = 11;
+    static constexpr uint64_t SUB_COUNT = uint64_t(1) << SUB_BITS;
+    static constexpr uint64_t HALF_COUNT = SUB_COUNT / 2;
+    static constexpr int MAX_SHIFT = 40;
+
+    Histogram() : counts_(SUB_COUNT + MAX_SHIFT * HALF_COUNT, 0) {}
+
+    void record(uint64_t value) {
+      counts_[index(value)]++;
+      total_++;
+      max_ = std::max(max_, value);
+      sum_ += static_cast<double>(value);
+    }
+
+    void merge(const Histogram& other) {
+      for (size_t i = 0; i < counts_.size(); ++i) counts_[i] += other.counts_[i];
+      total_ += other.total_;
+      max_ = std::max(max_, other.max_);
+      sum_ += other.sum_;
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t max() const { return max_; }
+    double mean() const { return total_ ? sum_ / static_cast<double>(total_) : 0.0; }
+
+    uint64_t percentile(double percent) const {
+      if (total_ == 0) return 0;
+      uint64_t rank = static_cast<uint64_t>(std::ceil(percent / 100.0 * static_cast<double>(total_)));
+      rank = std::max<uint64_t>(rank, 1);
+
+      uint64_t seen = 0;
+      for (size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (seen >= rank) return std::min(highest(i), max_);
+      }
+      return max_;
+    }
+
+    private:
+    std::vector<uint64_t> counts_;
+    uint64_t total_ = 0;
+    uint64_t max_ = 0;
+    double sum_ = 0;
+
+    static size_t index(uint64_t value) {
+      if (value < SUB_COUNT) return static_cast<size_t>(value);
+
+      int shift = (63 - __builtin_clzll(value)) - (SUB_BITS - 1);
+      shift = std::min(shift, MAX_SHIFT);
+      uint64_t sub = std::min<uint64_t>(value >> shift, SUB_COUNT - 1);
+      return static_cast<size_t>(SUB_COUNT + (shift - 1) * HALF_COUNT + (sub - HALF_COUNT));
+    }
+
+    // Largest value mapping to bucket `i`
+    static uint64_t highest(size_t i) {
+      if (i < SUB_COUNT) return i;
+      uint64_t offset = i - SUB_COUNT;
+      int shift = static_cast<int>(offset / HALF_COUNT) + 1;
+      uint64_t sub = offset % HALF_COUNT + HALF_COUNT;
+      return ((sub + 1) << shift) - 1;
+    }
+  };
+
+  struct Options {
+    std::string host = "127.0.0.1";
+    int port = 80;
+    std::string path = "/";
+    std::string method = "GET";
+    std::string body;
+    std::vector<std::string> headers;
+    int connections = 1;
+    int threads = 1;
+    double rate = 0;          // total requests per second, 0 = closed loop
+    double duration = 10;     // seconds measured
+    double warmup = 1;        // seconds discarded before measuring
+    int pipeline = 1;         // requests in flight per connection
+    std::string name;
+  };
+
+  // Incremental HTTP/1.1 response framing: Content-Length, chunked, or no body
+  class ResponseParser {
+    public:
+    // Returns true when a complete response was consumed from `buffer`
+    bool next(std::string& buffer, int& status, bool& closes) {
+      size_t headerEnd = buffer.find("\r\n\r\n");
+      if (headerEnd == std::string::npos) return false;
+
+      std::string head = lower(buffer.substr(0, headerEnd));
+      status = std::atoi(buffer.c_str() + 9);
+      closes = head.find("\r\nconnection: close") != std::string::npos;
+
+      size_t bodyStart = headerEnd + 4;
+      size_t length = 0;
+
+      size_t lengthAt = head.find("\r\ncontent-length:");
+      if (head.find("\r\ntransfer-encoding: chunked") != std::string::npos) {
+        size_t position = bodyStart;
+        while (true) {
+          size_t lineEnd = buffer.find("\r\n", position);
+          if (lineEnd == std::string::npos) return false;
+          size_t chunk = std::strtoull(buffer.c_str() + position, nullptr, 16);
+          position = lineEnd + 2 + chunk + 2;
+          if (position > buffer.size()) return false;
+          if (chunk == 0) break;
+        }
+        buffer.erase(0, position);
+        return true;
+      } else if (lengthAt != std::string::npos) {
+        length = std::strtoull(head.c_str() + lengthAt + 17, nullptr, 10);
+      }
+
+      if (buffer.size() < bodyStart + length) return false;
+      buffer.erase(0, bodyStart + length);
+      return true;
+    }
+
+    private:
+    static std::string lower(std::string text) {
+      for (auto& c : text) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+      return text;
+    }
+  };
+
+  struct Connection {
+    int fd = -1;
+    std::string out;
+    std::string in;
+    std::deque<Clock::time_point> pending;   // intended send time of each request in flight
+    Clock::time_point nextSend;
+    ResponseParser parser;
+  };
+
+  struct Result {
+    Histogram latency;
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    uint64_t non2xx = 0;
+    uint64_t reconnects = 0;
+    uint64_t bytesRead = 0;
+  };
+
+  std::atomic<bool> failedToConnect{false};
+
+  int connectTo(const Options& options) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(options.host.c_str(), std::to_string(options.port).c_str(), &hints, &result) != 0) return -1;
+
+    int fd = -1;
+    for (addrinfo* entry = result; entry; entry = entry->ai_next) {
+      fd = socket(entry->ai_family, entry->ai_socktype, entry->ai_protocol);
+      if (fd < 0) continue;
+      if (::connect(fd, entry->ai_addr, entry->ai_addrlen) == 0) break;
+      close(fd);
+      fd = -1;
+    }
+    freeaddrinfo(result);
+    if (fd < 0) return -1;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+  }
+
+  std::string buildRequest(const Options& options) {
+    std::string request = options.method + " " + options.path + " HTTP/1.1\r\nHost: " + options.host + "\r\n";
+    for (const auto& header : options.headers) request += header + "\r\n";
+    if (!options.body.empty() || options.method == "POST" || options.method == "PUT") {
+      request += "Content-Length: " + std::to_string(options.body.size()) + "\r\n";
+    }
+    return request + "\r\n" + options.body;
+  }
+
+  void runWorker(const Options& options, int connectionCount, double ratePerConnection,
+                 Clock::time_point measureFrom, Clock::time_point stopAt, Result& result) {
+    const std::string request = buildRequest(options);
+    const auto interval = ratePerConnection > 0
+      ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / ratePerConnection))
+      : Clock::duration::zero();
+
+    int epoll = epoll_create1(0);
+    std::vector<std::unique_ptr<Connection>> connections;
+
+    auto open = [&](Connection& connection) {
+      connection.fd = connectTo(options);
+      if (connection.fd < 0) {
+        failedToConnect = true;
+        return false;
+      }
+      epoll_event event{};
+      event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+      event.data.ptr = &connection;
+      epoll_ctl(epoll, EPOLL_CTL_ADD, connection.fd, &event);
+      return true;
+    };
+
+    // `announced`: the last response carried Connection: close
+    auto reset = [&](Connection& connection, bool announced) {
+      epoll_ctl(epoll, EPOLL_CTL_DEL, connection.fd, nullptr);
+      close(connection.fd);
+
+      // Requests pipelined behind an announced close were never processed, so
+      // they are retried on the next connection, keeping their intended send
+      // times; any other request still in flight never got an answer
+      std::deque<Clock::time_point> retry;
+      if (announced) {
+        retry.swap(connection.pending);
+      } else {
+        for (auto intended : connection.pending) {
+          if (intended >= measureFrom) result.errors++;
+        }
+        connection.pending.clear();
+      }
+      connection.out.clear();
+      connection.in.clear();
+      result.reconnects++;
+      if (!open(connection)) return false;
+
+      for (auto intended : retry) {
+        connection.pending.push_back(intended);
+        connection.out += request;
+      }
+      return true;
+    };
+
+    Clock::time_point now = Clock::now();
+    for (int i = 0; i < connectionCount; ++i) {
+      auto connection = std::make_unique<Connection>();
+      // Spread the first sends across one interval so connections do not fire in lockstep
+      connection->nextSend = now + interval * i / std::max(connectionCount, 1);
+      if (!open(*connection)) return;
+      connections.push_back(std::move(connection));
+    }
+
+    std::vector<epoll_event> events(connections.size() + 1);
+    char buffer[65536];
+
+    while ((now = Clock::now()) < stopAt) {
+      Clock::time_point wakeAt = stopAt;
+
+      for (auto& connection : connections) {
+        while (static_cast<int>(connection->pending.size()) < options.pipeline &&
+               (interval == Clock::duration::zero() || connection->nextSend <= now)) {
+          Clock::time_point intended = interval == Clock::duration::zero() ? now : connection->nextSend;
+          connection->pending.push_back(intended);
+          connection->out += request;
+          connection->nextSend = intended + interval;
+        }
+        if (interval != Clock::duration::zero()) wakeAt = std::min(wakeAt, connection->nextSend);
+
+        while (!connection->out.empty()) {
+          ssize_t sent = ::send(connection->fd, connection->out.data(), connection->out.size(), MSG_NOSIGNAL);
+          if (sent <= 0) break;
+          connection->out.erase(0, static_cast<size_t>(sent));
+        }
+      }
+
+      auto waitFor = std::chrono::duration_cast<std::chrono::milliseconds>(wakeAt - now).count();
+      int timeout = interval == Clock::duration::zero() ? 10 : static_cast<int>(std::clamp<long long>(waitFor, 0, 10));
+      int ready = epoll_wait(epoll, events.data(), static_cast<int>(events.size()), timeout);
+
+      for (int i = 0; i < ready; ++i) {
+        Connection& connection = *static_cast<Connection*>(events[i].data.ptr);
+        bool closed = false;
+
+        while (true) {
+          ssize_t got = recv(connection.fd, buffer, sizeof(buffer), 0);
+          if (got > 0) {
+            connection.in.append(buffer, static_cast<size_t>(got));
+            result.bytesRead += static_cast<uint64_t>(got);
+            continue;
+          }
+          if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) closed = true;
+          break;
+        }
+
+        int status = 0;
+        bool closes = false;
+        Clock::time_point completedAt = Clock::now();
+        while (!connection.pending.empty() && connection.parser.next(connection.in, status, closes)) {
+          Clock::time_point intended = connection.pending.front();
+          connection.pending.pop_front();
+
+          if (intended >= measureFrom) {
+            result.latency.record(static_cast<uint64_t>(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(completedAt - intended).count()));
+            result.requests++;
+            if (status < 200 || status >= 400) result.non2xx++;
+          }
+          if (closes) {
+            closed = true;
+            break;
+          }
+        }
+
+        if (closed && !reset(connection, closes)) return;
+      }
+    }
+
+    for (auto& connection : connections) close(connection->fd);
+    close(epoll);
+  }
+
+  bool parseUrl(const std::string& url, Options& options) {
+    const std::string scheme = "http://";
+    if (url.compare(0, scheme.size(), scheme) != 0) return false;
+
+    std::string rest = url.substr(scheme.size());
+    size_t slash = rest.find('/');
+    std::string authority = rest.substr(0, slash);
+    options.path = slash == std::string::npos ? "/" : rest.substr(slash);
+
+    size_t colon = authority.rfind(':');
+    if (colon == std::string::npos) {
+      options.host = authority;
+    } else {
+      options.host = authority.substr(0, colon);
+      options.port = std::atoi(authority.c_str() + colon + 1);
+    }
+    return !options.host.empty() && options.port > 0;
+  }
+
+  void usage() {
+    std::fprintf(stderr,
+      "usage: loadgen --url http://host:port/path [--method GET] [--body text] [--header 'K: V']\n"
+      "               [--connections 1] [--threads 1] [--rate 0] [--duration 10] [--warmup 1]\n"
+      "               [--pipeline 1] [--name scenario]\n");
+    std::exit(2);
+  }
+
+  std::string jsonString(const std::string& value) {
+    std::string out = "\"";
+    for (char c : value) {
+      if (c == '"' || c == '\\') out += '\\';
+      out += c;
+    }
+    return out + "\"";
+  }
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  bool haveUrl = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string flag = argv[i];
+    if (i + 1 >= argc) usage();
+    std::string value = argv[++i];
+
+    if (flag == "--url") haveUrl = parseUrl(value, options);
+    else if (flag == "--method") options.method = value;
+    else if (flag == "--body") options.body = value;
+    else if (flag == "--header") options.headers.push_back(value);
+    else if (flag == "--connections") options.connections = std::max(1, std::atoi(value.c_str()));
+    else if (flag == "--threads") options.threads = std::max(1, std::atoi(value.c_str()));
+    else if (flag == "--rate") options.rate = std::atof(value.c_str());
+    else if (flag == "--duration") options.duration = std::atof(value.c_str());
+    else if (flag == "--warmup") options.warmup = std::atof(value.c_str());
+    else if (flag == "--pipeline") options.pipeline = std::max(1, std::atoi(value.c_str()));
+    else if (flag == "--name") options.name = value;
+    else usage();
+  }
+  if (!haveUrl) usage();
+
+  options.threads = std::min(options.threads, options.connections);
+  double ratePerConnection = options.rate / options.connections;
+
+  auto startedAt = Clock::now();
+  auto measureFrom = startedAt + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.warmup));
+  auto stopAt = measureFrom + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+
+  std::vector<Result> results(options.threads);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < options.threads; ++t) {
+    int count = options.connections / options.threads + (t < options.connections % options.threads ? 1 : 0);
+    workers.emplace_back([&, t, count]() {
+      runWorker(options, count, ratePerConnection, measureFrom, stopAt, results[t]);
+    });
+  }
+  for (auto& worker : workers) worker.join();
+
+  if (failedToConnect) {
+    std::fprintf(stderr, "loadgen: cannot connect to %s:%d\n", options.host.c_str(), options.port);
+    return 1;
+  }
+
+  Result total;
+  for (auto& result : results) {
+    total.latency.merge(result.latency);
+    total.requests += result.requests;
+    total.errors += result.errors;
+    total.non2xx += result.non2xx;
+    total.reconnects += result.reconnects;
+    total.bytesRead += result.bytesRead;
+  }
+
+  auto micros = [](uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+  const Histogram& latency = total.latency;
+
+  std::printf("{\n");
+  if (!options.name.empty()) std::printf("  \"scenario\": %s,\n", jsonString(options.name).c_str());
+  std::printf("  \"url\": %s,\n", jsonString("http://" + options.host + ":" + std::to_string(options.port) + options.path).c_str());
+  std::printf("  \"method\": %s,\n", jsonString(options.method).c_str());
+  std::printf("  \"connections\": %d,\n  \"threads\": %d,\n  \"pipeline\": %d,\n", options.connections, options.threads, options.pipeline);
+  std::printf("  \"target_rate\": %.1f,\n  \"duration_s\": %.3f,\n", options.rate, options.duration);
+  std::printf("  \"coordinated_omission_corrected\": %s,\n", options.rate > 0 ? "true" : "false");
+  std::printf("  \"requests\": %llu,\n", static_cast<unsigned long long>(total.requests));
+  std::printf("  \"throughput_rps\": %.1f,\n", static_cast<double>(total.requests) / options.duration);
+  std::printf("  \"bytes_read\": %llu,\n", static_cast<unsigned long long>(total.bytesRead));
+  std::printf("  \"errors\": %llu,\n  \"non_2xx_3xx\": %llu,\n  \"reconnects\": %llu,\n",
+    static_cast<unsigned long long>(total.errors),
+    static_cast<unsigned long long>(total.non2xx),
+    static_cast<unsigned long long>(total.reconnects));
+  std::printf("  \"latency_us\": {\"mean\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"p99_9\": %.1f, \"max\": %.1f}\n",
+    latency.mean() / 1000.0,
+    micros(latency.percentile(50)),
+    micros(latency.percentile(90)),
+    micros(latency.percentile(99)),
+    micros(latency.percentile(99.9)),
+    micros(latency.max()));
+  std::printf("}\n");
+  return 0;
+}
@@ -0,0 +1,234 @@
+// Microbenchmarks for the request hot path: HttpRequestReader and HttpParser,
+// Router and HttpWriter. Runs in-process over socketpairs, no TCP ports needed.
+// The roundtrip cases drive the whole HttpParser -> App -> HttpWriter path
+// through TestClient.
+//
+//   ./build_bench.sh && bin/micro_bench [filter]
+
+#include <fcntl.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+
+#include "metro.h"
+#include "arena.h"
+#include "config.h"
+#include "http/http_parser.h"
+#include "http/http_writer.h"
+#include "testing.h"
+
+using namespace Metro;
+
+namespace {
+  std::string requestWithHeaders(size_t headerCount) {
+    std::string request = "GET /api/users/42?page=2&sort=name HTTP/1.1\r\nHost: localhost\r\n";
+    for (size_t i = 0; i < headerCount; ++i) {
+      request += "X-Custom-Header-" + std::to_string(i) + ": value-" + std::to_string(i) + "\r\n";
+    }
+    return request + "\r\n";
+  }
+
+  std::string requestWithBody(const std::string& contentType, const std::string& body) {
+    return "POST /api/users HTTP/1.1\r\nHost: localhost\r\nContent-Type: " + contentType +
+           "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+  }
+
+  void registerParser(const Config& config) {
+    struct Canned { const char* name; std::string bytes; };
+    static std::vector<Canned> requests = {
+      {"parser/get_2_headers", requestWithHeaders(1)},
+      {"parser/get_20_headers", requestWithHeaders(19)},
+      {"parser/get_50_headers", requestWithHeaders(49)},
+      {"parser/post_text_1k", requestWithBody("text/plain", std::string(1024, 'a'))},
+      {"parser/post_json", requestWithBody("application/json",
+        R"({"name":"metro","tags":["fast","small"],"nested":{"id":42,"ok":true},"items":[1,2,3,4,5,6,7,8]})")},
+      {"parser/post_form", requestWithBody("application/x-www-form-urlencoded",
+        "name=metro&email=metro%40example.com&age=3&city=Berlin&tags=a%2Cb%2Cc")},
+    };
+
+    static Bench::SocketPair pair;
+    static RequestArena arena;
+    static HttpRequestReader reader;
+    static std::string head;
+    fcntl(pair.server(), F_SETFL, fcntl(pair.server(), F_GETFL, 0) | O_NONBLOCK);
+
+    for (auto& canned : requests) {
+      Bench::add(canned.name, [&canned, &config](Bench::State& state) {
+        pair.send(canned.bytes);
+        // As in Server::beginRequest: request storage comes from the connection arena
+        arena.reset();
+        Context context(arena.resource());
+        HttpFailure failure;
+        state.start();
+        // Gathered as the event loop does, then parsed as beginRequest() does
+        reader.reset(head);
+        reader.receive(pair.server(), head, HttpLimits(config), false);
+        HttpParser::acceptHead(context, reader);
+        HttpParser::parseHead(pair.server(), context, config, head, failure);
+        state.stop();
+      });
+    }
+  }
+
+  void registerRouter(size_t routeCount) {
+    auto router = std::make_shared<Router>();
+    auto paths = std::make_shared<std::vector<std::string>>();
+
+    for (size_t i = 0; i < routeCount; ++i) {
+      std::string base = "/api/v1/resource" + std::to_string(i);
+      router->addRoute(base, Constants::Http_Method::GET, [](Context&) {});
+      router->addRoute(base + "/:id", Constants::Http_Method::GET, [](Context&) {});
+      router->addRoute(base + "/:id/items/:item", Constants::Http_Method::GET, [](Context&) {});
+      paths->push_back(base + "/" + std::to_string(i * 7) + "/items/" + std::to_string(i));
+    }
+
+    auto rng = std::make_shared<std::mt19937>(42);
+    std::string prefix = "router/" + std::to_string(routeCount) + "_routes/";
+
+    Bench::add(prefix + "static", [router, paths, rng](Bench::State& state) {
+      const std::string path = "/api/v1/resource" + std::to_string((*rng)() % paths->size());
+      Context context;
+      state.start();
+      router->matchRoute(path, Constants::Http_Method::GET, context);
+      state.stop();
+    });
+
+    Bench::add(prefix + "two_params", [router, paths, rng](Bench::State& state) {
+      const std::string& path = (*paths)[(*rng)() % paths->size()];
+      Context context;
+      state.start();
+      router->matchRoute(path, Constants::Http_Method::GET, context);
+      state.stop();
+    });
+
+    Bench::add(prefix + "not_found", [router](Bench::State& state) {
+      static const std::string path = "/api/v2/missing/route";
+      Context context;
+      state.start();
+      router->matchRoute(path, Constants::Http_Method::GET, context);
+      state.stop();
+    });
+  }
+
+  void registerWriter(const Config& config) {
+    struct Body { const char* name; std::function<void(Response&)> fill; };
+    static std::vector<Body> bodies = {
+      {"writer/empty", [](Response& res) { res.status(204); }},
+      {"writer/text_small", [](Response& res) { res.text("Hello, World!"); }},
+      {"writer/text_16k", [](Response& res) { res.text(std::string(16 * 1024, 'x')); }},
+      {"writer/json", [](Response& res) {
+        res.json({{"id", 42}, {"name", "metro"}, {"tags", {"fast", "small"}}, {"ok", true}});
+      }},
+      {"writer/custom_headers", [](Response& res) {
+        res.header("Cache-Control", "no-store")
+           .header("X-Request-Id", "8f14e45fceea167a5a36dedd4bea2543")
+           .header("Vary", "Accept-Encoding")
+           .text("ok");
+      }},
+      {"writer/stream_4_chunks", [](Response& res) {
+        res.stream([](Types::Stream::ChunkWriter write) {
+          for (int i = 0; i < 4; ++i) {
+            if (!write("data: chunk\n\n", 13)) return false;
+          }
+          return true;
+        }, 0, "text/event-stream");
+      }},
+    };
+
+    static Bench::SocketPair pair;
+    for (auto& body : bodies) {
+      Bench::add(body.name, [&body, &config](Bench::State& state) {
+        Context context;
+        body.fill(context.res);
+        state.start();
+        HttpWriter::write(pair.server(), context, true, config);
+        state.stop();
+        pair.drain();
+      });
+    }
+  }
+
+  void registerRoundTrip() {
+    static App app;
+    app.get("/plaintext", [](Context& c) { c.res.text("Hello, World!"); });
+    app.get("/users/:id", [](Context& c) { c.res.json({{"id", c.req.params("id")}}); });
+    app.post("/api/users", [](Context& c) { c.res.text(c.req.text()); });
+
+    static HealthCheck health;
+    health.liveness("GET /healthz");
+
+    static TestClient client(app);
+    client.server().setHealthCheck(health);
+    static const std::string plaintext = "GET /plaintext HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    static const std::string params = "GET /users/42 HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n";
+    static const std::string echo = requestWithBody("text/plain", std::string(256, 'e'));
+    static const std::string missing = "GET /wp-login.php HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    static const std::string probe = "GET /healthz HTTP/1.1\r\nHost: localhost\r\nUser-Agent: ELB-HealthChecker/2.0\r\n\r\n";
+
+    Bench::add("roundtrip/plaintext", [](Bench::State& state) {
+      state.start();
+      client.send(plaintext);
+      state.stop();
+    });
+    Bench::add("roundtrip/json_params", [](Bench::State& state) {
+      state.start();
+      client.send(params);
+      state.stop();
+    });
+    Bench::add("roundtrip/post_echo", [](Bench::State& state) {
+      state.start();
+      client.send(echo);
+      state.stop();
+    });
+    Bench::add("roundtrip/not_found", [](Bench::State& state) {
+      state.start();
+      client.send(missing);
+      state.stop();
+    });
+    Bench::add("roundtrip/health_probe", [](Bench::State& state) {
+      state.start();
+      client.send(probe);
+      state.stop();
+    });
+
+    // Same plaintext route behind five pass-through middlewares
+    static App layered;
+    for (int i = 0; i < 5; ++i) {
+      layered.use([](Context&, Next next) { next(); });
+    }
+    layered.get("/plaintext", [](Context& c) { c.res.text("Hello, World!"); });
+    layered.group("/api")
+      .use([](Context&, Next next) { next(); })
+      .get("/plaintext", [](Context& c) { c.res.text("Hello, World!"); });
+
+    static TestClient layeredClient(layered);
+    Bench::add("roundtrip/middleware_5", [](Bench::State& state) {
+      state.start();
+      layeredClient.send(plaintext);
+      state.stop();
+    });
+
+    static const std::string grouped = "GET /api/plaintext HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    Bench::add("roundtrip/middleware_5_group_1", [](Bench::State& state) {
+      state.start();
+      layeredClient.send(grouped);
+      state.stop();
+    });
+  }
+}
+
+int main(int argc, char** argv) {
+  static Config config;
+
+  registerParser(config);
+  registerRouter(10);
+  registerRouter(1000);
+  registerRouter(10000);
+  registerWriter(config);
+  registerRoundTrip();
+
+  return Bench::run(argc > 1 ? argv[1] : nullptr);
+}
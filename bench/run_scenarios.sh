@@ -0,0 +1,80 @@
+#!/bin/sh
+# Runs the load generator against the tests/ servers and writes one JSON
+# report per scenario plus a combined array.
+#
+#   ./build_tests.sh && ./build_bench.sh
+#   bench/run_scenarios.sh [output.json]
+#
+# DURATION, RATE (0 = closed loop), CONNECTIONS and PIPELINE override the defaults.
+set -e
+
+BIN=bin
+OUT=${1:-bin/scenarios.json}
+DURATION=${DURATION:-10}
+WARMUP=${WARMUP:-1}
+RATE=${RATE:-0}
+CONNECTIONS=${CONNECTIONS:-1}
+PIPELINE=${PIPELINE:-1}
+PIDS=""
+
+stop_all() {
+  for pid in $PIDS; do
+    kill "$pid" 2>/dev/null || true
+  done
+  PIDS=""
+}
+
+trap stop_all EXIT
+
+start_server() {
+  "$BIN/$1" >/dev/null 2>&1 &
+  PIDS="$PIDS $!"
+}
+
+wait_for_port() {
+  retries=25
+  while ! curl -s -o /dev/null "http://127.0.0.1:$1/"; do
+    retries=$((retries-1))
+    if [ $retries -le 0 ]; then
+      echo "Port $1 did not open in time" >&2
+      exit 1
+    fi
+    sleep 0.2
+  done
+}
+
+# name | server | port | loadgen arguments
+SCENARIOS="
+plaintext|server_keepalive_test|3012|--url http://127.0.0.1:3012/keepalive-test
+json|server_content_negotiation_test|3009|--url http://127.0.0.1:3009/api/data
+params|server_params_test|3008|--url http://127.0.0.1:3008/users/42/posts/7
+stream|server_stream_test|3007|--url http://127.0.0.1:3007/stream/chunks
+body|server_body_test|3003|--url http://127.0.0.1:3003/echo/json --method POST --header Content-Type:application/json --body {\"name\":\"metro\",\"id\":42}
+"
+
+mkdir -p "$(dirname "$OUT")"
+echo "[" > "$OUT"
+first=1
+
+echo "$SCENARIOS" | while IFS='|' read -r name server port args; do
+  [ -z "$name" ] && continue
+
+  echo "[SCENARIO] $name ($server)" >&2
+  start_server "$server"
+  wait_for_port "$port"
+
+  # shellcheck disable=SC2086
+  report=$("$BIN/loadgen" $args --name "$name" --duration "$DURATION" --warmup "$WARMUP" \
+    --rate "$RATE" --connections "$CONNECTIONS" --pipeline "$PIPELINE")
+  echo "$report" >&2
+
+  if [ $first -eq 0 ]; then echo "," >> "$OUT"; fi
+  echo "$report" >> "$OUT"
+  first=0
+
+  stop_all
+  sleep 0.2
+done
+
+echo "]" >> "$OUT"
+echo "[DONE] $OUT" >&2
@@ -0,0 +1,11 @@
+#!/bin/sh
+set -e
+CXX=${CXX:-g++}
+CXXFLAGS="-std=c++17 -O2 -DNDEBUG -I metro"
+LDLIBS="-lz -pthread"
+mkdir -p bin
+for src in bench/*.cpp; do
+  name=$(basename "$src" .cpp)
+  echo "[BUILD] $name"
+  $CXX $CXXFLAGS "$src" -o "bin/$name" $LDLIBS
+done
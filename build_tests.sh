@@ -2,12 +2,22 @@
 set -e
 
 CXX=${CXX:-g++}
-CXXFLAGS="-std=c++17 -I metro"
+CXXFLAGS="-I metro"
+LDLIBS="-lz"
 
 mkdir -p bin
 
+echo "[EMBED] tests/assets"
+python3 tools/embed_assets.py tests/assets bin/test_assets.cpp --name test_assets --namespace Assets
+
 for src in tests/*.cpp; do
   name=$(basename "$src" .cpp)
+  std="-std=c++17"
+  extra=""
+  case "$name" in
+    server_embedded_test) extra="bin/test_assets.cpp" ;;
+    server_coroutine_test) std="-std=c++20" ;;
+  esac
   echo "[BUILD] $name"
-  $CXX $CXXFLAGS "$src" -o "bin/$name"
+  $CXX $std $CXXFLAGS "$src" $extra -o "bin/$name" $LDLIBS
 done
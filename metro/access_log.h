@@ -0,0 +1,289 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include "ring_buffer.h"
+
+namespace Metro {
+
+  /**
+   * Production access log written off the request path.
+   *
+   * The server fills one fixed-size Record per request (a few stores and a
+   * memcpy of the path) and pushes it into a per-thread lock-free ring. A
+   * background thread drains the rings, encodes them as NDJSON or as raw
+   * binary records, and appends each batch with one write(2) to a file opened
+   * with O_APPEND. Files rotate by size: path -> path.1 -> ... -> path.N.
+   *
+   * Binary files start with the 16-byte header "MTROALOG", uint32 version and
+   * uint32 record size, followed by Record structs in host byte order.
+   */
+  class AccessLog {
+    public:
+    enum class Format { Ndjson, Binary };
+
+    struct Options {
+      std::string path;
+      Format format           = Format::Ndjson;
+      size_t max_file_size    = 64 * 1024 * 1024;
+      int max_files           = 5;        // rotated files kept besides the active one
+      size_t ring_capacity    = 8192;     // records per request thread
+      int flush_interval_ms   = 100;
+    };
+
+    struct Record {
+      static constexpr size_t METHOD_SIZE = 8;
+      static constexpr size_t PATH_SIZE   = 128;
+
+      uint64_t timestamp_ns;              // wall clock, request completion
+      uint64_t bytes_in;
+      uint64_t bytes_out;
+      uint32_t parse_us;
+      uint32_t handler_us;
+      uint32_t write_us;
+      uint32_t request_index;             // 1-based position on its keep-alive connection
+      uint16_t status;
+      uint16_t client_port;
+      uint8_t client_family;              // AF_INET or AF_INET6
+      uint8_t client_address[16];
+      uint8_t path_truncated;
+      uint16_t path_length;
+      char method[METHOD_SIZE];
+      char path[PATH_SIZE];
+
+      void setMethod(const std::string& value) {
+        size_t length = std::min(value.size(), METHOD_SIZE - 1);
+        std::memcpy(method, value.data(), length);
+        method[length] = '\0';
+      }
+
+      void setPath(const std::string& value) {
+        size_t length = std::min(value.size(), PATH_SIZE);
+        std::memcpy(path, value.data(), length);
+        path_length = static_cast<uint16_t>(length);
+        path_truncated = value.size() > PATH_SIZE;
+      }
+
+      void setClient(const sockaddr_storage& address) {
+        client_family = static_cast<uint8_t>(address.ss_family);
+        if (address.ss_family == AF_INET6) {
+          const auto& v6 = reinterpret_cast<const sockaddr_in6&>(address);
+          std::memcpy(client_address, &v6.sin6_addr, 16);
+          client_port = ntohs(v6.sin6_port);
+        } else {
+          const auto& v4 = reinterpret_cast<const sockaddr_in&>(address);
+          std::memcpy(client_address, &v4.sin_addr, 4);
+          client_port = ntohs(v4.sin_port);
+        }
+      }
+    };
+
+    explicit AccessLog(Options options)
+      : options_(std::move(options)), rings_(options_.ring_capacity) {
+      openFile();
+      worker_ = std::thread([this]() { run(); });
+    }
+
+    ~AccessLog() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+      }
+      wake_.notify_one();
+      worker_.join();
+      if (fd_ >= 0) close(fd_);
+    }
+
+    AccessLog(const AccessLog&) = delete;
+    AccessLog& operator=(const AccessLog&) = delete;
+
+    // Never blocks; returns false when the record was dropped
+    bool record(const Record& entry) { return rings_.push(entry); }
+
+    // Records lost to a full ring or to a file that could not be written
+    uint64_t dropped() const { return rings_.dropped() + discarded_.load(std::memory_order_relaxed); }
+    uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+
+    private:
+    static constexpr uint32_t BINARY_VERSION = 1;
+
+    Options options_;
+    ThreadRings<Record> rings_;
+
+    int fd_ = -1;
+    size_t fileSize_ = 0;
+
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> discarded_{0};
+
+    void run() {
+      std::string batch;
+      batch.reserve(256 * 1024);
+
+      while (true) {
+        bool stopping;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          wake_.wait_for(lock, std::chrono::milliseconds(options_.flush_interval_ms), [this]() { return stopping_; });
+          stopping = stopping_;
+        }
+
+        size_t count = rings_.drain([&](const Record& entry) { encode(entry, batch); });
+        if (count > 0) {
+          auto& counter = writeBatch(batch) ? written_ : discarded_;
+          counter.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        if (stopping) return;
+      }
+    }
+
+    void encode(const Record& entry, std::string& out) const {
+      if (options_.format == Format::Binary) {
+        out.append(reinterpret_cast<const char*>(&entry), sizeof(Record));
+        return;
+      }
+
+      char address[INET6_ADDRSTRLEN] = "";
+      inet_ntop(entry.client_family == AF_INET6 ? AF_INET6 : AF_INET, entry.client_address, address, sizeof(address));
+
+      // Method and path come from the request line, so both are escaped rather than formatted
+      char fields[512];
+      int length = std::snprintf(fields, sizeof(fields), "{\"ts\":%llu.%06llu,\"method\":\"",
+        static_cast<unsigned long long>(entry.timestamp_ns / 1'000'000'000ULL),
+        static_cast<unsigned long long>(entry.timestamp_ns % 1'000'000'000ULL / 1'000ULL));
+      out.append(fields, static_cast<size_t>(std::max(length, 0)));
+
+      appendEscaped(out, entry.method, std::strlen(entry.method));
+
+      length = std::snprintf(fields, sizeof(fields),
+        "\",\"status\":%u,\"bytes_in\":%llu,\"bytes_out\":%llu,"
+        "\"parse_us\":%u,\"handler_us\":%u,\"write_us\":%u,\"client\":\"%s\",\"port\":%u,\"request\":%u,\"path\":\"",
+        entry.status,
+        static_cast<unsigned long long>(entry.bytes_in),
+        static_cast<unsigned long long>(entry.bytes_out),
+        entry.parse_us, entry.handler_us, entry.write_us,
+        address, entry.client_port, entry.request_index);
+      out.append(fields, static_cast<size_t>(std::max(length, 0)));
+
+      appendEscaped(out, entry.path, entry.path_length);
+      out += entry.path_truncated ? "\",\"truncated\":true}\n" : "\"}\n";
+    }
+
+    static void appendEscaped(std::string& out, const char* data, size_t length) {
+      static const char* hex = "0123456789abcdef";
+      for (size_t i = 0; i < length; ++i) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c == '"' || c == '\\') {
+          out += '\\';
+          out += static_cast<char>(c);
+        } else if (c < 0x20) {
+          out += "\\u00";
+          out += hex[c >> 4];
+          out += hex[c & 0xf];
+        } else {
+          out += static_cast<char>(c);
+        }
+      }
+    }
+
+    void openFile() {
+      fd_ = ::open(options_.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+      if (fd_ < 0) {
+        throw std::system_error(
+          std::error_code(errno, std::system_category()),
+          "Failed to open access log " + options_.path
+        );
+      }
+
+      struct stat info;
+      fileSize_ = fstat(fd_, &info) == 0 ? static_cast<size_t>(info.st_size) : 0;
+
+      if (fileSize_ == 0 && options_.format == Format::Binary) {
+        char header[16] = {'M', 'T', 'R', 'O', 'A', 'L', 'O', 'G'};
+        uint32_t version = BINARY_VERSION;
+        uint32_t recordSize = sizeof(Record);
+        std::memcpy(header + 8, &version, 4);
+        std::memcpy(header + 12, &recordSize, 4);
+        std::string bytes(header, sizeof(header));
+        writeAll(bytes);
+      }
+    }
+
+    void rotate() {
+      close(fd_);
+      fd_ = -1;
+
+      for (int index = options_.max_files - 1; index >= 1; --index) {
+        std::string from = options_.path + "." + std::to_string(index);
+        std::string to = options_.path + "." + std::to_string(index + 1);
+        std::rename(from.c_str(), to.c_str());
+      }
+
+      if (options_.max_files > 0) {
+        std::rename(options_.path.c_str(), (options_.path + ".1").c_str());
+      } else {
+        unlink(options_.path.c_str());
+      }
+
+      reopen();
+    }
+
+    // Keeps draining rings when the file cannot be opened; its records are discarded
+    void reopen() {
+      try {
+        openFile();
+      } catch (const std::system_error&) {
+        fd_ = -1;
+      }
+    }
+
+    // False when the batch did not reach the file
+    bool writeBatch(std::string& batch) {
+      // A file that failed to open is retried as is: rotating again would push out the kept logs
+      if (fd_ < 0) {
+        reopen();
+      } else if (fileSize_ + batch.size() > options_.max_file_size) {
+        rotate();
+      }
+      bool complete = fd_ >= 0 && writeAll(batch);
+      batch.clear();
+      return complete;
+    }
+
+    bool writeAll(const std::string& bytes) {
+      const char* data = bytes.data();
+      size_t length = bytes.size();
+
+      while (length > 0) {
+        ssize_t written = ::write(fd_, data, length);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        length -= static_cast<size_t>(written);
+        fileSize_ += static_cast<size_t>(written);
+      }
+      return true;
+    }
+  };
+}
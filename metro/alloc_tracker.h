@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace Metro {
+
+  /**
+   * Heap allocation accounting by request phase.
+   *
+   * Opt-in: build with -DMETRO_TRACK_ALLOCATIONS. The server and App tag the
+   * running thread with the current phase (Scope is RAII and nests, so the
+   * innermost phase wins) and the replaced global operator new charges every
+   * allocation to that phase. Counters live in fixed per-thread slots, so the
+   * hook itself never allocates. Without the macro Scope compiles to nothing
+   * and no hook is installed.
+   *
+   * The hooks are defined in this header. A program with several translation
+   * units including Metro must define METRO_NO_ALLOCATION_HOOKS in all but one.
+   */
+  class AllocationTracker {
+    public:
+    enum class Phase : uint8_t { Idle, Parse, Route, Middleware, Handler, Write, Count };
+
+    static constexpr size_t PHASES = static_cast<size_t>(Phase::Count);
+
+    struct Counters {
+      uint64_t allocations = 0;
+      uint64_t bytes = 0;
+    };
+
+    using Snapshot = std::array<Counters, PHASES>;
+
+    static constexpr bool enabled() {
+#ifdef METRO_TRACK_ALLOCATIONS
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    class Scope {
+      public:
+#ifdef METRO_TRACK_ALLOCATIONS
+      explicit Scope(Phase phase) : previous_(current()) { current() = phase; }
+      ~Scope() { current() = previous_; }
+#else
+      explicit Scope(Phase) {}
+#endif
+      Scope(const Scope&) = delete;
+      Scope& operator=(const Scope&) = delete;
+
+#ifdef METRO_TRACK_ALLOCATIONS
+      private:
+      Phase previous_;
+#endif
+    };
+
+    // Called from operator new
+    static void record(size_t size) {
+      Slot& slot = local();
+      size_t phase = static_cast<size_t>(current());
+      slot.allocations[phase].fetch_add(1, std::memory_order_relaxed);
+      slot.bytes[phase].fetch_add(size, std::memory_order_relaxed);
+    }
+
+    static void requestCompleted() {
+      requests().fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Totals over every thread since start
+    static Snapshot totals() {
+      Snapshot snapshot{};
+      size_t used = std::min(nextSlot().load(std::memory_order_acquire), SLOTS);
+      for (size_t i = 0; i < used; ++i) add(snapshot, slots()[i]);
+      return snapshot;
+    }
+
+    // Totals of the calling thread only; what benchmarks diff around an operation
+    static Snapshot thread() {
+      Snapshot snapshot{};
+      add(snapshot, local());
+      return snapshot;
+    }
+
+    static uint64_t requestCount() { return requests().load(std::memory_order_relaxed); }
+
+    static const char* name(Phase phase) {
+      switch (phase) {
+        case Phase::Idle:       return "idle";
+        case Phase::Parse:      return "parse";
+        case Phase::Route:      return "route";
+        case Phase::Middleware: return "middleware";
+        case Phase::Handler:    return "handler";
+        case Phase::Write:      return "write";
+        default:                return "unknown";
+      }
+    }
+
+    private:
+    static constexpr size_t SLOTS = 256;
+
+    struct Slot {
+      std::array<std::atomic<uint64_t>, PHASES> allocations{};
+      std::array<std::atomic<uint64_t>, PHASES> bytes{};
+    };
+
+    static Phase& current() {
+      thread_local Phase phase = Phase::Idle;
+      return phase;
+    }
+
+    // Constant-initialized storage: safe to touch from operator new before main()
+    static Slot* slots() {
+      static Slot storage[SLOTS];
+      return storage;
+    }
+
+    static std::atomic<size_t>& nextSlot() {
+      static std::atomic<size_t> next{0};
+      return next;
+    }
+
+    static std::atomic<uint64_t>& requests() {
+      static std::atomic<uint64_t> count{0};
+      return count;
+    }
+
+    static Slot& local() {
+      // Threads past SLOTS share slots; counters stay correct because updates are atomic
+      thread_local size_t index = nextSlot().fetch_add(1, std::memory_order_acq_rel) % SLOTS;
+      return slots()[index];
+    }
+
+    static void add(Snapshot& snapshot, const Slot& slot) {
+      for (size_t phase = 0; phase < PHASES; ++phase) {
+        snapshot[phase].allocations += slot.allocations[phase].load(std::memory_order_relaxed);
+        snapshot[phase].bytes += slot.bytes[phase].load(std::memory_order_relaxed);
+      }
+    }
+  };
+}
+
+#if defined(METRO_TRACK_ALLOCATIONS) && !defined(METRO_NO_ALLOCATION_HOOKS)
+namespace Metro::AllocationHooks {
+  // Every replacement below goes through this one malloc/free pair. Kept out
+  // of line, so the compiler never sees free() applied to an operator new
+  // result and reports the pair as mismatched (-Wmismatched-new-delete)
+  [[gnu::noinline]] inline void* allocate(std::size_t size, std::size_t align = 0) noexcept {
+    AllocationTracker::record(size);
+    if (size == 0) size = 1;
+    if (align <= alignof(std::max_align_t)) return std::malloc(size);
+    return std::aligned_alloc(align, (size + align - 1) / align * align);
+  }
+
+  [[gnu::noinline]] inline void release(void* pointer) noexcept { std::free(pointer); }
+
+  inline void* allocateOrThrow(std::size_t size, std::size_t align = 0) {
+    if (void* pointer = allocate(size, align)) return pointer;
+    throw std::bad_alloc();
+  }
+}
+
+void* operator new(std::size_t size) { return Metro::AllocationHooks::allocateOrThrow(size); }
+void* operator new[](std::size_t size) { return Metro::AllocationHooks::allocateOrThrow(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return Metro::AllocationHooks::allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return Metro::AllocationHooks::allocate(size); }
+
+// std::pmr::new_delete_resource() allocates through the aligned forms
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return Metro::AllocationHooks::allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return Metro::AllocationHooks::allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return Metro::AllocationHooks::allocate(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return Metro::AllocationHooks::allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept { Metro::AllocationHooks::release(pointer); }
+void operator delete[](void* pointer) noexcept { Metro::AllocationHooks::release(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { Metro::AllocationHooks::release(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { Metro::AllocationHooks::release(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { Metro::AllocationHooks::release(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { Metro::AllocationHooks::release(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { Metro::AllocationHooks::release(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { Metro::AllocationHooks::release(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { Metro::AllocationHooks::release(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { Metro::AllocationHooks::release(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { Metro::AllocationHooks::release(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { Metro::AllocationHooks::release(pointer); }
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+
+namespace Metro {
+
+  /**
+   * Bump allocator for request-scoped data, one per connection.
+   *
+   * Request and response headers, route params and query keys are carved out
+   * of it and never freed individually; reset() drops everything at once
+   * before the next request on the connection. The first INLINE_BYTES live
+   * inside the arena itself, so a typical request reaches malloc only for
+   * bodies and long values; bigger requests spill into heap chunks that
+   * reset() hands back.
+   */
+  class RequestArena {
+    public:
+    static constexpr size_t INLINE_BYTES = 8192;
+
+    RequestArena()
+      : resource_(buffer_.data(), buffer_.size(), std::pmr::new_delete_resource()) {}
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    std::pmr::memory_resource* resource() noexcept { return &resource_; }
+
+    // Everything allocated since the last reset must already be destroyed
+    void reset() noexcept { resource_.release(); }
+
+    private:
+    alignas(std::max_align_t) std::array<std::byte, INLINE_BYTES> buffer_;
+    std::pmr::monotonic_buffer_resource resource_;
+  };
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "ring_buffer.h"
+
+namespace Metro {
+
+  /**
+   * Request logger that keeps all terminal/file I/O off the request path.
+   *
+   * Request threads copy a fixed-size record into their own lock-free ring;
+   * a background thread drains every ring, formats the lines and writes each
+   * batch with a single write(2). When a ring is full the record is dropped
+   * and counted, so logging never blocks request handling.
+   */
+  class AsyncLogger {
+    public:
+    struct Options {
+      int fd                  = STDOUT_FILENO;
+      size_t ring_capacity    = 4096;   // records per request thread
+      int flush_interval_ms   = 50;
+      bool color              = isatty(STDOUT_FILENO) == 1;
+    };
+
+    struct Record {
+      static constexpr size_t METHOD_SIZE = 8;
+      static constexpr size_t PATH_SIZE   = 112;
+
+      char method[METHOD_SIZE];
+      char path[PATH_SIZE];
+      uint16_t path_length;
+      bool path_truncated;
+      int status;
+      uint64_t duration_ns;
+
+      void setMethod(const std::string& value) {
+        size_t length = std::min(value.size(), METHOD_SIZE - 1);
+        std::memcpy(method, value.data(), length);
+        method[length] = '\0';
+      }
+
+      void setPath(const std::string& value) {
+        size_t length = std::min(value.size(), PATH_SIZE);
+        std::memcpy(path, value.data(), length);
+        path_length = static_cast<uint16_t>(length);
+        path_truncated = value.size() > PATH_SIZE;
+      }
+    };
+
+    AsyncLogger() : AsyncLogger(Options()) {}
+
+    explicit AsyncLogger(Options options)
+      : options_(options), rings_(options.ring_capacity) {
+      worker_ = std::thread([this]() { run(); });
+    }
+
+    ~AsyncLogger() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+      }
+      wake_.notify_one();
+      worker_.join();
+    }
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    static AsyncLogger& shared() {
+      static AsyncLogger logger;
+      return logger;
+    }
+
+    // Never blocks; returns false when the record was dropped
+    bool log(const Record& record) { return rings_.push(record); }
+
+    uint64_t dropped() const { return rings_.dropped(); }
+    uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+
+    private:
+    Options options_;
+    ThreadRings<Record> rings_;
+
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+
+    std::atomic<uint64_t> written_{0};
+    uint64_t reportedDrops_ = 0;
+
+    void run() {
+      std::string batch;
+      batch.reserve(64 * 1024);
+
+      while (true) {
+        bool stopping;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          wake_.wait_for(lock, std::chrono::milliseconds(options_.flush_interval_ms), [this]() { return stopping_; });
+          stopping = stopping_;
+        }
+
+        size_t count = rings_.drain([&](const Record& record) { format(record, batch); });
+        appendDropNotice(batch);
+        writeBatch(batch);
+        written_.fetch_add(count, std::memory_order_relaxed);
+
+        if (stopping) return;
+      }
+    }
+
+    void format(const Record& record, std::string& out) const {
+      constexpr const char * GREEN  = "\033[32m";
+      constexpr const char * RED    = "\033[31m";
+      constexpr const char * GRAY   = "\033[90m";
+      constexpr const char * YELLOW = "\033[33m";
+      constexpr const char * BLUE   = "\033[34m";
+      constexpr const char * RESET  = "\033[0m";
+
+      const char* color;
+      if (record.status >= 500) {
+        color = RED;
+      } else if (record.status >= 400) {
+        color = YELLOW;
+      } else if (record.status >= 300) {
+        color = BLUE;
+      } else if (record.status >= 200) {
+        color = GREEN;
+      } else {
+        color = GRAY;
+      }
+
+      char timing[32];
+      double duration_ms = static_cast<double>(record.duration_ns) / 1'000'000.0;
+      if (duration_ms < 1'000.0) {
+        std::snprintf(timing, sizeof(timing), "%.3f ms", duration_ms);
+      } else {
+        std::snprintf(timing, sizeof(timing), "%.3f s", duration_ms / 1'000.0);
+      }
+
+      out += "<-- ";
+      out += record.method;
+      out += ' ';
+      out.append(record.path, record.path_length);
+      if (record.path_truncated) out += "...";
+      out += ' ';
+      if (options_.color) out += color;
+      out += std::to_string(record.status);
+      if (options_.color) out += RESET;
+      out += ' ';
+      out += timing;
+      out += '\n';
+    }
+
+    void appendDropNotice(std::string& out) {
+      uint64_t drops = rings_.dropped();
+      if (drops == reportedDrops_) return;
+
+      out += "[logger] dropped " + std::to_string(drops - reportedDrops_) + " records\n";
+      reportedDrops_ = drops;
+    }
+
+    void writeBatch(std::string& batch) {
+      const char* data = batch.data();
+      size_t length = batch.size();
+
+      while (length > 0) {
+        ssize_t written = ::write(options_.fd, data, length);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) break;
+        data += written;
+        length -= static_cast<size_t>(written);
+      }
+      batch.clear();
+    }
+  };
+}
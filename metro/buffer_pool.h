@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Metro {
+
+  /**
+   * Process-wide free lists of fixed-size byte blocks (recv scratch and the like).
+   *
+   * A connection borrows a block only while it is actually reading a request
+   * and hands it back as soon as the read completes, so idle keep-alive
+   * connections pin no buffer memory and a busy server cycles through a
+   * handful of warm blocks instead of malloc'ing one per request. At most
+   * `maxIdle` blocks are kept; extra returns are freed.
+   *
+   * Blocks are not zeroed on reuse.
+   */
+  class BufferPool {
+    public:
+    // Move-only lease; returns the block to its pool on destruction
+    class Buffer {
+      public:
+      Buffer() = default;
+      ~Buffer() { release(); }
+
+      Buffer(Buffer&& other) noexcept
+        : pool_(other.pool_), data_(std::move(other.data_)), size_(other.size_) {
+        other.pool_ = nullptr;
+        other.size_ = 0;
+      }
+
+      Buffer& operator=(Buffer&& other) noexcept {
+        if (this != &other) {
+          release();
+          pool_ = other.pool_;
+          data_ = std::move(other.data_);
+          size_ = other.size_;
+          other.pool_ = nullptr;
+          other.size_ = 0;
+        }
+        return *this;
+      }
+
+      Buffer(const Buffer&) = delete;
+      Buffer& operator=(const Buffer&) = delete;
+
+      char* data() const noexcept { return data_.get(); }
+      size_t size() const noexcept { return size_; }
+
+      void release() {
+        if (data_ && pool_) pool_->recycle(std::move(data_), size_);
+        data_.reset();
+        size_ = 0;
+      }
+
+      private:
+      friend class BufferPool;
+
+      Buffer(BufferPool* pool, std::unique_ptr<char[]> data, size_t size)
+        : pool_(pool), data_(std::move(data)), size_(size) {}
+
+      BufferPool* pool_ = nullptr;
+      std::unique_ptr<char[]> data_;
+      size_t size_ = 0;
+    };
+
+    explicit BufferPool(size_t maxIdle = 64) : maxIdle_(maxIdle) {}
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    static BufferPool& shared() {
+      static BufferPool pool;
+      return pool;
+    }
+
+    Buffer acquire(size_t size) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = idle_.find(size);
+        if (it != idle_.end() && !it->second.empty()) {
+          std::unique_ptr<char[]> block = std::move(it->second.back());
+          it->second.pop_back();
+          --idleCount_;
+          return Buffer(this, std::move(block), size);
+        }
+      }
+      return Buffer(this, std::unique_ptr<char[]>(new char[size]), size);
+    }
+
+    size_t idleCount() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return idleCount_;
+    }
+
+    private:
+    mutable std::mutex mutex_;
+    std::unordered_map<size_t, std::vector<std::unique_ptr<char[]>>> idle_;
+    size_t idleCount_ = 0;
+    const size_t maxIdle_;
+
+    void recycle(std::unique_ptr<char[]> block, size_t size) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (idleCount_ >= maxIdle_) return;
+
+      idle_[size].push_back(std::move(block));
+      ++idleCount_;
+    }
+  };
+}
@@ -0,0 +1,388 @@
+#pragma once
+
+#include <zlib.h>
+#ifdef METRO_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "context.h"
+#include "constants.h"
+#include "helpers.h"
+#include "types.h"
+
+// Link with -lz (and -lzstd when built with METRO_WITH_ZSTD)
+
+namespace Metro {
+  using namespace Types;
+
+  class Compression {
+    public:
+    struct Options {
+      size_t min_size   = 1024;   // smaller buffered bodies are sent as-is
+      int gzip_level    = 6;      // zlib level for gzip and deflate, 1-9
+      int zstd_level    = 3;      // only used with METRO_WITH_ZSTD
+      bool streams      = true;   // compress Stream bodies chunk by chunk
+      std::vector<std::string> mime_types = {
+        Constants::Http_Content_Type::TEXT,
+        Constants::Http_Content_Type::APPLICATION_JSON,
+        Constants::Http_Content_Type::APPLICATION_JAVASCRIPT,
+        Constants::Http_Content_Type::APPLICATION_XML,
+        Constants::Http_Content_Type::IMAGE_SVG_XML,
+        Constants::Http_Content_Type::APPLICATION_WASM,
+      };
+    };
+
+    static Middleware middleware() { return middleware(Options()); }
+
+    // Negotiates Accept-Encoding after the handler has produced the response;
+    // a detached response is handled once it is complete
+    static Middleware middleware(Options options) {
+      auto shared = std::make_shared<const Options>(std::move(options));
+
+      return [shared](Context& context, Next next) {
+        next();
+
+        if (context.detached()) {
+          context.whenComplete([shared](Context& context) { apply(context, *shared); });
+        } else {
+          apply(context, *shared);
+        }
+      };
+    }
+
+    private:
+    static void apply(Context& context, const Options& options) {
+      Response& res = context.res;
+      if (res.isCommitted() || res.header(Constants::Http_Header::CONTENT_ENCODING)) return;
+
+      int status = res.getStatus();
+      if (status < 200 || status == Constants::Http_Status::NO_CONTENT ||
+          status == Constants::Http_Status::NOT_MODIFIED) {
+        return;
+      }
+
+      auto contentType = res.header(Constants::Http_Header::CONTENT_TYPE);
+      if (!contentType || !isCompressible(*contentType, options.mime_types)) return;
+
+      const Body& body = res.getBody();
+      bool stream = std::holds_alternative<Stream>(body);
+      bool buffered = std::holds_alternative<Text>(body) || std::holds_alternative<Binary>(body) ||
+                      std::holds_alternative<Json>(body);
+      if (stream ? !options.streams : !buffered) return;
+
+      // Eligible: whether this response ends up compressed depends on the request's
+      // Accept-Encoding, so caches must key on it even when it is sent as-is
+      addVary(res);
+
+      auto acceptEncoding = context.req.header(Constants::Http_Header::ACCEPT_ENCODING);
+      if (!acceptEncoding) return;
+
+      Coding coding = negotiate(*acceptEncoding);
+      if (coding == Coding::Identity) return;
+
+      int level = coding == Coding::Zstd ? options.zstd_level : options.gzip_level;
+
+      if (stream) {
+        compressStream(res, coding, level);
+      } else if (!compressBuffered(res, coding, level, options.min_size)) {
+        return;
+      }
+
+      res.header("Content-Encoding", codingName(coding));
+      weakenETag(res);
+    }
+
+    enum class Coding { Identity, Gzip, Deflate, Zstd };
+
+    // Reusable per-thread compressor state; reset between responses instead of reallocated
+    class Encoder {
+      public:
+      Encoder(Coding coding, int level) : coding_(coding), level_(level) {}
+      virtual ~Encoder() = default;
+
+      Coding coding() const { return coding_; }
+      int level() const { return level_; }
+
+      virtual void reset() = 0;
+      // Appends compressed output; `flush` makes everything so far decodable by the peer
+      virtual bool update(const char* data, size_t len, bool flush, Binary& out) = 0;
+      virtual bool finish(Binary& out) = 0;
+
+      private:
+      Coding coding_;
+      int level_;
+    };
+
+    class ZlibEncoder : public Encoder {
+      public:
+      ZlibEncoder(Coding coding, int level) : Encoder(coding, level) {
+        // windowBits 15 + 16 selects the gzip wrapper, plain 15 the zlib (deflate) wrapper
+        int windowBits = coding == Coding::Gzip ? 15 + 16 : 15;
+        ok_ = deflateInit2(&stream_, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+      }
+
+      ~ZlibEncoder() override {
+        if (ok_) deflateEnd(&stream_);
+      }
+
+      void reset() override { if (ok_) deflateReset(&stream_); }
+
+      bool update(const char* data, size_t len, bool flush, Binary& out) override {
+        return run(data, len, flush ? Z_SYNC_FLUSH : Z_NO_FLUSH, out);
+      }
+
+      bool finish(Binary& out) override {
+        return run(nullptr, 0, Z_FINISH, out);
+      }
+
+      private:
+      z_stream stream_{};
+      bool ok_ = false;
+
+      bool run(const char* data, size_t len, int mode, Binary& out) {
+        if (!ok_) return false;
+
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        stream_.avail_in = static_cast<uInt>(len);
+
+        int result;
+        do {
+          size_t offset = out.size();
+          size_t room = deflateBound(&stream_, stream_.avail_in) + 64;
+          out.resize(offset + room);
+
+          stream_.next_out = reinterpret_cast<Bytef*>(out.data() + offset);
+          stream_.avail_out = static_cast<uInt>(room);
+
+          result = deflate(&stream_, mode);
+          out.resize(offset + (room - stream_.avail_out));
+
+          if (result == Z_STREAM_ERROR) return false;
+        } while (stream_.avail_out == 0 || (mode == Z_FINISH && result != Z_STREAM_END));
+
+        return true;
+      }
+    };
+
+#ifdef METRO_WITH_ZSTD
+    class ZstdEncoder : public Encoder {
+      public:
+      ZstdEncoder(int level) : Encoder(Coding::Zstd, level), context_(ZSTD_createCCtx()) {
+        reset();
+      }
+
+      ~ZstdEncoder() override { ZSTD_freeCCtx(context_); }
+
+      void reset() override {
+        ZSTD_CCtx_reset(context_, ZSTD_reset_session_only);
+        ZSTD_CCtx_setParameter(context_, ZSTD_c_compressionLevel, level());
+      }
+
+      bool update(const char* data, size_t len, bool flush, Binary& out) override {
+        return run(data, len, flush ? ZSTD_e_flush : ZSTD_e_continue, out);
+      }
+
+      bool finish(Binary& out) override {
+        return run(nullptr, 0, ZSTD_e_end, out);
+      }
+
+      private:
+      ZSTD_CCtx* context_;
+
+      bool run(const char* data, size_t len, ZSTD_EndDirective mode, Binary& out) {
+        ZSTD_inBuffer input = {data, len, 0};
+        size_t remaining;
+        do {
+          size_t offset = out.size();
+          size_t room = ZSTD_CStreamOutSize();
+          out.resize(offset + room);
+
+          ZSTD_outBuffer output = {out.data() + offset, room, 0};
+          remaining = ZSTD_compressStream2(context_, &output, &input, mode);
+          out.resize(offset + output.pos);
+
+          if (ZSTD_isError(remaining)) return false;
+        } while (mode == ZSTD_e_continue ? input.pos < input.size : remaining != 0);
+
+        return true;
+      }
+    };
+#endif
+
+    // Borrows an encoder from the calling thread's idle list and returns it on destruction
+    class EncoderLease {
+      public:
+      EncoderLease(Coding coding, int level) {
+        auto& pool = idle();
+        for (auto it = pool.begin(); it != pool.end(); ++it) {
+          if ((*it)->coding() == coding && (*it)->level() == level) {
+            encoder_ = std::move(*it);
+            pool.erase(it);
+            encoder_->reset();
+            return;
+          }
+        }
+        encoder_ = create(coding, level);
+      }
+
+      ~EncoderLease() {
+        if (encoder_) idle().push_back(std::move(encoder_));
+      }
+
+      EncoderLease(const EncoderLease&) = delete;
+      EncoderLease& operator=(const EncoderLease&) = delete;
+
+      Encoder* operator->() const { return encoder_.get(); }
+
+      private:
+      std::unique_ptr<Encoder> encoder_;
+
+      static std::vector<std::unique_ptr<Encoder>>& idle() {
+        thread_local std::vector<std::unique_ptr<Encoder>> pool;
+        return pool;
+      }
+
+      static std::unique_ptr<Encoder> create(Coding coding, int level) {
+#ifdef METRO_WITH_ZSTD
+        if (coding == Coding::Zstd) return std::make_unique<ZstdEncoder>(level);
+#endif
+        return std::make_unique<ZlibEncoder>(coding, level);
+      }
+    };
+
+    // Compresses every chunk of a stream and forwards the output downstream
+    class CompressingSink : public Stream::ChunkSink {
+      public:
+      CompressingSink(Stream::ChunkWriter downstream, Coding coding, int level)
+        : downstream_(downstream), encoder_(coding, level) {}
+
+      bool write(const char* data, size_t len) override {
+        if (len == 0) return true;
+        output_.clear();
+        // Sync-flush per chunk so each event stays decodable on arrival
+        if (!encoder_->update(data, len, true, output_)) return false;
+        return forward();
+      }
+
+      bool flush() override {
+        return downstream_.flush();
+      }
+
+      bool finish() {
+        output_.clear();
+        if (!encoder_->finish(output_)) return false;
+        return forward();
+      }
+
+      private:
+      Stream::ChunkWriter downstream_;
+      EncoderLease encoder_;
+      Binary output_;
+
+      bool forward() {
+        if (output_.empty()) return true;
+        return downstream_(reinterpret_cast<const char*>(output_.data()), output_.size());
+      }
+    };
+
+    static Coding negotiate(const std::string& acceptEncoding) {
+#ifdef METRO_WITH_ZSTD
+      if (Helpers::acceptsEncoding(acceptEncoding, "zstd")) return Coding::Zstd;
+#endif
+      if (Helpers::acceptsEncoding(acceptEncoding, "gzip")) return Coding::Gzip;
+      if (Helpers::acceptsEncoding(acceptEncoding, "deflate")) return Coding::Deflate;
+      return Coding::Identity;
+    }
+
+    static const char* codingName(Coding coding) {
+      switch (coding) {
+        case Coding::Gzip:    return "gzip";
+        case Coding::Deflate: return "deflate";
+        case Coding::Zstd:    return "zstd";
+        default:              return "identity";
+      }
+    }
+
+    static bool isCompressible(const std::string& contentType, const std::vector<std::string>& allowed) {
+      for (const auto& prefix : allowed) {
+        if (contentType.compare(0, prefix.size(), prefix) == 0) return true;
+      }
+      return false;
+    }
+
+    static void addVary(Response& res) {
+      auto vary = res.header(Constants::Http_Header::VARY);
+      if (!vary) {
+        res.header("Vary", "Accept-Encoding");
+      } else if (vary->find("Accept-Encoding") == std::string::npos) {
+        res.header("Vary", *vary + ", Accept-Encoding");
+      }
+    }
+
+    static bool compressBuffered(Response& res, Coding coding, int level, size_t minSize) {
+      std::string serialized;
+      const char* data = nullptr;
+      size_t size = 0;
+
+      const Body& body = res.getBody();
+      if (auto* text = std::get_if<Text>(&body)) {
+        data = text->data();
+        size = text->size();
+      } else if (auto* binary = std::get_if<Binary>(&body)) {
+        data = reinterpret_cast<const char*>(binary->data());
+        size = binary->size();
+      } else if (auto* json = std::get_if<Json>(&body)) {
+        serialized = json->dump();
+        data = serialized.data();
+        size = serialized.size();
+      } else {
+        return false;
+      }
+
+      if (size < minSize) return false;
+
+      Binary compressed;
+      compressed.reserve(size / 2);
+
+      EncoderLease encoder(coding, level);
+      if (!encoder->update(data, size, false, compressed) || !encoder->finish(compressed)) {
+        return false;
+      }
+      if (compressed.size() >= size) return false;
+
+      res.removeHeader(Constants::Http_Header::CONTENT_LENGTH);
+      res.body(std::move(compressed));
+      return true;
+    }
+
+    // The encoded bytes differ from the identity ones, so a strong validator
+    // would claim they match byte for byte. If-None-Match compares weakly and still hits
+    static void weakenETag(Response& res) {
+      auto etag = res.header(Constants::Http_Header::ETAG);
+      if (etag && etag->compare(0, 2, "W/") != 0) res.header("ETag", "W/" + *etag);
+    }
+
+    static void compressStream(Response& res, Coding coding, int level) {
+      const Stream& original = std::get<Stream>(res.getBody());
+      Stream::Writer inner = original.writer;
+      bool longLived = original.longLived;
+
+      // The compressed length is unknown up front, so fixed-length streams become chunked
+      res.removeHeader(Constants::Http_Header::CONTENT_LENGTH);
+      res.header("Transfer-Encoding", "chunked");
+
+      Stream compressed([inner = std::move(inner), coding, level](Stream::ChunkWriter write) {
+        CompressingSink sink(write, coding, level);
+        bool completed = inner(Stream::ChunkWriter(sink));
+        return sink.finish() && completed;
+      });
+      // A reader would yield uncompressed bytes, so only the long-lived flag carries over
+      compressed.longLived = longLived;
+      res.body(std::move(compressed));
+    }
+  };
+}
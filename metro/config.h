@@ -10,11 +10,21 @@ namespace Metro {
     struct ServerConfig {
       int port                        = 3000;
       int backlog_size                = 128;
-      int timeout_seconds             = 30;
-      int keep_alive_timeout_seconds  = 5;
+      int header_timeout_seconds      = 10;   // a request head must arrive within this of its first byte
+      int timeout_seconds             = 30;   // request body after its head; a response write stalled on the client
+      int keep_alive_timeout_seconds  = 5;    // idle connection waiting for its next request
+      int detached_timeout_seconds    = 60;   // detached request not completed by then gets 504 (0 = no limit, e.g. long polling)
       size_t max_buffer_size          = 8192;
       size_t max_header_size          = 64 * 1024;
       size_t max_keep_alive_requests  = 100;
+      size_t stream_flush_threshold   = 0;    // bytes buffered before a stream write hits the socket (0 = every chunk)
+      int stream_flush_interval_ms    = 50;   // oldest buffered stream byte is sent once this old (threshold > 0 only)
+      bool server_timing              = false; // add a Server-Timing header with per-phase durations
+      size_t worker_threads           = 0;    // work-stealing request workers; 0 serves requests on the I/O thread
+      size_t blocking_threads         = 4;    // worker threads for routes marked blocking
+      size_t blocking_queue_depth     = 64;   // blocking requests allowed to wait; further ones get 503
+      size_t stream_threads           = 16;   // threads writing long-lived streams (e.g. SSE), one per open stream
+      size_t stream_queue_depth       = 16;   // long-lived streams allowed to wait for a thread; further ones get 503
     };
 
     // Security Configuration
@@ -39,7 +49,27 @@ namespace Metro {
     // Setters (Fluent API)
     Config& setPort(int port) { server_config.port = port; return *this; }
     Config& setTimeoutSeconds(int seconds) { server_config.timeout_seconds = seconds; return *this; }
+    Config& setHeaderTimeout(int seconds) { server_config.header_timeout_seconds = seconds; return *this; }
+    Config& setKeepAliveTimeout(int seconds) { server_config.keep_alive_timeout_seconds = seconds; return *this; }
+    Config& setDetachedTimeout(int seconds) { server_config.detached_timeout_seconds = seconds; return *this; }
     Config& setMaxBodySize(size_t size) { security_config.max_body_size = size; return *this; }
+    Config& setStreamFlush(size_t thresholdBytes, int intervalMs) {
+      server_config.stream_flush_threshold = thresholdBytes;
+      server_config.stream_flush_interval_ms = intervalMs;
+      return *this;
+    }
+    Config& enableServerTiming(bool enable = true) { server_config.server_timing = enable; return *this; }
+    Config& setWorkerThreads(size_t threads) { server_config.worker_threads = threads; return *this; }
+    Config& setBlockingPool(size_t threads, size_t queueDepth) {
+      server_config.blocking_threads = threads;
+      server_config.blocking_queue_depth = queueDepth;
+      return *this;
+    }
+    Config& setStreamPool(size_t threads, size_t queueDepth) {
+      server_config.stream_threads = threads;
+      server_config.stream_queue_depth = queueDepth;
+      return *this;
+    }
     Config& enablePathSanitization(bool enable = true) { 
       security_config.enable_path_sanitization = enable; 
       return *this; 
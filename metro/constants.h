@@ -171,6 +171,20 @@ namespace Metro {
         constexpr const char* IMAGE_GIF                     = "image/gif";
         constexpr const char* IMAGE_SVG_XML                 = "image/svg+xml";
         constexpr const char* APPLICATION_OCTET_STREAM      = "application/octet-stream";
+        constexpr const char* APPLICATION_WASM              = "application/wasm";
+        constexpr const char* APPLICATION_MANIFEST_JSON     = "application/manifest+json";
+        constexpr const char* TEXT_JAVASCRIPT               = "text/javascript";
+        constexpr const char* TEXT_MARKDOWN                 = "text/markdown";
+        constexpr const char* IMAGE_WEBP                    = "image/webp";
+        constexpr const char* IMAGE_AVIF                    = "image/avif";
+        constexpr const char* IMAGE_X_ICON                  = "image/x-icon";
+        constexpr const char* FONT_WOFF                     = "font/woff";
+        constexpr const char* FONT_WOFF2                    = "font/woff2";
+        constexpr const char* FONT_TTF                      = "font/ttf";
+        constexpr const char* FONT_OTF                      = "font/otf";
+        constexpr const char* VIDEO_MP4                     = "video/mp4";
+        constexpr const char* VIDEO_WEBM                    = "video/webm";
+        constexpr const char* AUDIO_MPEG                    = "audio/mpeg";
     }
   }
 }
@@ -1,19 +1,36 @@
 #pragma once 
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 #include <optional>
-#include <fstream>
-#include <ios>
 #include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#include <unistd.h>
 
 #include "types.h"
 #include "constants.h"
+#include "helpers.h"
+#include "file_cache.h"
+#include "timing.h"
+#include "header_map.h"
+#include "http/http_error.h"
 
 namespace Metro {
   class App;
   class HttpParser;
   class HttpWriter;
+  class Server;
+  class EventLoop;
+  class Deferred;
+  struct DeferredState;
 
   using namespace Types;
 
@@ -21,35 +38,48 @@ namespace Metro {
   private:
     std::string method_;
     std::string path_;
-    Header headers_;
+    HeaderMap headers_;
     Body body_;
-    std::unordered_map<std::string, std::string> params_;
-    std::unordered_map<std::string, std::vector<std::string>> queries_;
+    ParamStore params_;
+    QueryStore queries_;
 
     std::string http_version_ = "1.1";
+    std::string route_;
+
+    size_t bytes_received_ = 0;
 
   public:
+    Request() = default;
+    explicit Request(std::pmr::memory_resource* resource)
+      : headers_(resource), params_(resource), queries_(resource) {}
+
     std::optional<std::string> header(const std::string& key) const {
-      auto it = headers_.find(key);
-      if (it != headers_.end()) return it->second;
+      if (auto value = headers_.get(key)) return std::string(*value);
+      return std::nullopt;
+    }
+
+    // Well-known headers skip name resolution: one slot read
+    std::optional<std::string> header(HeaderMap::Known id) const {
+      if (auto value = headers_.get(id)) return std::string(*value);
       return std::nullopt;
     }
     
     std::string params(const std::string& key) const {
-      auto it = params_.find(key);
-      if (it != params_.end()) return it->second;
+      auto it = params_.find(probe(key));
+      if (it != params_.end()) return std::string(it->second);
       return {};
     }
     
     std::string query(const std::string& key) const {
-      auto it = queries_.find(key);
+      auto it = queries_.find(probe(key));
       if (it == queries_.end() || it->second.empty()) return {};
-      return it->second[0];
+      return std::string(it->second[0]);
     }
     
-    const std::vector<std::string>& queries(const std::string& key) const {
-      static const std::vector<std::string> empty;
-      auto it = queries_.find(key);
+    // Values live in the request's arena, like the map itself
+    const std::pmr::vector<std::pmr::string>& queries(const std::string& key) const {
+      static const std::pmr::vector<std::pmr::string> empty;
+      auto it = queries_.find(probe(key));
       return it == queries_.end() ? empty : it->second;
     }
     
@@ -59,6 +89,9 @@ namespace Metro {
     const Binary& binary() const  { return std::get<Binary>(body_); }
     const Stream& stream() const  { return std::get<Stream>(body_); }
 
+    // Pattern of the matched route (e.g. "/users/:id"); empty until routing succeeds
+    const std::string& route() const noexcept { return route_; }
+
   private:
     friend class App;           
     friend class HttpParser;    
@@ -72,28 +105,37 @@ namespace Metro {
     const std::string& getHttpVersion() const noexcept { return http_version_; }
     const std::string& getMethod()      const noexcept { return method_; }
     const std::string& getPath()        const noexcept { return path_; }
-    const Header& getHeaders()          const noexcept { return headers_; }
+    const HeaderMap& getHeaders()       const noexcept { return headers_; }
     const Body& getBody()               const noexcept { return body_; }
+    size_t getBytesReceived()           const noexcept { return bytes_received_; }
 
-    void setHeader(std::string key, std::string value)  { headers_[key] = std::move(value); }
+    void setHeader(std::string_view key, std::string_view value)  { headers_.set(key, value); }
+    void setParam(std::string_view key, std::string_view value)   { params_[probe(key)].assign(value); }
+    void removeParam(std::string_view key)                        { params_.erase(probe(key)); }
     void setHttpVersion(std::string version)            { http_version_ = std::move(version); }
     void setMethod(std::string method)                  { method_ = std::move(method); }
     void setPath(std::string path)                      { path_ = std::move(path); }
     void setBody(Body body)                             { body_ = std::move(body); }
+    void setRoute(const std::string& route)             { route_ = route; }
+    void setBytesReceived(size_t bytes)                 { bytes_received_ = bytes; }
     
-    std::unordered_map<std::string, std::string>& getParams()               { return params_; }
-    std::unordered_map<std::string, std::vector<std::string>>& getQueries() { return queries_; }
+    ParamStore& getParams()   { return params_; }
+    QueryStore& getQueries()  { return queries_; }
+
+    // Lookup key in the request's own resource; short keys stay in SSO, long ones land in the arena
+    std::pmr::string probe(std::string_view key) const { return std::pmr::string(key, params_.get_allocator()); }
   };
 
   class Response {
   private:
     int status_ = 200;
-    Header headers_;
+    HeaderMap headers_;
     Body body_;
     bool committed_ = false;
 
   public:
     Response() = default;
+    explicit Response(std::pmr::memory_resource* resource) : headers_(resource) {}
     
     Response& status(int code) {
       checkNotCommitted();
@@ -103,13 +145,12 @@ namespace Metro {
     
     Response& header(const std::string& key, const std::string& value) {
       checkNotCommitted();
-      headers_[key] = value;
+      headers_.set(key, value);
       return *this;
     }
     
     std::optional<std::string> header(const std::string& key) const {
-      auto it = headers_.find(key);
-      if (it != headers_.end()) return it->second;
+      if (auto value = headers_.get(key)) return std::string(*value);
       return std::nullopt;
     }
     
@@ -121,54 +162,127 @@ namespace Metro {
     
     Response& text(const std::string& txt, int code = -1) {
       if (code != -1) status(code);
-      headers_["Content-Type"] = "text/plain; charset=utf-8";
+      headers_.set("Content-Type", "text/plain; charset=utf-8");
       body_ = txt;
       return *this;
     }
 
     Response& json(const Json& data, int code = -1) {
       if (code != -1) status(code);
-      headers_["Content-Type"] = "application/json";
+      headers_.set("Content-Type", "application/json");
       body_ = data;
       return *this;
     }
 
+    // `data` must outlive the response; it is handed to writev without a copy
+    Response& bytes(const char* data, size_t size, const std::string& contentType = Constants::Http_Content_Type::APPLICATION_OCTET_STREAM) {
+      checkNotCommitted();
+      headers_.set("Content-Type", contentType);
+      body_ = StaticBytes{data, size};
+      return *this;
+    }
+
+    // The writer runs on the thread that writes the response, normally the I/O
+    // thread, so it must not wait between chunks; one that does is longLived()
     Response& stream(Stream::Writer writer, size_t contentLength = 0, const std::string& contentType = "") {
       checkNotCommitted();
       if (!contentType.empty()) {
-        headers_["Content-Type"] = contentType;
+        headers_.set("Content-Type", contentType);
       }
       if (contentLength > 0) {
-        headers_["Content-Length"] = std::to_string(contentLength);
+        headers_.set("Content-Length", std::to_string(contentLength));
       } else {
-        headers_["Transfer-Encoding"] = "chunked";
+        headers_.set("Transfer-Encoding", "chunked");
       }
       body_ = Stream(std::move(writer), contentLength);
       return *this;
     }
 
-    Response& file(const std::string& path, const std::string& contentType = "application/octet-stream") {
-      return stream([path](Stream::ChunkWriter write) {
-        std::ifstream file(path, std::ios::binary);
-        if (!file) return false; 
-        char buffer[8192];
-        while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
-          if (!write(buffer, file.gcount())) return false;
+    // Marks a stream body whose writer waits between chunks, so it is written
+    // on a thread of its own rather than the I/O thread
+    Response& longLived() {
+      checkNotCommitted();
+      if (auto* stream = std::get_if<Stream>(&body_)) stream->longLived = true;
+      return *this;
+    }
+
+    // Server-Sent Events: a chunked, uncached, long-lived stream. The writer
+    // sends each event with write() and write.flush(), and returns once a write fails
+    Response& eventStream(Stream::Writer writer) {
+      headers_.set("Cache-Control", "no-cache");
+      return stream(std::move(writer), 0, "text/event-stream").longLived();
+    }
+
+    Response& file(const std::string& path, const std::string& contentType = "") {
+      auto entry = FileCache::shared().open(path);
+      if (!entry) {
+        throw HttpError(
+          Constants::Http_Status::NOT_FOUND,
+          Helpers::reasonPhrase(Constants::Http_Status::NOT_FOUND)
+        );
+      }
+      return file(entry, contentType);
+    }
+
+    Response& file(FileCache::EntryPtr entry, const std::string& contentType = "") {
+      checkNotCommitted();
+      headers_.set("ETag", entry->etag);
+      headers_.set("Last-Modified", entry->lastModified);
+
+      const std::string& type = contentType.empty() ? entry->contentType : contentType;
+      if (entry->size == 0) {
+        headers_.set("Content-Type", type);
+        body_ = Text{};
+        return *this;
+      }
+
+      // The entry is kept alive until the body is sent, even if evicted meanwhile
+      if (entry->snapshot) {
+        stream([entry](Stream::ChunkWriter write) {
+          return write(entry->data.data(), entry->data.size());
+        }, entry->size, type);
+        std::get<Stream>(body_).reader = [entry](char* out, size_t len, size_t offset) -> ssize_t {
+          if (offset >= entry->data.size()) return 0;
+          len = std::min(len, entry->data.size() - offset);
+          std::memcpy(out, entry->data.data() + offset, len);
+          return static_cast<ssize_t>(len);
+        };
+        return *this;
+      }
+
+      // The cached descriptor is shared, so read with pread and a private offset.
+      // A file that shrinks mid-send ends the stream short rather than padding it
+      stream([entry](Stream::ChunkWriter write) {
+        char buffer[16384];
+        size_t offset = 0;
+        while (offset < entry->size) {
+          size_t wanted = std::min(sizeof(buffer), entry->size - offset);
+          ssize_t bytes_read = pread(entry->fd, buffer, wanted, static_cast<off_t>(offset));
+          if (bytes_read <= 0) return false;
+          if (!write(buffer, static_cast<size_t>(bytes_read))) return false;
+          offset += static_cast<size_t>(bytes_read);
         }
         return true;
-      }, 0, contentType); 
+      }, entry->size, type);
+      std::get<Stream>(body_).reader = [entry](char* out, size_t len, size_t offset) {
+        return pread(entry->fd, out, len, static_cast<off_t>(offset));
+      };
+      return *this;
     }
     
   private:
     friend class App;        
     friend class HttpWriter;  
     friend class Middlewares;
+    friend class Compression;
+    friend class Server;
     
     void commit() { committed_ = true; }
+    void removeHeader(const std::string& key) { checkNotCommitted(); headers_.erase(key); }
 
-    bool isCommitted()          const noexcept { return committed_; }
-    int getStatus()             const noexcept { return status_; }
-    const Header& getHeaders()  const noexcept { return headers_; }
+    bool isCommitted()              const noexcept { return committed_; }
+    int getStatus()                 const noexcept { return status_; }
+    const HeaderMap& getHeaders()   const noexcept { return headers_; }
     const Body& getBody()       const noexcept { return body_; }
     
     void checkNotCommitted() const {
@@ -181,5 +295,183 @@ namespace Metro {
   struct Context {
     Request req;
     Response res;
+    Timing timing;
+
+    Context() = default;
+    // Request-scoped containers allocate from `resource`, normally the connection's RequestArena
+    explicit Context(std::pmr::memory_resource* resource) : req(resource), res(resource) {}
+
+    // Detaches the request and returns the thread-safe handle that completes it
+    Deferred defer();
+
+    // Leaves the response open when the handler returns. The server parks the
+    // request once the middleware chain has unwound, runs `start` on its event
+    // loop, and writes the response when complete() is called. Past
+    // detached_timeout_seconds the client gets 504 instead and complete() returns false
+    void detach(std::function<void()> start = nullptr) {
+      start_ = std::move(start);
+      async_.store(AsyncState::Detached, std::memory_order_release);
+    }
+
+    bool detached() const noexcept { return async_.load(std::memory_order_acquire) != AsyncState::Inline; }
+
+    // Hands a detached request back to the server to write; any thread, first call
+    // wins. `finish`, if given, runs on the writing thread just before the write
+    bool complete(std::function<void(Context&)> finish = nullptr) {
+      if (async_.load(std::memory_order_acquire) == AsyncState::Inline) return false;
+      if (completing_.exchange(true, std::memory_order_acq_rel)) {
+        // The server may have taken the request over (see takeOver()); this lets go of it
+        if (letGo_.exchange(true, std::memory_order_acq_rel) && released_) released_();
+        return false;
+      }
+
+      finish_ = std::move(finish);
+
+      // Before park() the server is still unwinding and writes the response itself
+      if (async_.exchange(AsyncState::Completed, std::memory_order_acq_rel) == AsyncState::Parked) resume_();
+      return true;
+    }
+
+    // For middleware whose step after next() needs the final response: on a
+    // detached request that response does not exist yet, so `step` runs on
+    // the writing thread once it is complete. Steps run in registration
+    // order, innermost middleware first, as they would have while unwinding
+    void whenComplete(std::function<void(Context&)> step) { completion_.push_back(std::move(step)); }
+
+    // Loop of the server handling this request; awaitables in coroutine handlers run on it
+    EventLoop& loop() const {
+      if (!loop_) throw std::logic_error("No event loop: the request is not being served by a Server");
+      return *loop_;
+    }
+
+    private:
+    friend class Server;
+
+    enum class AsyncState : uint8_t { Inline, Detached, Parked, Completed };
+
+    // Pending: the handler is still unwinding. Lost: complete() came first.
+    // Owned: the server may finish or drop the request. Held: the handler still
+    // uses the Context, and `released` runs once its complete() lets go
+    enum class Takeover : uint8_t { Pending, Lost, Owned, Held };
+
+    std::atomic<AsyncState> async_{AsyncState::Inline};
+    std::atomic<bool> completing_{false};
+    std::atomic<bool> letGo_{false};
+    std::function<void()> released_;
+    std::function<void()> start_;
+    std::function<void()> resume_;
+    std::function<void(Context&)> finish_;
+    std::vector<std::function<void(Context&)>> completion_;
+    std::weak_ptr<DeferredState> deferred_;
+    EventLoop* loop_ = nullptr;
+
+    // False unless the request is detached and complete() has not been called yet;
+    // otherwise `resume` is what complete() calls to hand the request back
+    bool park(std::function<void()> resume) {
+      resume_ = std::move(resume);
+      AsyncState expected = AsyncState::Detached;
+      return async_.compare_exchange_strong(expected, AsyncState::Parked, std::memory_order_acq_rel);
+    }
+
+    // The handler threw after detaching: completes with the error response the
+    // server set, unless a Deferred has already claimed the completion
+    void abandon();
+
+    // Claims a parked request nobody has completed, e.g. past its deadline.
+    // With a Deferred the handles go inert; any other handler still holds the
+    // Context, so the server must not touch it until `released`
+    Takeover takeOver(std::function<void()> released);
   };
+
+  // Shared by the copies of one Deferred
+  struct DeferredState {
+    Context* context;
+    std::atomic<bool> done{false};
+
+    explicit DeferredState(Context& context) : context(&context) {}
+
+    // Every handle was dropped unresolved: answer rather than leave the connection parked for good
+    ~DeferredState() {
+      if (done.exchange(true, std::memory_order_acq_rel)) return;
+      context->complete([](Context& c) {
+        c.res
+          .status(Constants::Http_Status::INTERNAL_SERVER_ERROR)
+          .text(Helpers::reasonPhrase(Constants::Http_Status::INTERNAL_SERVER_ERROR));
+      });
+    }
+  };
+
+  /**
+   * Completes a response after its handler has returned.
+   *
+   * Context::defer() detaches the request and returns this handle. The
+   * connection stays parked, without holding a thread, until resolve() is
+   * called from any thread; the function passed to resolve() then runs on the
+   * thread that writes the response, so it never races the handler or
+   * middleware:
+   *
+   *   app.get("/jobs/:id", [&](Context& c) {
+   *     jobs.onDone(c.req.params("id"), [done = c.defer()](const Json& result) {
+   *       done.resolve([result](Context& c) { c.res.json(result); });
+   *     });
+   *   });
+   *
+   * Copies share one completion and only the first resolve() counts; later
+   * calls return false without touching the request. If the handler throws
+   * after defer(), the error response is sent and the handle goes inert. If
+   * every copy is dropped unresolved, the request is answered with 500; if it
+   * is still unresolved after detached_timeout_seconds, with 504. A request
+   * whose connection is reset is dropped, while a client that only shut down
+   * its sending side still gets the response. Either way the handles go inert.
+   */
+  class Deferred {
+    public:
+    bool resolve(std::function<void(Context&)> respond) const {
+      if (!state_ || state_->done.exchange(true, std::memory_order_acq_rel)) return false;
+      state_->context->complete(std::move(respond));
+      return true;
+    }
+
+    bool resolved() const noexcept { return !state_ || state_->done.load(std::memory_order_acquire); }
+
+    private:
+    friend struct Context;
+
+    std::shared_ptr<DeferredState> state_;
+
+    explicit Deferred(std::shared_ptr<DeferredState> state) : state_(std::move(state)) {}
+  };
+
+  inline Deferred Context::defer() {
+    auto state = std::make_shared<DeferredState>(*this);
+    deferred_ = state;
+    detach();
+    return Deferred(std::move(state));
+  }
+
+  inline void Context::abandon() {
+    auto state = deferred_.lock();
+    if (!state || !state->done.exchange(true, std::memory_order_acq_rel)) {
+      if (complete()) return;
+    }
+
+    // Already completed, e.g. by the last handle dropped while unwinding: the error response wins
+    if (async_.load(std::memory_order_acquire) == AsyncState::Completed) finish_ = nullptr;
+  }
+
+  inline Context::Takeover Context::takeOver(std::function<void()> released) {
+    AsyncState async = async_.load(std::memory_order_acquire);
+    if (async == AsyncState::Detached) return Takeover::Pending;
+    if (async != AsyncState::Parked) return Takeover::Lost;
+
+    auto state = deferred_.lock();
+    if (state && state->done.exchange(true, std::memory_order_acq_rel)) return Takeover::Lost;
+    if (completing_.exchange(true, std::memory_order_acq_rel)) return Takeover::Lost;
+    async_.store(AsyncState::Completed, std::memory_order_release);
+    if (state) return Takeover::Owned;
+
+    // Whichever of this and the handler's complete() comes second finishes the handover
+    released_ = std::move(released);
+    return letGo_.exchange(true, std::memory_order_acq_rel) ? Takeover::Owned : Takeover::Held;
+  }
 }
@@ -0,0 +1,429 @@
+#pragma once
+
+// Coroutine handlers need C++20; under C++17 this header declares nothing
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "context.h"
+#include "types.h"
+#include "constants.h"
+#include "helpers.h"
+#include "event_loop.h"
+#include "http/http_error.h"
+
+namespace Metro {
+  template <typename T = void>
+  class Task;
+
+  namespace Async {
+    template <typename T>
+    struct TaskResult {
+      std::optional<T> value;
+
+      void return_value(T result) { value = std::move(result); }
+      T take() { return std::move(*value); }
+    };
+
+    template <>
+    struct TaskResult<void> {
+      void return_void() noexcept {}
+      void take() noexcept {}
+    };
+  }
+
+  /**
+   * Lazily started coroutine returning T.
+   *
+   * A Task runs when it is awaited, on the awaiting thread, and resumes its
+   * awaiter when it returns; exceptions propagate to the awaiter. A handler
+   * returning Task<void> can be registered wherever a Handler is taken:
+   *
+   *   app.get("/slow", [](Context& c) -> Task<> {
+   *     co_await Async::sleep(c.loop(), std::chrono::milliseconds(200));
+   *     c.res.text("done");
+   *   });
+   *
+   * The coroutine starts on the server's event loop once the middleware chain
+   * has unwound, so middleware code after next() runs before it; the response
+   * is written when it returns. Every resumption happens on the loop too, so
+   * it must not block: use the awaitables in Metro::Async, or mark the route
+   * blocking() and stay synchronous.
+   */
+  template <typename T>
+  class Task {
+    public:
+    struct promise_type : Async::TaskResult<T> {
+      std::coroutine_handle<> continuation;
+      std::exception_ptr exception;
+
+      Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+      std::suspend_always initial_suspend() const noexcept { return {}; }
+      void unhandled_exception() noexcept { exception = std::current_exception(); }
+
+      // Hands the thread straight to the awaiter instead of returning through resume()
+      struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        void await_resume() const noexcept {}
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> self) noexcept {
+          std::coroutine_handle<> next = self.promise().continuation;
+          return next ? next : std::noop_coroutine();
+        }
+      };
+
+      FinalAwaiter final_suspend() const noexcept { return {}; }
+    };
+
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+
+    Task& operator=(Task&& other) noexcept {
+      if (this != &other) {
+        if (handle_) handle_.destroy();
+        handle_ = std::exchange(other.handle_, {});
+      }
+      return *this;
+    }
+
+    ~Task() { if (handle_) handle_.destroy(); }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+      handle_.promise().continuation = awaiting;
+      return handle_;
+    }
+
+    T await_resume() {
+      if (handle_.promise().exception) std::rethrow_exception(handle_.promise().exception);
+      return handle_.promise().take();
+    }
+
+    private:
+    std::coroutine_handle<promise_type> handle_;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+  };
+
+  namespace Async {
+    // Top-level frame of a coroutine handler. It owns itself: started by the
+    // server after the request is parked, freed when the handler has finished
+    struct Responder {
+      struct promise_type {
+        Context& context;
+
+        promise_type(Task<void>&, Context& context) : context(context) {}
+
+        Responder get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() noexcept {}
+
+        // Whatever respond() does not catch, e.g. a throw that is not a
+        // std::exception, still answers with 500 instead of std::terminate
+        void unhandled_exception() noexcept {
+          try {
+            context.res
+              .status(Constants::Http_Status::INTERNAL_SERVER_ERROR)
+              .text(Helpers::reasonPhrase(Constants::Http_Status::INTERNAL_SERVER_ERROR));
+          } catch (...) {}
+          try {
+            context.complete();
+          } catch (...) {}
+        }
+      };
+
+      std::coroutine_handle<promise_type> frame;
+    };
+
+    // Errors become responses the way Server::runApp turns them for synchronous handlers
+    inline Responder respond(Task<void> handler, Context& context) {
+      {
+        Task<void> body = std::move(handler);
+        try {
+          co_await body;
+        } catch (const HttpError& e) {
+          context.res
+            .status(e.status())
+            .text(e.what());
+        } catch (const std::exception&) {
+          context.res
+            .status(Constants::Http_Status::INTERNAL_SERVER_ERROR)
+            .text(Helpers::reasonPhrase(Constants::Http_Status::INTERNAL_SERVER_ERROR));
+        }
+      }
+      // Last: the server may reuse the Context as soon as this returns
+      context.complete();
+    }
+
+    // co_await Async::sleep(loop, 50ms) resumes on `loop` once `delay` has passed
+    class Sleep {
+      public:
+      Sleep(EventLoop& loop, EventLoop::Clock::duration delay) : loop_(loop), delay_(delay) {}
+
+      bool await_ready() const noexcept { return false; }
+      void await_resume() const noexcept {}
+
+      void await_suspend(std::coroutine_handle<> awaiting) {
+        loop_.after(delay_, [awaiting] { awaiting.resume(); });
+      }
+
+      private:
+      EventLoop& loop_;
+      EventLoop::Clock::duration delay_;
+    };
+
+    inline Sleep sleep(EventLoop& loop, EventLoop::Clock::duration delay) { return Sleep(loop, delay); }
+
+    // Resumes on `loop` once `fd` is ready and yields the epoll events, errors
+    // included, or 0 if `deadline` passes first. The fd must not be watched
+    // already, so never the client socket
+    class Readiness {
+      public:
+      using Clock = EventLoop::Clock;
+
+      Readiness(EventLoop& loop, int fd, uint32_t events, Clock::time_point deadline = Clock::time_point::max())
+        : loop_(loop), fd_(fd), events_(events), deadline_(deadline) {}
+
+      bool await_ready() const noexcept { return false; }
+      uint32_t await_resume() const noexcept { return ready_; }
+
+      void await_suspend(std::coroutine_handle<> awaiting) {
+        bool timed = deadline_ != Clock::time_point::max();
+
+        loop_.watch(fd_, events_ | EPOLLONESHOT, [this, awaiting, timed](uint32_t ready) {
+          if (timed) loop_.cancel(timer_);
+          ready_ = ready;
+          loop_.unwatch(fd_);
+          awaiting.resume();
+        });
+
+        if (timed) {
+          timer_ = loop_.after(deadline_ - Clock::now(), [this, awaiting] {
+            loop_.unwatch(fd_);
+            awaiting.resume();
+          });
+        }
+      }
+
+      private:
+      EventLoop& loop_;
+      int fd_;
+      uint32_t events_;
+      Clock::time_point deadline_;
+      EventLoop::TimerId timer_ = 0;
+      uint32_t ready_ = 0;
+    };
+
+    inline Readiness readable(EventLoop& loop, int fd, Readiness::Clock::time_point deadline = Readiness::Clock::time_point::max()) {
+      return Readiness(loop, fd, EPOLLIN | EPOLLRDHUP, deadline);
+    }
+    inline Readiness writable(EventLoop& loop, int fd, Readiness::Clock::time_point deadline = Readiness::Clock::time_point::max()) {
+      return Readiness(loop, fd, EPOLLOUT, deadline);
+    }
+
+    struct ClientResponse {
+      int status = 0;
+      HeaderMap headers;
+      std::string body;   // de-chunked
+
+      std::optional<std::string> header(const std::string& key) const {
+        if (auto value = headers.get(key)) return std::string(*value);
+        return std::nullopt;
+      }
+    };
+
+    inline std::string dechunk(const std::string& body) {
+      std::string out;
+      size_t position = 0;
+
+      while (position < body.size()) {
+        size_t lineEnd = body.find("\r\n", position);
+        if (lineEnd == std::string::npos) break;
+
+        size_t size = std::strtoul(body.c_str() + position, nullptr, 16);
+        if (size == 0) break;
+
+        out.append(body, lineEnd + 2, size);
+        position = lineEnd + 2 + size + 2;
+      }
+      return out;
+    }
+
+    inline ClientResponse parseResponse(const std::string& raw) {
+      ClientResponse response;
+
+      size_t headerEnd = raw.find("\r\n\r\n");
+      if (raw.size() < 12 || headerEnd == std::string::npos || raw.compare(0, 5, "HTTP/") != 0) {
+        throw std::runtime_error("Malformed HTTP response");
+      }
+
+      response.status = std::atoi(raw.c_str() + 9);
+
+      size_t lineStart = raw.find("\r\n") + 2;
+      while (lineStart < headerEnd) {
+        size_t lineEnd = raw.find("\r\n", lineStart);
+        size_t colon = raw.find(':', lineStart);
+        if (colon != std::string::npos && colon < lineEnd) {
+          size_t valueStart = std::min(raw.find_first_not_of(' ', colon + 1), lineEnd);
+          response.headers.set(
+            std::string_view(raw).substr(lineStart, colon - lineStart),
+            std::string_view(raw).substr(valueStart, lineEnd - valueStart)
+          );
+        }
+        lineStart = lineEnd + 2;
+      }
+
+      std::string body = raw.substr(headerEnd + 4);
+      auto encoding = response.header(Constants::Http_Header::TRANSFER_ENCODING);
+      response.body = encoding && *encoding == "chunked" ? dechunk(body) : std::move(body);
+      return response;
+    }
+
+    // Bounds on one fetch(), so a slow or oversized upstream fails the handler instead of holding it
+    struct FetchLimits {
+      EventLoop::Clock::duration timeout = std::chrono::seconds(10);   // connect to the last response byte; then HttpError 504
+      size_t max_response_size = 10 * 1024 * 1024;                     // raw response bytes; beyond them HttpError 502
+    };
+
+    // Outbound HTTP/1.1 request over a new non-blocking connection; the
+    // response is read to EOF. `host` is a numeric IPv4 address, since name
+    // resolution would block the loop
+    inline Task<ClientResponse> fetch(
+      EventLoop& loop,
+      std::string host,
+      int port,
+      std::string method,
+      std::string path,
+      std::string body = "",
+      HeaderMap headers = {},
+      FetchLimits limits = {}
+    ) {
+      const auto deadline = EventLoop::Clock::now() + limits.timeout;
+      auto timedOut = [&host] {
+        return HttpError(Constants::Http_Status::GATEWAY_TIMEOUT, "Upstream " + host + " timed out");
+      };
+
+      sockaddr_in address{};
+      address.sin_family = AF_INET;
+      address.sin_port = htons(static_cast<uint16_t>(port));
+      if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+        throw std::invalid_argument("fetch() needs a numeric IPv4 host: " + host);
+      }
+
+      int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      if (fd < 0) {
+        throw std::system_error(
+          std::error_code(errno, std::system_category()),
+          "Failed to create socket"
+        );
+      }
+
+      struct Closer {
+        int fd;
+        ~Closer() { close(fd); }
+      } closer{fd};
+
+      if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        if (errno != EINPROGRESS) {
+          throw std::system_error(
+            std::error_code(errno, std::system_category()),
+            "Failed to connect to " + host
+          );
+        }
+
+        if (co_await writable(loop, fd, deadline) == 0) throw timedOut();
+
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0) {
+          throw std::system_error(
+            std::error_code(error, std::system_category()),
+            "Failed to connect to " + host
+          );
+        }
+      }
+
+      std::string request = method + " " + path + " HTTP/1.1\r\nHost: " + host + ":" + std::to_string(port) + "\r\n";
+      for (const auto& [key, value] : headers) {
+        request.append(key).append(": ").append(value).append("\r\n");
+      }
+      if (!body.empty() && !headers.contains(HeaderMap::Known::ContentLength)) {
+        request += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+      }
+      request += "Connection: close\r\n\r\n";
+      request += body;
+
+      size_t offset = 0;
+      while (offset < request.size()) {
+        ssize_t sent = ::send(fd, request.data() + offset, request.size() - offset, MSG_NOSIGNAL);
+        if (sent >= 0) {
+          offset += static_cast<size_t>(sent);
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          if (co_await writable(loop, fd, deadline) == 0) throw timedOut();
+        } else if (errno != EINTR) {
+          throw std::system_error(
+            std::error_code(errno, std::system_category()),
+            "Failed to send request to " + host
+          );
+        }
+      }
+
+      std::string raw;
+      char buffer[16384];
+      while (true) {
+        ssize_t got = recv(fd, buffer, sizeof(buffer), 0);
+        if (got > 0) {
+          raw.append(buffer, static_cast<size_t>(got));
+          if (raw.size() > limits.max_response_size) {
+            throw HttpError(Constants::Http_Status::BAD_GATEWAY, "Upstream " + host + " response too large");
+          }
+        } else if (got == 0) {
+          break;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          if (co_await readable(loop, fd, deadline) == 0) throw timedOut();
+        } else if (errno != EINTR) {
+          throw std::system_error(
+            std::error_code(errno, std::system_category()),
+            "Failed to read response from " + host
+          );
+        }
+      }
+
+      co_return parseResponse(raw);
+    }
+  }
+
+  namespace Types {
+    // A handler returning Task<void> detaches its request and runs as an Async::Responder
+    template <>
+    struct HandlerResult<Task<void>> {
+      template <typename F>
+      static std::function<void(Context&)> adapt(F&& handler) {
+        return [handler = std::forward<F>(handler)](Context& context) mutable {
+          Async::Responder responder = Async::respond(handler(context), context);
+          context.detach([frame = responder.frame] { frame.resume(); });
+        };
+      }
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "context.h"
+#include "constants.h"
+#include "helpers.h"
+#include "http/http_error.h"
+
+namespace Metro {
+
+  // Layout emitted by tools/embed_assets.py; every pointer refers to constexpr data in .rodata
+
+  struct EmbeddedVariant {
+    const char* coding;                 // "br", "zstd" or "gzip"
+    const unsigned char* data;
+    size_t size;
+    const char* etag;
+  };
+
+  struct EmbeddedAsset {
+    const char* path;                   // "/index.html", sorted bytewise within a bundle
+    const unsigned char* data;
+    size_t size;
+    const char* etag;
+    const EmbeddedVariant* variants;    // in server preference order
+    size_t variantCount;
+  };
+
+  struct EmbeddedBundle {
+    const EmbeddedAsset* assets;
+    size_t count;
+
+    const EmbeddedAsset* find(const std::string& path) const {
+      auto end = assets + count;
+      auto it = std::lower_bound(assets, end, path, [](const EmbeddedAsset& asset, const std::string& key) {
+        return std::strcmp(asset.path, key.c_str()) < 0;
+      });
+      if (it == end || path != it->path) return nullptr;
+      return it;
+    }
+  };
+
+  /**
+   * Handler serving an EmbeddedBundle, mounted with App::serveEmbedded.
+   *
+   * Lookups are a binary search over the generated table and responses point
+   * straight at the embedded bytes, so serving performs no filesystem I/O and
+   * no copies. Precompressed variants generated at build time are selected
+   * from Accept-Encoding exactly as StaticFiles does for sibling files.
+   * Content types come from Helpers::mimeType, as for StaticFiles, resolved
+   * once per asset when the bundle is mounted.
+   */
+  class EmbeddedFiles {
+    public:
+    struct Options {
+      std::string index        = "index.html";
+      std::string cacheControl = "";
+    };
+
+    explicit EmbeddedFiles(const EmbeddedBundle& bundle)
+      : EmbeddedFiles(bundle, Options()) {}
+
+    EmbeddedFiles(const EmbeddedBundle& bundle, Options options)
+      : bundle_(bundle), options_(std::move(options)) {
+      contentTypes_.reserve(bundle_.count);
+      for (size_t i = 0; i < bundle_.count; ++i) contentTypes_.push_back(Helpers::mimeType(bundle_.assets[i].path));
+    }
+
+    void operator()(Context& context) const {
+      std::string path = Helpers::PathSanitizer::resolveDecoded(context.req.params("path"));
+      if (path.empty()) {
+        context.res
+          .status(Constants::Http_Status::BAD_REQUEST)
+          .text(Helpers::reasonPhrase(Constants::Http_Status::BAD_REQUEST));
+        return;
+      }
+
+      const EmbeddedAsset* asset = nullptr;
+      if (path == "/") {
+        asset = bundle_.find(path + options_.index);
+      } else {
+        asset = bundle_.find(path);
+        if (!asset && !options_.index.empty()) asset = bundle_.find(path + "/" + options_.index);
+      }
+
+      if (!asset) {
+        context.res
+          .status(Constants::Http_Status::NOT_FOUND)
+          .text(Helpers::reasonPhrase(Constants::Http_Status::NOT_FOUND));
+        return;
+      }
+
+      const unsigned char* data = asset->data;
+      size_t size = asset->size;
+      const char* etag = asset->etag;
+      const char* encoding = nullptr;
+
+      if (asset->variantCount > 0) {
+        context.res.header("Vary", "Accept-Encoding");
+
+        auto acceptEncoding = context.req.header(Constants::Http_Header::ACCEPT_ENCODING);
+        for (size_t i = 0; acceptEncoding && i < asset->variantCount; ++i) {
+          const auto& variant = asset->variants[i];
+          if (!Helpers::acceptsEncoding(*acceptEncoding, variant.coding)) continue;
+
+          data = variant.data;
+          size = variant.size;
+          etag = variant.etag;
+          encoding = variant.coding;
+          break;
+        }
+      }
+
+      if (!options_.cacheControl.empty()) {
+        context.res.header("Cache-Control", options_.cacheControl);
+      }
+
+      context.res.header("ETag", etag);
+
+      auto ifNoneMatch = context.req.header(Constants::Http_Header::IF_NONE_MATCH);
+      if (ifNoneMatch && (*ifNoneMatch == "*" || ifNoneMatch->find(etag) != std::string::npos)) {
+        context.res.status(Constants::Http_Status::NOT_MODIFIED);
+        return;
+      }
+
+      if (encoding) {
+        context.res.header("Content-Encoding", encoding);
+      }
+
+      context.res.bytes(reinterpret_cast<const char*>(data), size, contentTypes_[asset - bundle_.assets]);
+    }
+
+    private:
+    const EmbeddedBundle& bundle_;
+    Options options_;
+    std::vector<const char*> contentTypes_;   // parallel to bundle_.assets
+  };
+}
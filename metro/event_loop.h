@@ -0,0 +1,274 @@
+#pragma once
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "timer_wheel.h"
+
+namespace Metro {
+
+  /**
+   * epoll loop behind the server's connections and the awaitables of
+   * coroutine handlers.
+   *
+   * Timers and fd callbacks belong to the thread running the loop. post() is
+   * the entry point for every other thread: it queues a task and wakes the
+   * loop through an eventfd. after(), cancel(), watch() and unwatch() called
+   * off the loop thread forward themselves through post(), so callbacks only
+   * ever run on the loop thread.
+   *
+   * after() suits the occasional one-off timer. Deadlines that are re-armed
+   * on every request, like the server's per-connection read and idle
+   * timeouts, go on wheel() instead, which arms and cancels in O(1).
+   *
+   *   EventLoop loop;
+   *   loop.after(std::chrono::seconds(1), [&] { loop.stop(); });
+   *   loop.run();
+   */
+  class EventLoop {
+    public:
+    using Task = std::function<void()>;
+    using IoCallback = std::function<void(uint32_t events)>;
+    using Clock = std::chrono::steady_clock;
+    using TimerId = uint64_t;
+
+    EventLoop() : poller_(epoll_create1(EPOLL_CLOEXEC)), wake_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+      if (poller_ < 0 || wake_ < 0) {
+        closeFds();
+        throw std::system_error(
+          std::error_code(errno, std::system_category()),
+          "Failed to create event loop"
+        );
+      }
+
+      epoll_event event{};
+      event.events = EPOLLIN;
+      event.data.fd = wake_;
+      epoll_ctl(poller_, EPOLL_CTL_ADD, wake_, &event);
+    }
+
+    ~EventLoop() { closeFds(); }
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // The loop running on this thread, or nullptr
+    static EventLoop* current() noexcept { return current_; }
+
+    bool inLoopThread() const noexcept { return current_ == this; }
+
+    // Any thread: runs `task` on the loop thread, in posting order
+    void post(Task task) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        posted_.push_back(std::move(task));
+      }
+
+      if (!wakePending_.exchange(true, std::memory_order_acq_rel)) {
+        uint64_t one = 1;
+        ssize_t written = write(wake_, &one, sizeof(one));
+        (void)written;
+      }
+    }
+
+    // Runs `task` once, `delay` from now
+    TimerId after(Clock::duration delay, Task task) {
+      TimerId id = nextTimer_.fetch_add(1, std::memory_order_relaxed);
+      Clock::time_point deadline = Clock::now() + delay;
+
+      if (!inLoopThread()) {
+        post([this, id, deadline, task = std::move(task)]() mutable { addTimer(id, deadline, std::move(task)); });
+      } else {
+        addTimer(id, deadline, std::move(task));
+      }
+      return id;
+    }
+
+    // No effect once the timer has fired
+    void cancel(TimerId id) {
+      if (!inLoopThread()) {
+        post([this, id] { timerTasks_.erase(id); });
+        return;
+      }
+      timerTasks_.erase(id);
+    }
+
+    // Calls `callback` with the ready events of `fd` until unwatch(); pass
+    // EPOLLONESHOT to get one event per modify()
+    void watch(int fd, uint32_t events, IoCallback callback) {
+      if (!inLoopThread()) {
+        post([this, fd, events, callback = std::move(callback)]() mutable { watch(fd, events, std::move(callback)); });
+        return;
+      }
+
+      auto& slot = watchers_[fd];
+      if (slot) unwatched_.push_back(std::move(slot));
+      slot = std::make_unique<IoCallback>(std::move(callback));
+      control(EPOLL_CTL_ADD, fd, events);
+    }
+
+    // Any thread: re-arms a watched fd, typically one registered with EPOLLONESHOT
+    void modify(int fd, uint32_t events) { control(EPOLL_CTL_MOD, fd, events); }
+
+    void unwatch(int fd) {
+      if (!inLoopThread()) {
+        post([this, fd] { unwatch(fd); });
+        return;
+      }
+
+      auto it = watchers_.find(fd);
+      if (it == watchers_.end()) return;
+
+      epoll_ctl(poller_, EPOLL_CTL_DEL, fd, nullptr);
+      // A callback may unwatch its own fd and go on using its captures, so
+      // it stays where it is, on the heap, and is destroyed after the batch
+      unwatched_.push_back(std::move(it->second));
+      watchers_.erase(it);
+    }
+
+    // Runs until stop()
+    void run() {
+      runUntil([this] { return stopped_.load(std::memory_order_acquire); });
+      stopped_.store(false, std::memory_order_relaxed);
+    }
+
+    // Runs on the calling thread until `done()` holds; checked after every batch
+    template <typename Predicate>
+    void runUntil(Predicate done) {
+      EventLoop* outer = current_;
+      current_ = this;
+
+      while (!done()) runOnce();
+
+      current_ = outer;
+    }
+
+    // Loop thread only; advanced on every iteration
+    TimerWheel& wheel() noexcept { return wheel_; }
+
+    // Any thread
+    void stop() {
+      stopped_.store(true, std::memory_order_release);
+      post([] {});
+    }
+
+    private:
+    struct Timer {
+      Clock::time_point deadline;
+      TimerId id;
+      bool operator>(const Timer& other) const { return deadline > other.deadline; }
+    };
+
+    static inline thread_local EventLoop* current_ = nullptr;
+
+    int poller_;
+    int wake_;
+
+    std::mutex mutex_;
+    std::vector<Task> posted_;
+    std::atomic<bool> wakePending_{false};
+    std::atomic<bool> stopped_{false};
+
+    // Cancelled timers leave their heap entry behind; it is skipped when it comes up
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+    std::unordered_map<TimerId, Task> timerTasks_;
+    std::atomic<TimerId> nextTimer_{1};
+
+    // Boxed so that moving one out of the map leaves the running closure in place
+    std::unordered_map<int, std::unique_ptr<IoCallback>> watchers_;
+    std::vector<std::unique_ptr<IoCallback>> unwatched_;
+
+    TimerWheel wheel_;
+
+    void closeFds() {
+      if (poller_ >= 0) close(poller_);
+      if (wake_ >= 0) close(wake_);
+    }
+
+    void control(int operation, int fd, uint32_t events) {
+      epoll_event event{};
+      event.events = events;
+      event.data.fd = fd;
+      epoll_ctl(poller_, operation, fd, &event);
+    }
+
+    void addTimer(TimerId id, Clock::time_point deadline, Task task) {
+      timerTasks_.emplace(id, std::move(task));
+      timers_.push(Timer{deadline, id});
+    }
+
+    // Milliseconds epoll may sleep before the next timer or wheel deadline is due; -1 when there is none
+    int pollTimeout() {
+      const Clock::time_point now = Clock::now();
+      int timeout = wheel_.timeoutMs(now);
+
+      while (!timers_.empty() && timerTasks_.find(timers_.top().id) == timerTasks_.end()) timers_.pop();
+      if (timers_.empty()) return timeout;
+
+      auto wait = std::chrono::ceil<std::chrono::milliseconds>(timers_.top().deadline - now);
+      int timerTimeout = wait.count() > 0 ? static_cast<int>(wait.count()) : 0;
+      return timeout < 0 ? timerTimeout : std::min(timeout, timerTimeout);
+    }
+
+    void runOnce() {
+      epoll_event events[64];
+      int ready = epoll_wait(poller_, events, 64, pollTimeout());
+
+      for (int i = 0; i < ready; ++i) {
+        int fd = events[i].data.fd;
+
+        if (fd == wake_) {
+          runPosted();
+          continue;
+        }
+
+        auto it = watchers_.find(fd);
+        if (it != watchers_.end()) (*it->second)(events[i].events);
+      }
+      unwatched_.clear();
+
+      runTimers();
+    }
+
+    void runPosted() {
+      uint64_t count;
+      while (read(wake_, &count, sizeof(count)) > 0) {}
+      wakePending_.store(false, std::memory_order_release);
+
+      std::vector<Task> tasks;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks.swap(posted_);
+      }
+      for (Task& task : tasks) task();
+    }
+
+    void runTimers() {
+      const Clock::time_point now = Clock::now();
+      wheel_.advance(now);
+
+      while (!timers_.empty() && timers_.top().deadline <= now) {
+        auto it = timerTasks_.find(timers_.top().id);
+        timers_.pop();
+        if (it == timerTasks_.end()) continue;
+
+        Task task = std::move(it->second);
+        timerTasks_.erase(it);
+        task();
+      }
+    }
+  };
+}
@@ -0,0 +1,382 @@
+#pragma once
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "helpers.h"
+
+namespace Metro {
+
+  /**
+   * Bounded LRU cache of open file descriptors and their metadata.
+   *
+   * Entries are shared by every thread serving files: a hit costs one mutex
+   * acquisition and no syscalls. Missing files are cached as negative entries
+   * so repeated probes (e.g. for precompressed siblings) stay cheap as well.
+   *
+   * Files up to `snapshot_limit` bytes are read into the entry together with
+   * the size and mtime they were read at, so an entry stays self-consistent
+   * even if the file is rewritten in place before invalidation lands. Larger
+   * files keep their descriptor open and are read at send time. Snapshots
+   * share a `snapshot_bytes` budget; past it the least recent entries go.
+   *
+   * Invalidation is driven by inotify watches on the parent directory of each
+   * cached path and happens asynchronously on a background thread. The watch
+   * is in place before a file is loaded, and a load that raced a change in
+   * its directory is served but not cached. If inotify is unavailable the
+   * cache degrades to pass-through and every lookup hits the filesystem.
+   */
+  class FileCache {
+    public:
+    struct Entry {
+      int fd        = -1;       // open only for files served from disk
+      size_t size   = 0;
+      std::time_t mtime = 0;
+      bool snapshot = false;    // `data` holds the whole file as of `size` and `mtime`
+      std::string data;
+
+      std::string path;
+      std::string etag;
+      std::string lastModified;
+      std::string contentType;
+
+      Entry() = default;
+      Entry(const Entry&) = delete;
+      Entry& operator=(const Entry&) = delete;
+      ~Entry() { if (fd >= 0) close(fd); }
+    };
+
+    using EntryPtr = std::shared_ptr<const Entry>;
+
+    struct Options {
+      size_t capacity       = 512;                // entries, negative ones included
+      size_t snapshot_limit = 256 * 1024;         // files up to this size are held in memory
+      size_t snapshot_bytes = 32 * 1024 * 1024;   // all snapshots together
+    };
+
+    FileCache() : FileCache(Options()) {}
+
+    explicit FileCache(Options options) : options_(options) {
+      startWatcher();
+    }
+
+    ~FileCache() {
+      stopWatcher();
+    }
+
+    FileCache(const FileCache&) = delete;
+    FileCache& operator=(const FileCache&) = delete;
+
+    static FileCache& shared() {
+      static FileCache cache;
+      return cache;
+    }
+
+    // Returns nullptr when the path does not name a readable regular file
+    EntryPtr open(const std::string& path) {
+      if (inotifyDescriptor_ < 0) {
+        return load(path);
+      }
+
+      std::string directory = parentDirectory(path);
+      uint64_t generation;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(path);
+        if (it != index_.end()) {
+          lru_.splice(lru_.begin(), lru_, it->second);
+          return it->second->entry;
+        }
+
+        // Watched before the load, so a change racing it is seen; 0 when it cannot be watched
+        generation = addWatch(directory) ? watches_[directory].generation : 0;
+      }
+
+      EntryPtr entry = load(path);
+      if (generation == 0) return entry;
+
+      // The reference taken above passes to the new node, or is dropped
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (watches_[directory].generation == generation && index_.find(path) == index_.end()) {
+        insert(path, std::move(directory), entry);
+      } else {
+        removeWatch(directory);
+      }
+      return entry;
+    }
+
+    void invalidate(const std::string& path) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = index_.find(path);
+      if (it != index_.end()) erase(it->second);
+    }
+
+    void clear() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      while (!lru_.empty()) erase(std::prev(lru_.end()));
+    }
+
+    size_t size() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return lru_.size();
+    }
+
+    private:
+    struct Node {
+      std::string path;
+      std::string directory;
+      EntryPtr entry;
+    };
+
+    struct Watch {
+      int descriptor;
+      size_t references;
+      uint64_t generation;   // bumped by every event in the directory; starts at 1
+    };
+
+    const Options options_;
+
+    mutable std::mutex mutex_;
+    std::list<Node> lru_;
+    size_t snapshotBytes_ = 0;
+    std::unordered_map<std::string, std::list<Node>::iterator> index_;
+    std::unordered_map<std::string, Watch> watches_;
+    std::unordered_map<int, std::string> watchedDirectories_;
+
+    int inotifyDescriptor_ = -1;
+    int wakeDescriptor_    = -1;
+    std::thread watcher_;
+
+    EntryPtr load(const std::string& path) const {
+      int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) return nullptr;
+
+      auto entry = std::make_shared<Entry>();
+      entry->fd = fd;
+
+      struct stat info;
+      if (fstat(fd, &info) < 0 || !S_ISREG(info.st_mode)) {
+        return nullptr;
+      }
+
+      if (static_cast<size_t>(info.st_size) <= options_.snapshot_limit &&
+          readSnapshot(fd, info, entry->data, options_.snapshot_limit)) {
+        entry->snapshot = true;
+        close(entry->fd);
+        entry->fd = -1;
+      }
+
+      entry->path         = path;
+      entry->size         = static_cast<size_t>(info.st_size);
+      entry->mtime        = info.st_mtim.tv_sec;
+      entry->lastModified = Helpers::httpDate(info.st_mtim.tv_sec);
+      entry->contentType  = Helpers::mimeType(path);
+
+      // Strong validator built from identity, length and nanosecond mtime
+      char etag[80];
+      unsigned long long mtime_ns =
+        static_cast<unsigned long long>(info.st_mtim.tv_sec) * 1'000'000'000ULL +
+        static_cast<unsigned long long>(info.st_mtim.tv_nsec);
+      std::snprintf(etag, sizeof(etag), "\"%llx-%llx-%llx\"",
+        static_cast<unsigned long long>(info.st_ino),
+        static_cast<unsigned long long>(info.st_size),
+        mtime_ns);
+      entry->etag = etag;
+
+      return entry;
+    }
+
+    // Reads the whole file, retrying while a writer changes it underneath; on
+    // success `info` describes exactly the bytes in `data`
+    static bool readSnapshot(int fd, struct stat& info, std::string& data, size_t limit) {
+      for (int attempt = 0; attempt < 3; ++attempt) {
+        data.resize(static_cast<size_t>(info.st_size));
+
+        size_t offset = 0;
+        while (offset < data.size()) {
+          ssize_t got = pread(fd, &data[offset], data.size() - offset, static_cast<off_t>(offset));
+          if (got < 0 && errno == EINTR) continue;
+          if (got <= 0) break;
+          offset += static_cast<size_t>(got);
+        }
+
+        struct stat after;
+        if (fstat(fd, &after) < 0) return false;
+
+        if (offset == data.size() && after.st_size == info.st_size &&
+            after.st_mtim.tv_sec == info.st_mtim.tv_sec && after.st_mtim.tv_nsec == info.st_mtim.tv_nsec) {
+          return true;
+        }
+        info = after;
+        if (static_cast<size_t>(info.st_size) > limit) break;
+      }
+      data.clear();
+      return false;
+    }
+
+    static std::string parentDirectory(const std::string& path) {
+      auto slash = path.rfind('/');
+      if (slash == std::string::npos) return ".";
+      if (slash == 0) return "/";
+      return path.substr(0, slash);
+    }
+
+    static size_t snapshotSize(const EntryPtr& entry) {
+      return entry && entry->snapshot ? entry->data.size() : 0;
+    }
+
+    // Caller holds mutex_ and a watch reference on `directory`, which the node takes over
+    void insert(const std::string& path, std::string directory, EntryPtr entry) {
+      snapshotBytes_ += snapshotSize(entry);
+      lru_.push_front(Node{path, std::move(directory), std::move(entry)});
+      index_[path] = lru_.begin();
+
+      while (!lru_.empty() && (lru_.size() > options_.capacity || snapshotBytes_ > options_.snapshot_bytes)) {
+        erase(std::prev(lru_.end()));
+      }
+    }
+
+    // Caller holds mutex_
+    void erase(std::list<Node>::iterator node) {
+      snapshotBytes_ -= snapshotSize(node->entry);
+      removeWatch(node->directory);
+      index_.erase(node->path);
+      lru_.erase(node);
+    }
+
+    // Caller holds mutex_
+    bool addWatch(const std::string& directory) {
+      auto it = watches_.find(directory);
+      if (it != watches_.end()) {
+        it->second.references++;
+        return true;
+      }
+
+      int descriptor = inotify_add_watch(inotifyDescriptor_, directory.c_str(),
+        IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+        IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+      if (descriptor < 0) return false;
+
+      // inotify returns the existing descriptor when a directory is reached via another spelling
+      auto existing = watchedDirectories_.find(descriptor);
+      if (existing != watchedDirectories_.end() && existing->second != directory) {
+        return false;
+      }
+
+      watches_[directory] = Watch{descriptor, 1, 1};
+      watchedDirectories_[descriptor] = directory;
+      return true;
+    }
+
+    // Caller holds mutex_
+    void removeWatch(const std::string& directory) {
+      auto it = watches_.find(directory);
+      if (it == watches_.end()) return;
+      if (--it->second.references > 0) return;
+
+      inotify_rm_watch(inotifyDescriptor_, it->second.descriptor);
+      watchedDirectories_.erase(it->second.descriptor);
+      watches_.erase(it);
+    }
+
+    // Caller holds mutex_
+    void invalidateDirectory(const std::string& directory) {
+      std::string prefix = directory == "/" ? directory : directory + "/";
+      for (auto it = lru_.begin(); it != lru_.end();) {
+        auto current = it++;
+        if (current->path.compare(0, prefix.size(), prefix) == 0) erase(current);
+      }
+    }
+
+    void startWatcher() {
+      inotifyDescriptor_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (inotifyDescriptor_ < 0) return;
+
+      wakeDescriptor_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if (wakeDescriptor_ < 0) {
+        close(inotifyDescriptor_);
+        inotifyDescriptor_ = -1;
+        return;
+      }
+
+      watcher_ = std::thread([this]() { watch(); });
+    }
+
+    void stopWatcher() {
+      if (watcher_.joinable()) {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wakeDescriptor_, &one, sizeof(one));
+        (void)ignored;
+        watcher_.join();
+      }
+
+      if (wakeDescriptor_ >= 0) close(wakeDescriptor_);
+      if (inotifyDescriptor_ >= 0) close(inotifyDescriptor_);
+    }
+
+    void watch() {
+      alignas(inotify_event) char buffer[16 * 1024];
+
+      pollfd descriptors[2] = {
+        {inotifyDescriptor_, POLLIN, 0},
+        {wakeDescriptor_, POLLIN, 0}
+      };
+
+      while (true) {
+        if (poll(descriptors, 2, -1) < 0) {
+          if (errno == EINTR) continue;
+          return;
+        }
+        if (descriptors[1].revents & POLLIN) return;
+
+        ssize_t length;
+        while ((length = read(inotifyDescriptor_, buffer, sizeof(buffer))) > 0) {
+          std::lock_guard<std::mutex> lock(mutex_);
+
+          for (char* cursor = buffer; cursor < buffer + length;) {
+            auto* event = reinterpret_cast<inotify_event*>(cursor);
+            cursor += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+              while (!lru_.empty()) erase(std::prev(lru_.end()));
+              for (auto& [name, watch] : watches_) watch.generation++;
+              continue;
+            }
+
+            auto directory = watchedDirectories_.find(event->wd);
+            if (directory == watchedDirectories_.end()) continue;
+            watches_[directory->second].generation++;
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+              invalidateDirectory(directory->second);
+              continue;
+            }
+
+            if (event->len == 0) continue;
+
+            std::string path = directory->second == "/"
+              ? "/" + std::string(event->name)
+              : directory->second + "/" + event->name;
+
+            auto it = index_.find(path);
+            if (it != index_.end()) erase(it->second);
+          }
+        }
+      }
+    }
+  };
+}
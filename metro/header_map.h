@@ -0,0 +1,214 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Metro {
+
+  // Well-known header names and the compile-time perfect hash that resolves them
+  namespace KnownHeader {
+    enum class Id : uint8_t {
+      Host, ContentLength, ContentType, Connection, Accept, AcceptEncoding,
+      AcceptLanguage, TransferEncoding, UserAgent, Cookie, Authorization,
+      CacheControl, IfNoneMatch, IfModifiedSince, ContentEncoding, Vary, ETag,
+      LastModified, Date, Location, Allow, SetCookie, Expect, Upgrade, Origin,
+      Referer, Range, XForwardedFor, XRequestId,
+      Count
+    };
+
+    inline constexpr size_t COUNT = static_cast<size_t>(Id::Count);
+
+    inline constexpr std::array<std::string_view, COUNT> NAMES = {
+      "host", "content-length", "content-type", "connection", "accept", "accept-encoding",
+      "accept-language", "transfer-encoding", "user-agent", "cookie", "authorization",
+      "cache-control", "if-none-match", "if-modified-since", "content-encoding", "vary", "etag",
+      "last-modified", "date", "location", "allow", "set-cookie", "expect", "upgrade", "origin",
+      "referer", "range", "x-forwarded-for", "x-request-id"
+    };
+
+    inline constexpr uint8_t EMPTY = 0xff;
+    inline constexpr size_t TABLE_SIZE = 64;
+
+    constexpr char lower(char c) {
+      return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+    }
+
+    constexpr bool equals(std::string_view a, std::string_view b) {
+      if (a.size() != b.size()) return false;
+      for (size_t i = 0; i < a.size(); ++i) {
+        if (lower(a[i]) != lower(b[i])) return false;
+      }
+      return true;
+    }
+
+    // Collision-free over NAMES for TABLE_SIZE (enforced below); `name` must be non-empty
+    constexpr size_t hash(std::string_view name) {
+      size_t first = static_cast<unsigned char>(lower(name.front()));
+      size_t last = static_cast<unsigned char>(lower(name.back()));
+      return (name.size() * 3 + first * 3 + last * 8) % TABLE_SIZE;
+    }
+
+    constexpr std::array<uint8_t, TABLE_SIZE> buildTable() {
+      std::array<uint8_t, TABLE_SIZE> table{};
+      for (auto& entry : table) entry = EMPTY;
+      for (size_t i = 0; i < COUNT; ++i) {
+        size_t h = hash(NAMES[i]);
+        table[h] = table[h] == EMPTY ? static_cast<uint8_t>(i) : EMPTY;
+      }
+      return table;
+    }
+
+    inline constexpr std::array<uint8_t, TABLE_SIZE> TABLE = buildTable();
+
+    constexpr bool perfect() {
+      for (size_t i = 0; i < COUNT; ++i) {
+        if (TABLE[hash(NAMES[i])] != i) return false;
+      }
+      return true;
+    }
+
+    static_assert(COUNT < EMPTY, "well-known header ids must fit below the EMPTY marker");
+    static_assert(perfect(), "well-known header hash collides; adjust hash() or TABLE_SIZE");
+
+    // Id::Count when `name` is not a well-known header
+    constexpr Id resolve(std::string_view name) {
+      if (name.empty()) return Id::Count;
+
+      uint8_t candidate = TABLE[hash(name)];
+      if (candidate == EMPTY) return Id::Count;
+      return equals(name, NAMES[candidate]) ? static_cast<Id>(candidate) : Id::Count;
+    }
+
+    static_assert(resolve("Content-Length") == Id::ContentLength, "well-known header lookup is broken");
+    static_assert(resolve("x-custom") == Id::Count, "well-known header lookup is broken");
+  }
+
+  /**
+   * Header storage for requests and responses: a flat vector of fields in
+   * arrival order plus one slot per well-known header.
+   *
+   * Well-known names (Host, Content-Length, Connection, ...) are recognised by
+   * a compile-time perfect hash over length, first and last character, checked
+   * with a single compare against the canonical name. Once a Known id is in
+   * hand (as in the parser and writer) a lookup is one array read. Other names
+   * fall back to a linear scan, which beats hashing for the dozen or so headers
+   * a request carries.
+   *
+   * Names compare case-insensitively and keep the spelling they were set with.
+   * set() replaces an existing value. Memory comes from the given resource,
+   * normally the connection's RequestArena.
+   */
+  class HeaderMap {
+    public:
+    using Known = KnownHeader::Id;
+
+    static constexpr size_t KNOWN = KnownHeader::COUNT;
+
+    struct Field {
+      std::pmr::string name;
+      std::pmr::string value;
+    };
+
+    using Fields = std::pmr::vector<Field>;
+    using const_iterator = Fields::const_iterator;
+
+    HeaderMap() = default;
+    explicit HeaderMap(std::pmr::memory_resource* resource) : fields_(resource) {}
+
+    // Headers written out by hand, e.g. client.get("/", {{"Accept", "text/html"}})
+    HeaderMap(std::initializer_list<std::pair<std::string_view, std::string_view>> fields) {
+      for (const auto& [name, value] : fields) set(name, value);
+    }
+
+    // Canonical lowercase name of a well-known header
+    static constexpr std::string_view name(Known id) {
+      return KnownHeader::NAMES[static_cast<size_t>(id)];
+    }
+
+    // Resolves a name to its well-known id; Known::Count when it is not one
+    static constexpr Known known(std::string_view name) {
+      return KnownHeader::resolve(name);
+    }
+
+    const std::pmr::string* get(Known id) const {
+      uint16_t slot = slots_[static_cast<size_t>(id)];
+      return slot ? &fields_[slot - 1].value : nullptr;
+    }
+
+    const std::pmr::string* get(std::string_view name) const {
+      Known id = known(name);
+      if (id != Known::Count) return get(id);
+
+      for (const auto& field : fields_) {
+        if (KnownHeader::equals(field.name, name)) return &field.value;
+      }
+      return nullptr;
+    }
+
+    bool contains(Known id) const { return slots_[static_cast<size_t>(id)] != 0; }
+    bool contains(std::string_view name) const { return get(name) != nullptr; }
+
+    void set(std::string_view name, std::string_view value) {
+      Known id = known(name);
+      size_t index = indexOf(name, id);
+
+      if (index < fields_.size()) {
+        fields_[index].value.assign(value);
+        return;
+      }
+
+      fields_.push_back(Field{
+        std::pmr::string(name, fields_.get_allocator()),
+        std::pmr::string(value, fields_.get_allocator())
+      });
+      if (id != Known::Count) slots_[static_cast<size_t>(id)] = static_cast<uint16_t>(fields_.size());
+    }
+
+    bool erase(std::string_view name) {
+      size_t index = indexOf(name, known(name));
+      if (index >= fields_.size()) return false;
+
+      fields_.erase(fields_.begin() + static_cast<std::ptrdiff_t>(index));
+
+      // Slots hold index + 1; drop the erased one and shift those behind it
+      for (auto& slot : slots_) {
+        if (slot == index + 1) slot = 0;
+        else if (slot > index + 1) --slot;
+      }
+      return true;
+    }
+
+    void clear() {
+      fields_.clear();
+      slots_.fill(0);
+    }
+
+    size_t size() const noexcept { return fields_.size(); }
+    bool empty() const noexcept { return fields_.empty(); }
+
+    const_iterator begin() const noexcept { return fields_.begin(); }
+    const_iterator end() const noexcept { return fields_.end(); }
+
+    private:
+    Fields fields_;
+    std::array<uint16_t, KNOWN> slots_{};
+
+    size_t indexOf(std::string_view name, Known id) const {
+      if (id != Known::Count) {
+        uint16_t slot = slots_[static_cast<size_t>(id)];
+        return slot ? slot - 1 : fields_.size();
+      }
+      for (size_t i = 0; i < fields_.size(); ++i) {
+        if (KnownHeader::equals(fields_[i].name, name)) return i;
+      }
+      return fields_.size();
+    }
+  };
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "header_map.h"
+
+namespace Metro {
+
+  /**
+   * Load balancer probes answered before the request is parsed.
+   *
+   * Each probe is a request-line prefix such as "GET /healthz". Once the
+   * server has read a request head it compares the head against these
+   * prefixes, before the request line and headers are parsed and before
+   * routing or middleware. A match is answered from bytes serialized when the
+   * probe was added, so a probe costs one compare and one send(2). Probes are
+   * not logged and do not show up in metrics.
+   *
+   * Liveness probes always answer 200. Readiness probes answer 200 or 503
+   * depending on an atomic flag that the app flips with setReady(), for
+   * example false until warmup finishes and false again while draining.
+   * The flag starts true.
+   *
+   *   HealthCheck health;
+   *   health.liveness("GET /healthz").readiness("GET /readyz");
+   *   server.setHealthCheck(health);
+   */
+  class HealthCheck {
+    public:
+    HealthCheck() = default;
+    HealthCheck(const HealthCheck&) = delete;
+    HealthCheck& operator=(const HealthCheck&) = delete;
+
+    // `requestLine` is the method and path, e.g. "GET /healthz"; a query string still matches
+    HealthCheck& liveness(const std::string& requestLine) {
+      probes_.push_back(makeProbe(requestLine, false));
+      return *this;
+    }
+
+    HealthCheck& readiness(const std::string& requestLine) {
+      probes_.push_back(makeProbe(requestLine, true));
+      return *this;
+    }
+
+    void setReady(bool ready) noexcept { ready_.store(ready, std::memory_order_release); }
+    bool ready() const noexcept { return ready_.load(std::memory_order_acquire); }
+
+    // Pre-serialized response for `head` when it is a probe, otherwise nullptr.
+    // `close` is set when the response closes the connection.
+    const std::string* match(std::string_view head, bool forceClose, bool& close) const {
+      for (const auto& probe : probes_) {
+        if (head.compare(0, probe.prefix.size(), probe.prefix) != 0) continue;
+
+        std::string_view rest = head.substr(probe.prefix.size());
+        if (rest.empty() || (rest.front() != ' ' && rest.front() != '?')) continue;
+
+        std::string_view line = rest.substr(0, rest.find("\r\n"));
+        size_t version = line.find(" HTTP/1.");
+        if (version == std::string_view::npos || version + 9 != line.size()) continue;
+
+        // HTTP/1.0 probes get Connection: close, as do 1.1 probes that ask for it
+        close = forceClose || line.back() != '1' || wantsClose(rest);
+
+        bool up = !probe.readiness || ready();
+        return &probe.responses[(up ? 0 : 2) + (close ? 1 : 0)];
+      }
+      return nullptr;
+    }
+
+    bool empty() const noexcept { return probes_.empty(); }
+
+    private:
+    struct Probe {
+      std::string prefix;
+      bool readiness;
+      // Indexed by (unavailable ? 2 : 0) + (close ? 1 : 0)
+      std::array<std::string, 4> responses;
+    };
+
+    std::vector<Probe> probes_;
+    std::atomic<bool> ready_{true};
+
+    static Probe makeProbe(const std::string& requestLine, bool readiness) {
+      bool head = requestLine.compare(0, 5, "HEAD ") == 0;
+
+      Probe probe{requestLine, readiness, {}};
+      probe.responses[0] = serialize("200 OK", "OK", false, head);
+      probe.responses[1] = serialize("200 OK", "OK", true, head);
+      probe.responses[2] = serialize("503 Service Unavailable", "Unavailable", false, head);
+      probe.responses[3] = serialize("503 Service Unavailable", "Unavailable", true, head);
+      return probe;
+    }
+
+    static std::string serialize(const char* status, const std::string& body, bool close, bool head) {
+      std::string response = "HTTP/1.1 ";
+      response += status;
+      response += "\r\nContent-Type: text/plain\r\nContent-Length: " + std::to_string(body.size());
+      response += close ? "\r\nConnection: close\r\n\r\n" : "\r\nConnection: keep-alive\r\n\r\n";
+      if (!head) response += body;
+      return response;
+    }
+
+    // Looks for a "Connection: close" header line without parsing the head
+    static bool wantsClose(std::string_view head) {
+      constexpr std::string_view name = "connection:";
+
+      for (size_t line = head.find("\r\n"); line != std::string_view::npos; line = head.find("\r\n", line + 2)) {
+        std::string_view field = head.substr(line + 2, head.find("\r\n", line + 2) - (line + 2));
+        if (field.empty()) break;   // end of the head; a pipelined request may follow
+        if (field.size() < name.size() || !KnownHeader::equals(field.substr(0, name.size()), name)) continue;
+
+        std::string_view value = field.substr(name.size());
+        for (size_t i = 0; i + 5 <= value.size(); ++i) {
+          if (KnownHeader::equals(value.substr(i, 5), "close")) return true;
+        }
+        return false;
+      }
+      return false;
+    }
+  };
+}
@@ -7,6 +7,8 @@
 #include <vector>
 #include <cctype>
 #include <algorithm>
+#include <ctime>
+#include <cstdlib>
 
 #include "constants.h"
 
@@ -90,6 +92,97 @@ namespace Metro {
       }
     }
 
+    inline std::string httpDate(std::time_t time) {
+      std::tm gmt_time;
+      gmtime_r(&time, &gmt_time);
+
+      char buffer[64];
+      strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &gmt_time);
+      return buffer;
+    }
+
+    inline const char* mimeType(const std::string& path) {
+      auto dot = path.rfind('.');
+      auto slash = path.rfind('/');
+      if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return Constants::Http_Content_Type::APPLICATION_OCTET_STREAM;
+      }
+
+      std::string extension = path.substr(dot + 1);
+      std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+      // Text types
+      if (extension == "html" || extension == "htm") return "text/html; charset=utf-8";
+      if (extension == "css")                         return "text/css; charset=utf-8";
+      if (extension == "js" || extension == "mjs")    return "text/javascript; charset=utf-8";
+      if (extension == "txt")                         return "text/plain; charset=utf-8";
+      if (extension == "csv")                         return "text/csv; charset=utf-8";
+      if (extension == "md")                          return "text/markdown; charset=utf-8";
+
+      // Application types
+      if (extension == "json" || extension == "map")  return Constants::Http_Content_Type::APPLICATION_JSON;
+      if (extension == "webmanifest")                 return Constants::Http_Content_Type::APPLICATION_MANIFEST_JSON;
+      if (extension == "xml")                         return Constants::Http_Content_Type::APPLICATION_XML;
+      if (extension == "pdf")                         return Constants::Http_Content_Type::APPLICATION_PDF;
+      if (extension == "wasm")                        return Constants::Http_Content_Type::APPLICATION_WASM;
+
+      // Images
+      if (extension == "png")                         return Constants::Http_Content_Type::IMAGE_PNG;
+      if (extension == "jpg" || extension == "jpeg")  return Constants::Http_Content_Type::IMAGE_JPEG;
+      if (extension == "gif")                         return Constants::Http_Content_Type::IMAGE_GIF;
+      if (extension == "svg")                         return Constants::Http_Content_Type::IMAGE_SVG_XML;
+      if (extension == "webp")                        return Constants::Http_Content_Type::IMAGE_WEBP;
+      if (extension == "avif")                        return Constants::Http_Content_Type::IMAGE_AVIF;
+      if (extension == "ico")                         return Constants::Http_Content_Type::IMAGE_X_ICON;
+
+      // Fonts and media
+      if (extension == "woff")                        return Constants::Http_Content_Type::FONT_WOFF;
+      if (extension == "woff2")                       return Constants::Http_Content_Type::FONT_WOFF2;
+      if (extension == "ttf")                         return Constants::Http_Content_Type::FONT_TTF;
+      if (extension == "otf")                         return Constants::Http_Content_Type::FONT_OTF;
+      if (extension == "mp4")                         return Constants::Http_Content_Type::VIDEO_MP4;
+      if (extension == "webm")                        return Constants::Http_Content_Type::VIDEO_WEBM;
+      if (extension == "mp3")                         return Constants::Http_Content_Type::AUDIO_MPEG;
+
+      return Constants::Http_Content_Type::APPLICATION_OCTET_STREAM;
+    }
+
+    // True when an Accept-Encoding value allows the given content coding (q > 0)
+    inline bool acceptsEncoding(const std::string& acceptEncoding, const std::string& coding) {
+      bool wildcardAccepted = false;
+      bool explicitlyListed = false;
+      size_t position = 0;
+
+      while (position < acceptEncoding.size()) {
+        size_t end = acceptEncoding.find(',', position);
+        if (end == std::string::npos) end = acceptEncoding.size();
+
+        std::string item = acceptEncoding.substr(position, end - position);
+        position = end + 1;
+
+        size_t semicolon = item.find(';');
+        std::string token = item.substr(0, semicolon);
+        token.erase(0, token.find_first_not_of(" \t"));
+        token.erase(token.find_last_not_of(" \t") + 1);
+        std::transform(token.begin(), token.end(), token.begin(), ::tolower);
+
+        double quality = 1.0;
+        if (semicolon != std::string::npos) {
+          size_t q = item.find("q=", semicolon);
+          if (q != std::string::npos) quality = std::atof(item.c_str() + q + 2);
+        }
+
+        if (token == coding) {
+          explicitlyListed = true;
+          if (quality > 0.0) return true;
+        } else if (token == "*" && quality > 0.0) {
+          wildcardAccepted = true;
+        }
+      }
+
+      return wildcardAccepted && !explicitlyListed;
+    }
+
     class PathSanitizer {
       public:
       /**
@@ -135,28 +228,20 @@ namespace Metro {
           segments.push_back(decoded);
         }
 
-        // Step 2: Resolve path traversal using stack
-        std::vector<std::string> resolved;
-        for (const auto& seg : segments) {
-          if (seg == "." || seg.empty()) {
-            continue; 
-          } else if (seg == "..") {
-            if (!resolved.empty()) {
-              resolved.pop_back();  
-            }
-          } else {
-            resolved.push_back(seg);
-          }
-        }
+        return resolve(segments);
+      }
 
-        // Step 3: Reconstruct path
-        std::string result = "/";
-        for (size_t i = 0; i < resolved.size(); ++i) {
-          if (i > 0) result += "/";
-          result += resolved[i];
+      // normalize() for a path that has been decoded already, such as a route
+      // wildcard: resolves "." and ".." without decoding '%' a second time
+      static std::string resolveDecoded(const std::string& path) {
+        std::vector<std::string> segments;
+        size_t start = 0;
+        while (start <= path.size()) {
+          size_t end = std::min(path.find('/', start), path.size());
+          segments.push_back(path.substr(start, end - start));
+          start = end + 1;
         }
-        
-        return result;
+        return resolve(segments);
       }
 
       static std::string encodeSegment(const std::string& input, bool formData = false) {
@@ -216,6 +301,31 @@ namespace Metro {
 
       private:
       
+      static std::string resolve(const std::vector<std::string>& segments) {
+        // Step 2: Resolve path traversal using stack
+        std::vector<std::string> resolved;
+        for (const auto& seg : segments) {
+          if (seg == "." || seg.empty()) {
+            continue; 
+          } else if (seg == "..") {
+            if (!resolved.empty()) {
+              resolved.pop_back();  
+            }
+          } else {
+            resolved.push_back(seg);
+          }
+        }
+
+        // Step 3: Reconstruct path
+        std::string result = "/";
+        for (size_t i = 0; i < resolved.size(); ++i) {
+          if (i > 0) result += "/";
+          result += resolved[i];
+        }
+        
+        return result;
+      }
+
       static unsigned char hexValue(char c) {
         if (c >= '0' && c <= '9') return c - '0';
         if (c >= 'A' && c <= 'F') return c - 'A' + 10;
@@ -17,4 +17,20 @@ namespace Metro {
   private:
     int _status;
   };
+
+  // Exception-free counterpart of HttpError for the parser and router, whose
+  // failures (malformed requests, 404/405 from scanners) are routine traffic
+  struct HttpFailure {
+    int status = 0;
+    std::string message;
+
+    explicit operator bool() const noexcept { return status != 0; }
+
+    // Records the failure and returns false, so stages can `return failure.fail(...)`
+    bool fail(int code, std::string text) {
+      status = code;
+      message = std::move(text);
+      return false;
+    }
+  };
 }
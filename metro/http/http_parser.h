@@ -2,9 +2,13 @@
 
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <algorithm>
+#include <charconv>
+#include <limits>
 #include <cstddef>
+#include <cerrno>
 
 #include <unistd.h>
 #include <sys/socket.h>
@@ -15,6 +19,7 @@
 #include "config.h"
 #include "types.h"
 #include "http_error.h"
+#include "buffer_pool.h"
 
 // TODO: Buffer Overflows: Reading into fixed-size std::vector<char> without bounds checking on recv return values.
 
@@ -43,8 +48,10 @@ namespace Metro {
 
   class FormDataParser {
     public:
-    static void parseMulti(const std::string& input, 
-                          std::unordered_map<std::string, std::vector<std::string>>& out) {
+    // Map is keyed by std::string or std::pmr::string (request query storage);
+    // pmr values are built in the map's resource
+    template <typename Map>
+    static void parseMulti(const std::string& input, Map& out) {
       std::istringstream ss(input);
       std::string pair;
 
@@ -56,7 +63,7 @@ namespace Metro {
         std::string val = (eq == std::string::npos) ? "" 
                         : Helpers::PathSanitizer::decodeSegment(pair.substr(eq + 1));
 
-        out[key].push_back(val);
+        out[typename Map::key_type(key, out.get_allocator())].emplace_back(val.data(), val.size());
       }
     }
 
@@ -82,69 +89,169 @@ namespace Metro {
 
   // TODO: Header Injection: No validation of header values for CR/LF injection.
 
-  class HttpHeaderReader {
+  /**
+   * Gathers one request from a non-blocking socket across readiness events:
+   * its head, then the Content-Length body announced in it.
+   *
+   * receive() reads until the socket would block and never waits, so a slow
+   * client holds no thread; the server bounds each stage with a deadline
+   * instead. A body the parser is going to reject (bad or oversized
+   * Content-Length, any Transfer-Encoding) is not waited for: the request is
+   * complete at the end of its head, and parseHead() answers it.
+   */
+  class HttpRequestReader {
     public:
-
-    HttpHeaderReader(
-      int clientSocket,
-      std::string& buffer,
-      size_t& total_bytes_read,
-      const HttpLimits& limits
-    ) : 
-      clientSocket(clientSocket),
-      buffer(buffer),
-      total_bytes_read(total_bytes_read),
-      limits(limits),
-      chunk(limits.max_buffer_size) {}
-
-    bool read() {
-      while (!headersComplete()) {
-        if (!receiveChunk()) return false;
-        appendChunk();
-        if (!checkLimits()) return false;
+    enum class Status { NeedMore, Complete, Closed };
+    enum class Stage { Idle, Head, Body };   // Idle: no byte of the request yet
+
+    // Starts over for the next request on the connection. Bytes the client
+    // pipelined behind the finished request stay in `buffer` and begin the
+    // next one; `buffer` keeps its capacity
+    void reset(std::string& buffer) {
+      if (stage_ == Stage::Body && buffer.size() > expected_) {
+        buffer.erase(0, expected_);
+      } else {
+        buffer.clear();
       }
-      return true;
+      stage_ = Stage::Idle;
+      scanned_ = 0;
+      expected_ = 0;
+      bytes_ = buffer.size();
+      failure_ = HttpFailure{};
     }
 
-    private:
-    int clientSocket;
-    std::string& buffer;
-    size_t& total_bytes_read;
-    const HttpLimits& limits;
+    // Whether `buffer` holds bytes past the request just gathered, i.e. the
+    // start of a pipelined one that epoll will not report again
+    bool pipelined(const std::string& buffer) const {
+      return stage_ == Stage::Body && buffer.size() > expected_;
+    }
 
-    std::vector<char> chunk;
-    ssize_t last_bytes_read = 0;
+    Status receive(int clientSocket, std::string& buffer, const HttpLimits& limits, bool timed) {
+      bool headArrived = false;   // in this call, so the body did not keep the request waiting
 
-    bool headersComplete() const {
-      return buffer.find("\r\n\r\n") != std::string::npos;
-    }
+      // A pipelined request left over from the previous one may already be complete
+      if (stage_ == Stage::Idle && !buffer.empty() && advance(buffer, limits, timed, headArrived)) {
+        return Status::Complete;
+      }
 
-    bool receiveChunk() {
-      last_bytes_read = recv(clientSocket, chunk.data(), chunk.size(), 0);
-      return last_bytes_read > 0;
-    }
+      // Held only for this call, so `buffer` grows to the request and no further
+      BufferPool::Buffer chunk = BufferPool::shared().acquire(limits.max_buffer_size);
+
+      while (true) {
+        // The body is read only up to its end; bytes read past it with the head are kept by reset()
+        size_t want = chunk.size();
+        if (stage_ == Stage::Body) want = std::min(want, expected_ - buffer.size());
+
+        ssize_t got = recv(clientSocket, chunk.data(), want, 0);
+        if (got == 0) return Status::Closed;
+        if (got < 0) {
+          if (errno == EINTR) continue;
+          if (errno == EAGAIN || errno == EWOULDBLOCK) return Status::NeedMore;
+          return Status::Closed;
+        }
 
-    void appendChunk() {
-      buffer.append(chunk.data(), last_bytes_read);
-      total_bytes_read += static_cast<size_t>(last_bytes_read);
+        buffer.append(chunk.data(), static_cast<size_t>(got));
+        bytes_ += static_cast<size_t>(got);
+        if (advance(buffer, limits, timed, headArrived)) return Status::Complete;
+      }
     }
 
-    bool checkLimits() const {
-      if (buffer.size() > limits.max_header_size) {
-        throw HttpError(
-          Constants::Http_Status::REQUEST_HEADER_FIELDS_TOO_LARGE, 
-          Helpers::reasonPhrase(Constants::Http_Status::REQUEST_HEADER_FIELDS_TOO_LARGE)
-        );
+    Stage stage() const { return stage_; }
+
+    // Set when the head outgrew max_header_size; the request is answered with it
+    HttpFailure& failure() { return failure_; }
+
+    // Bytes of this request, not counting any pipelined behind it
+    size_t bytesReceived() const { return stage_ == Stage::Body ? expected_ : bytes_; }
+
+    // Timed receives only: when the first byte, the end of the head and the last body byte arrived
+    Timing::Clock::time_point firstByteAt() const { return firstByteAt_; }
+    Timing::Clock::time_point headEndAt() const { return headEndAt_; }
+    Timing::Clock::time_point completeAt() const { return completeAt_; }
+
+    private:
+    Stage stage_ = Stage::Idle;
+    size_t scanned_ = 0;     // head bytes already searched for the blank line
+    size_t expected_ = 0;    // head plus body, once the head is in
+    size_t bytes_ = 0;
+    HttpFailure failure_;
+    Timing::Clock::time_point firstByteAt_;
+    Timing::Clock::time_point headEndAt_;
+    Timing::Clock::time_point completeAt_;
+
+    // Moves through the stages as far as the bytes in `buffer` allow; true once the request is complete
+    bool advance(std::string& buffer, const HttpLimits& limits, bool timed, bool& headArrived) {
+      if (stage_ == Stage::Idle) {
+        stage_ = Stage::Head;
+        if (timed) firstByteAt_ = Timing::Clock::now();
+      }
+
+      if (stage_ == Stage::Head) {
+        size_t end = buffer.find("\r\n\r\n", scanned_);
+        size_t headSize = end == std::string::npos ? buffer.size() : end + 4;
+        if (headSize > limits.max_header_size) {
+          failure_.fail(
+            Constants::Http_Status::REQUEST_HEADER_FIELDS_TOO_LARGE,
+            Helpers::reasonPhrase(Constants::Http_Status::REQUEST_HEADER_FIELDS_TOO_LARGE)
+          );
+          return true;
+        }
+
+        if (end == std::string::npos) {
+          // The terminator may straddle this chunk and the next
+          scanned_ = buffer.size() >= 3 ? buffer.size() - 3 : 0;
+          return false;
+        }
+
+        if (timed) headEndAt_ = Timing::Clock::now();
+        headArrived = true;
+        expected_ = end + 4 + announcedLength(std::string_view(buffer).substr(0, end), limits);
+        buffer.reserve(expected_);
+        stage_ = Stage::Body;
       }
 
+      if (buffer.size() < expected_) return false;
+      if (timed) completeAt_ = headArrived ? headEndAt_ : Timing::Clock::now();
       return true;
     }
+
+    // Body bytes to wait for; 0 when HttpBodyParser will reject the framing anyway
+    static size_t announcedLength(std::string_view head, const HttpLimits& limits) {
+      constexpr std::string_view contentLength = "content-length:";
+      constexpr std::string_view transferEncoding = "transfer-encoding:";
+      size_t length = 0;
+
+      for (size_t line = head.find("\r\n"); line != std::string_view::npos; line = head.find("\r\n", line + 2)) {
+        std::string_view field = head.substr(line + 2, head.find("\r\n", line + 2) - (line + 2));
+
+        if (field.size() >= transferEncoding.size() &&
+            KnownHeader::equals(field.substr(0, transferEncoding.size()), transferEncoding)) {
+          return 0;
+        }
+        if (field.size() < contentLength.size() ||
+            !KnownHeader::equals(field.substr(0, contentLength.size()), contentLength)) {
+          continue;
+        }
+
+        std::string_view value = field.substr(contentLength.size());
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+
+        unsigned long long parsed = 0;
+        auto [pointer, error] = std::from_chars(value.data(), value.data() + value.size(), parsed);
+        if (error != std::errc() || pointer != value.data() + value.size() || parsed > limits.max_body_size) {
+          return 0;
+        }
+        length = static_cast<size_t>(parsed);
+      }
+      return length;
+    }
   };
 
   class HttpRequestLineParser {
     public:
-    explicit HttpRequestLineParser(const HttpLimits& limits)
-      : limits(limits) {}
+    HttpRequestLineParser(const HttpLimits& limits, HttpFailure& failure)
+      : limits(limits), failure(failure) {}
 
     bool parse(std::istream& input, Context& context) {
       if (!readRequestLine(input, context)) return false;
@@ -154,6 +261,7 @@ namespace Metro {
 
     private:
     const HttpLimits& limits;
+    HttpFailure& failure;
     std::string rawPath;
 
     bool readRequestLine(std::istream& input, Context& context) {
@@ -163,38 +271,37 @@ namespace Metro {
       context.req.setMethod(std::move(method_str));
 
       if (rawPath.empty() || version.empty()) {
-        throw HttpError(Constants::Http_Status::BAD_REQUEST, "Malformed request line");
+        return failure.fail(Constants::Http_Status::BAD_REQUEST, "Malformed request line");
       }
 
       if (version.substr(0, 5) != "HTTP/") {
-        throw HttpError(Constants::Http_Status::BAD_REQUEST, "Invalid HTTP version");
+        return failure.fail(Constants::Http_Status::BAD_REQUEST, "Invalid HTTP version");
       }
 
       return true;
     }
 
+    // The only place the path is percent-decoded; the query is split off
+    // first, so an encoded '?' stays in the path and its pairs are decoded once
     bool processPath(Context& context) {
-      rawPath = Helpers::PathSanitizer::normalize(rawPath, limits.validate_UTF_8);
-      if (rawPath.empty()) {
-        throw HttpError(
+      auto query = rawPath.find('?');
+      std::string path = Helpers::PathSanitizer::normalize(rawPath.substr(0, query), limits.validate_UTF_8);
+      if (path.empty()) {
+        return failure.fail(
           Constants::Http_Status::BAD_REQUEST, 
           Helpers::reasonPhrase(Constants::Http_Status::BAD_REQUEST)
         );
       }
 
-      auto query = rawPath.find('?');
-      if (query == std::string::npos) {
-        context.req.setPath(rawPath);
-        return true;
-      }
+      context.req.setPath(std::move(path));
+      if (query == std::string::npos) return true;
 
-      context.req.setPath(rawPath.substr(0, query));
       return parseQueryString(rawPath.substr(query + 1), context);
     }
 
     bool parseQueryString(const std::string& queryString, Context& context) {
       if (countQueryParams(queryString) > limits.max_query_params) {
-        throw HttpError(
+        return failure.fail(
           Constants::Http_Status::URI_TOO_LONG, 
           Helpers::reasonPhrase(Constants::Http_Status::URI_TOO_LONG)
         );
@@ -214,21 +321,22 @@ namespace Metro {
 
   class HttpHeadersParser {
     public:
-    explicit HttpHeadersParser(const HttpLimits& limits)
-      : limits(limits) {}
+    HttpHeadersParser(const HttpLimits& limits, HttpFailure& failure)
+      : limits(limits), failure(failure) {}
 
     bool parse(std::istream& input, Context& context) {
       skipRequestLine(input);
 
       while (readNextHeaderLine(input)) {
         if (!validateHeaderCount()) { return false; }
-        storeHeader(context);
+        if (!storeHeader(context)) { return false; }
       }
       return true;
     }
 
     private:
     const HttpLimits& limits;
+    HttpFailure& failure;
     std::string line;
     size_t header_count = 0;
 
@@ -243,7 +351,7 @@ namespace Metro {
 
     bool validateHeaderCount() {
       if (++header_count > limits.max_headers_count) {
-        throw HttpError(
+        return failure.fail(
           Constants::Http_Status::REQUEST_HEADER_FIELDS_TOO_LARGE, 
           Helpers::reasonPhrase(Constants::Http_Status::REQUEST_HEADER_FIELDS_TOO_LARGE)
         );
@@ -251,17 +359,17 @@ namespace Metro {
       return true;
     }
 
-    void storeHeader(Context& context) {
+    bool storeHeader(Context& context) {
       auto pos = line.find(':');
-      if (pos == std::string::npos) return;
+      if (pos == std::string::npos) return true;
 
-      std::string key = line.substr(0, pos);
-      std::string value = line.substr(pos + 1);
-      trim(value);
+      // Views into `line`; HeaderMap copies them into the request arena
+      std::string_view key = std::string_view(line).substr(0, pos);
+      std::string_view value = trim(std::string_view(line).substr(pos + 1));
 
       // Header values MUST NOT contain CR (0x0D) or LF (0x0A)
       if (value.find('\r') != std::string::npos || value.find('\n') != std::string::npos) {
-        throw HttpError(
+        return failure.fail(
           Constants::Http_Status::BAD_REQUEST,
           "Invalid header value: contains carriage return or line feed"
         );
@@ -269,16 +377,17 @@ namespace Metro {
 
       // Validate header names don't contain dangerous chars
       if (key.find('\r') != std::string::npos || key.find('\n') != std::string::npos || key.find(':') != std::string::npos) {
-        throw HttpError(
+        return failure.fail(
           Constants::Http_Status::BAD_REQUEST,
           "Invalid header name"
         );
       }
 
       context.req.setHeader(key, value);
+      return true;
     }
 
-    inline void trim(std::string& value) {
+    inline std::string_view trim(std::string_view value) {
       constexpr char space_char = ' ';
       constexpr char tab_char = '\t';
       constexpr char carriage_return_char = '\r';
@@ -296,7 +405,7 @@ namespace Metro {
         }
         ++trim_start_position;
       }
-      value.erase(0, trim_start_position);
+      value.remove_prefix(trim_start_position);
         
       // Right trim
       size_t trim_end_position = value.size();
@@ -310,42 +419,61 @@ namespace Metro {
         }
         --trim_end_position;
       }
-      value.erase(trim_end_position);
+      return value.substr(0, trim_end_position);
     }
   };
 
   class HttpBodyParser {
     public:
-    HttpBodyParser(int clientSocket, const std::string& buffer, const HttpLimits& limits)
-      : clientSocket(clientSocket),
+    HttpBodyParser(
+      int clientSocket,
+      const std::string& buffer,
+      const HttpLimits& limits,
+      HttpFailure& failure
+    ) : clientSocket(clientSocket),
         buffer(buffer),
-        limits(limits) {}
+        limits(limits),
+        failure(failure) {}
 
     bool parse(Context& context) {
+      Timing& timing = context.timing;
+      auto readStart = timing.now();
+
       if (!validateTransferEncoding(context)) return false;
       if (!readInitialBody(context)) return false;
       if (!readRemainingBody(context)) return false;
 
+      auto decodeStart = timing.now();
+      timing.add(Timing::Phase::BodyRead, readStart, decodeStart);
+
       context.req.setBody(parseBody(context));
+      if (failure) return false;
 
+      timing.add(Timing::Phase::BodyDecode, decodeStart, timing.now());
       return true;
     }
 
+    // Body bytes received beyond the header buffer
+    size_t bytesRead() const { return socket_bytes_read; }
+
     private:
     int clientSocket;
     std::string rawBody;
     const std::string& buffer;
     const HttpLimits& limits;
+    HttpFailure& failure;
+    size_t content_length = 0;
+    size_t socket_bytes_read = 0;
 
     bool validateTransferEncoding(Context& context) {
       auto transferEncoding =
-        context.req.header(Constants::Http_Header::TRANSFER_ENCODING);
+        context.req.header(HeaderMap::Known::TransferEncoding);
 
       auto contentLength = 
-        context.req.header(Constants::Http_Header::CONTENT_LENGTH);
+        context.req.header(HeaderMap::Known::ContentLength);
 
       if (transferEncoding && contentLength) {
-        throw HttpError(
+        return failure.fail(
           Constants::Http_Status::BAD_REQUEST,
           Helpers::reasonPhrase(Constants::Http_Status::BAD_REQUEST)
         );
@@ -358,13 +486,13 @@ namespace Metro {
         if (te.find("chunked") != std::string::npos) {
           // TODO: Implement chunked transfer coding parser per RFC 7230 §4.1
           // For now: Reject as Not Implemented (avoid 411 which implies CL is required)
-          throw HttpError(
+          return failure.fail(
             Constants::Http_Status::NOT_IMPLEMENTED,
             "Chunked transfer encoding not implemented"
           );
         }
         
-        throw HttpError(
+        return failure.fail(
           Constants::Http_Status::NOT_IMPLEMENTED,
           "Transfer-Encoding not supported"
         );
@@ -373,11 +501,43 @@ namespace Metro {
       return true;
     }
 
+    // Digits only; rejects signs, trailing garbage and overflow without throwing
+    bool parseContentLength(const std::string& header, size_t& contentLength) {
+      unsigned long long value = 0;
+      const char* end = header.data() + header.size();
+      auto [pointer, error] = std::from_chars(header.data(), end, value);
+
+      if (error == std::errc::result_out_of_range) {
+        return failure.fail(
+          Constants::Http_Status::PAYLOAD_TOO_LARGE,
+          Helpers::reasonPhrase(Constants::Http_Status::PAYLOAD_TOO_LARGE)
+        );
+      }
+      if (error != std::errc() || pointer != end) {
+        return failure.fail(
+          Constants::Http_Status::BAD_REQUEST,
+          "Invalid Content-Length"
+        );
+      }
+
+      // Check if value exceeds size_t max (32-bit safety) or max_body_size
+      if (value > static_cast<unsigned long long>(limits.max_body_size) ||
+          value > static_cast<unsigned long long>(std::numeric_limits<size_t>::max())) {
+        return failure.fail(
+          Constants::Http_Status::PAYLOAD_TOO_LARGE, 
+          Helpers::reasonPhrase(Constants::Http_Status::PAYLOAD_TOO_LARGE)
+        );
+      }
+
+      contentLength = static_cast<size_t>(value);
+      return true;
+    }
+
     bool readInitialBody(Context& context) {
       auto contentLengthHeader =
-        context.req.header(Constants::Http_Header::CONTENT_LENGTH);
+        context.req.header(HeaderMap::Known::ContentLength);
       auto contentTypeHeader =
-        context.req.header(Constants::Http_Header::CONTENT_TYPE);
+        context.req.header(HeaderMap::Known::ContentType);
 
       if (!contentLengthHeader) {
         rawBody.clear();
@@ -385,149 +545,87 @@ namespace Metro {
       }
 
       if (!contentTypeHeader) {
-        throw HttpError(
+        return failure.fail(
           Constants::Http_Status::UNSUPPORTED_MEDIA_TYPE,
           Helpers::reasonPhrase(Constants::Http_Status::UNSUPPORTED_MEDIA_TYPE)
         );
       }
 
-      try {
-        // Use stoull (64-bit) to prevent overflow on 32-bit platforms
-        errno = 0;
-        unsigned long long content_length_ull = std::stoull(*contentLengthHeader);
-        
-        // Check for ERANGE (overflow/underflow)
-        if (errno == ERANGE || errno == EINVAL) {
-          throw HttpError(
-            Constants::Http_Status::BAD_REQUEST,
-            "Invalid Content-Length"
-          );
-        }
-        
-        // Check if value exceeds size_t max (32-bit safety) or max_body_size
-        if (content_length_ull > static_cast<unsigned long long>(limits.max_body_size) ||
-            content_length_ull > static_cast<unsigned long long>(std::numeric_limits<size_t>::max())) {
-          throw HttpError(
-            Constants::Http_Status::PAYLOAD_TOO_LARGE, 
-            Helpers::reasonPhrase(Constants::Http_Status::PAYLOAD_TOO_LARGE)
-          );
-        }
-        
-        size_t content_length = static_cast<size_t>(content_length_ull);
+      if (!parseContentLength(*contentLengthHeader, content_length)) return false;
 
-        size_t header_end = buffer.find("\r\n\r\n") + 4;
-        rawBody.assign(
-          buffer.data() + header_end,
-          std::min(content_length, buffer.size() - header_end)
-        );
+      size_t header_end = buffer.find("\r\n\r\n") + 4;
+      rawBody.assign(
+        buffer.data() + header_end,
+        std::min(content_length, buffer.size() - header_end)
+      );
 
-        return true;
-      }
-      catch (const std::invalid_argument& e) {
-        throw HttpError(
-          Constants::Http_Status::BAD_REQUEST, 
-          e.what()
-        );
-      } 
-      catch (const std::out_of_range& e) {
-        throw HttpError(
-          Constants::Http_Status::PAYLOAD_TOO_LARGE, 
-          e.what()
-        );
-      }
+      return true;
     }
 
     bool readRemainingBody(Context& context) {
-      auto contentLengthHeader = context.req.header(Constants::Http_Header::CONTENT_LENGTH);
-      if (!contentLengthHeader) return true;
+      if (!context.req.getHeaders().contains(HeaderMap::Known::ContentLength)) return true;
+
+      // HttpRequestReader normally gathers the whole body with the head, so a
+      // pooled chunk is only taken when bytes are still left on the socket
+      if (rawBody.size() >= content_length) return true;
+
+      if (content_length > rawBody.capacity()) {
+        rawBody.reserve(content_length);
+      }
 
-      try {
-        errno = 0;
-        unsigned long long content_length_ull = std::stoull(*contentLengthHeader);
+      BufferPool::Buffer chunk = BufferPool::shared().acquire(limits.max_buffer_size);
+
+      while (rawBody.size() < content_length) {
+        size_t remaining = content_length - rawBody.size();
+        size_t read_size = std::min(static_cast<size_t>(limits.max_buffer_size), remaining);
+        
+        ssize_t bytes_read = recv(clientSocket, chunk.data(), read_size, 0);
         
-        if (errno == ERANGE || errno == EINVAL) {
-          throw HttpError(
+        if (bytes_read < 0) {
+          if (errno == EINTR) {
+            continue;  // Interrupted by signal, retry immediately
+          }
+          
+          if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            // Timeout occurred (shouldn't happen with blocking sockets, but handle gracefully)
+            return failure.fail(
+              Constants::Http_Status::REQUEST_TIMEOUT,
+              "Request body read timeout"
+            );
+          }
+          
+          // Connection error (ECONNRESET, EPIPE, etc.)
+          return failure.fail(
             Constants::Http_Status::BAD_REQUEST,
-            "Invalid Content-Length"
+            "Connection error while reading body"
           );
         }
         
-        if (content_length_ull > static_cast<unsigned long long>(limits.max_body_size) ||
-            content_length_ull > static_cast<unsigned long long>(std::numeric_limits<size_t>::max())) {
-          throw HttpError(
-            Constants::Http_Status::PAYLOAD_TOO_LARGE,
-            Helpers::reasonPhrase(Constants::Http_Status::PAYLOAD_TOO_LARGE)
+        if (bytes_read == 0) {
+          // Premature EOF - client closed connection before sending all data
+          return failure.fail(
+            Constants::Http_Status::BAD_REQUEST,
+            "Connection closed prematurely"
           );
         }
-        
-        size_t content_length = static_cast<size_t>(content_length_ull);
-
-        if (content_length > rawBody.capacity()) {
-          rawBody.reserve(content_length);
-        }
-
-        std::vector<char> chunk(limits.max_buffer_size);
       
-        while (rawBody.size() < content_length) {
-          size_t remaining = content_length - rawBody.size();
-          size_t read_size = std::min(static_cast<size_t>(limits.max_buffer_size), remaining);
-          
-          ssize_t bytes_read = recv(clientSocket, chunk.data(), read_size, 0);
-          
-          if (bytes_read < 0) {
-            if (errno == EINTR) {
-              continue;  // Interrupted by signal, retry immediately
-            }
-            
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-              // Timeout occurred (shouldn't happen with blocking sockets, but handle gracefully)
-              throw HttpError(
-                Constants::Http_Status::REQUEST_TIMEOUT,
-                "Request body read timeout"
-              );
-            }
-            
-            // Connection error (ECONNRESET, EPIPE, etc.)
-            throw HttpError(
-              Constants::Http_Status::BAD_REQUEST,
-              "Connection error while reading body"
-            );
-          }
-          
-          if (bytes_read == 0) {
-            // Premature EOF - client closed connection before sending all data
-            throw HttpError(
-              Constants::Http_Status::BAD_REQUEST,
-              "Connection closed prematurely"
-            );
-          }
-        
-          // Validate exceeding limits
-          if (rawBody.size() + static_cast<size_t>(bytes_read) > limits.max_body_size) {
-            throw HttpError(
-              Constants::Http_Status::PAYLOAD_TOO_LARGE,
-              Helpers::reasonPhrase(Constants::Http_Status::PAYLOAD_TOO_LARGE)
-            );
-          }
-
-          rawBody.append(chunk.data(), static_cast<size_t>(bytes_read));
+        // Validate exceeding limits
+        if (rawBody.size() + static_cast<size_t>(bytes_read) > limits.max_body_size) {
+          return failure.fail(
+            Constants::Http_Status::PAYLOAD_TOO_LARGE,
+            Helpers::reasonPhrase(Constants::Http_Status::PAYLOAD_TOO_LARGE)
+          );
         }
 
-        return true;
-      }
-      catch (const HttpError&) {
-        throw; 
-      }
-      catch (const std::exception& e) {
-        throw HttpError(
-          Constants::Http_Status::BAD_REQUEST, 
-          e.what()
-        );
+        rawBody.append(chunk.data(), static_cast<size_t>(bytes_read));
+        socket_bytes_read += static_cast<size_t>(bytes_read);
       }
+
+      return true;
     }
 
     Body parseBody(Context& context) {
-      auto contentType = context.req.header(Constants::Http_Header::CONTENT_TYPE);
+      auto contentType = context.req.header(HeaderMap::Known::ContentType);
 
       if (rawBody.empty()) {
         if (!contentType) {
@@ -551,21 +649,24 @@ namespace Metro {
       }
 
       if (!contentType) {
-        throw HttpError(
+        failure.fail(
           Constants::Http_Status::UNSUPPORTED_MEDIA_TYPE,
           Helpers::reasonPhrase(Constants::Http_Status::UNSUPPORTED_MEDIA_TYPE)
         );
+        return Body{};
       }
 
       if (contentType->find(Constants::Http_Content_Type::APPLICATION_JSON) != std::string::npos) {
-        try {
-          return Json::parse(rawBody);
-        } catch (...) {
-          throw HttpError(
+        // Non-throwing parse: malformed bodies come back discarded
+        Json json = Json::parse(rawBody, nullptr, false);
+        if (json.is_discarded()) {
+          failure.fail(
             Constants::Http_Status::BAD_REQUEST,
             "Malformed JSON body"
           );
+          return Body{};
         }
+        return json;
       }
 
       if (contentType->find(Constants::Http_Content_Type::APPLICATION_FORM_URLENCODED) != std::string::npos) {
@@ -584,13 +685,13 @@ namespace Metro {
   };
 
   class HttpParser {
-    static inline bool shouldKeepAlive(Context& context) {
-      auto conn = context.req.header(Constants::Http_Header::CONNECTION);
+    static inline bool shouldKeepAlive(Context& context, HttpFailure& failure) {
+      auto conn = context.req.header(HeaderMap::Known::Connection);
       
       if (conn && *conn != Constants::Http_Connection::CLOSE && 
           *conn != Constants::Http_Connection::KEEP_ALIVE &&
           *conn != Constants::Http_Connection::UPGRADE) {
-        throw HttpError(
+        return failure.fail(
           Constants::Http_Status::BAD_REQUEST, 
           Helpers::reasonPhrase(Constants::Http_Status::BAD_REQUEST)
         );
@@ -600,39 +701,51 @@ namespace Metro {
     }
 
     public:
-    static inline bool parse(
+    // Records the read spans and size of a request HttpRequestReader has gathered
+    static inline void acceptHead(Context& context, const HttpRequestReader& reader) {
+      Timing& timing = context.timing;
+      if (timing.enabled()) {
+        timing.add(Timing::Phase::HeaderRead, reader.firstByteAt(), reader.headEndAt());
+        if (reader.completeAt() > reader.headEndAt()) {
+          timing.add(Timing::Phase::BodyRead, reader.headEndAt(), reader.completeAt());
+        }
+      }
+      context.req.setBytesReceived(reader.bytesReceived());
+    }
+
+    // Parses the request HttpRequestReader gathered in `buffer`. Returns false
+    // either with `failure` set (answer with its status, then close) or with it
+    // empty (peer went away)
+    static inline bool parseHead(
       int clientSocket,
       Context& context,
-      const Config& config
+      const Config& config,
+      const std::string& buffer,
+      HttpFailure& failure
     ) {
-      std::string buffer;
-      size_t total_bytes_read = 0;
-
       HttpLimits limits(config);
 
-      HttpHeaderReader headerReader(
-        clientSocket,
-        buffer,
-        total_bytes_read,
-        limits
-      );
-      
-      if (!headerReader.read()) return false;
+      Timing& timing = context.timing;
+      auto headersAt = timing.now();
 
       std::istringstream input(buffer);
 
-      HttpRequestLineParser requestLineParser(limits);
+      HttpRequestLineParser requestLineParser(limits, failure);
       if (!requestLineParser.parse(input, context)) { return false; }
 
-      HttpHeadersParser headersParser(limits);
+      HttpHeadersParser headersParser(limits, failure);
       if (!headersParser.parse(input, context)) { return false; }
 
-      if (!shouldKeepAlive(context)) { return false; }
+      timing.add(Timing::Phase::Parse, headersAt, timing.now());
 
-      HttpBodyParser bodyParser(clientSocket, buffer, limits);
+      if (!shouldKeepAlive(context, failure)) { return false; }
+
+      HttpBodyParser bodyParser(clientSocket, buffer, limits, failure);
       if (!bodyParser.parse(context)) { return false; }
 
+      context.req.setBytesReceived(context.req.getBytesReceived() + bodyParser.bytesRead());
+
       return true;
     }
   };
-} 
+}
@@ -3,6 +3,10 @@
 #include <sstream>
 #include <unistd.h>
 #include <sys/uio.h> 
+#include <sys/socket.h>
+#include <poll.h>
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
 #include <ctime>
 #include <iomanip>
@@ -10,70 +14,279 @@
 #include "context.h"
 #include "helpers.h"
 #include "constants.h"
+#include "config.h"
 #include "types.h"
 
 namespace Metro {
   class HttpWriter {
     public:
+    // Response bytes the socket has not taken yet: queued bytes first, then the
+    // part of a pulled stream body still to be read, from `offset` to `end`
+    struct Backlog {
+      std::string bytes;
+      Types::Stream::Reader reader;
+      size_t offset = 0;
+      size_t end = 0;
 
-    static void write(int clientSocket, Context& context, bool keepAlive) {
+      bool empty() const noexcept { return bytes.empty() && !reader; }
+
+      void clear() {
+        bytes.clear();
+        reader = nullptr;
+      }
+    };
+
+    // Returns the number of bytes handed to the socket
+    static size_t write(int clientSocket, Context& context, bool keepAlive, const Config& config) {
+      std::string headers;
+      return write(clientSocket, context, keepAlive, config, headers);
+    }
+
+    // `headers` is connection-owned scratch for the response head; cleared here, capacity kept.
+    // On a non-blocking socket a client that stops reading gets timeout_seconds
+    // from the first stall, per response or per stream chunk, before the write fails
+    static size_t write(int clientSocket, Context& context, bool keepAlive, const Config& config, std::string& headers) {
+      return write(clientSocket, context, keepAlive, config, headers, nullptr);
+    }
+
+    // As above, but never waits: what the socket does not take now goes to
+    // `backlog`, for flush() once it is writable, and counts as written. A
+    // stream with a reader is read as the socket drains; other streams queue
+    // their chunks. Only a long-lived stream still waits, so write it off the event loop
+    static size_t write(int clientSocket, Context& context, bool keepAlive, const Config& config,
+                        std::string& headers, Backlog& backlog) {
+      return write(clientSocket, context, keepAlive, config, headers, &backlog);
+    }
+
+    // Sends an already serialized response unchanged; false if the peer went
+    // away or a stalled send outlasted `timeoutMs`
+    static bool writeRaw(int clientSocket, const std::string& response, int timeoutMs) {
+      return sendAll(clientSocket, response.data(), response.size(), timeoutMs);
+    }
+
+    // Never waits: the part the socket does not take is appended to `backlog`
+    static bool writeRaw(int clientSocket, const std::string& response, Backlog& backlog) {
+      struct iovec iov = {const_cast<char*>(response.data()), response.size()};
+      size_t sent = 0;
+      return sendOrQueue(clientSocket, &iov, 1, sent, backlog.bytes);
+    }
+
+    // Sends as much of `backlog` as the socket takes now, reading more of a
+    // pulled body as the queued bytes go; false if the peer went away or the
+    // body could not be read to its end
+    static bool flush(int clientSocket, Backlog& backlog) {
+      while (true) {
+        size_t offset = 0;
+        while (offset < backlog.bytes.size()) {
+          ssize_t sent = ::send(clientSocket, backlog.bytes.data() + offset, backlog.bytes.size() - offset, MSG_NOSIGNAL);
+          if (sent < 0 && errno == EINTR) continue;
+          if (sent < 0 && wouldBlock()) break;
+          if (sent <= 0) return false;
+          offset += static_cast<size_t>(sent);
+        }
+        backlog.bytes.erase(0, offset);
+        if (!backlog.bytes.empty() || !backlog.reader) return true;
+
+        // The headers already promised `end` bytes, so a short read ends the response
+        size_t wanted = std::min(PULL_CHUNK_SIZE, backlog.end - backlog.offset);
+        backlog.bytes.resize(wanted);
+        ssize_t got = backlog.reader(backlog.bytes.data(), wanted, backlog.offset);
+        if (got <= 0) {
+          backlog.clear();
+          return false;
+        }
+        backlog.bytes.resize(static_cast<size_t>(got));
+        backlog.offset += static_cast<size_t>(got);
+        if (backlog.offset >= backlog.end) backlog.reader = nullptr;
+      }
+    }
+  
+    private:
+    static constexpr size_t PULL_CHUNK_SIZE = 64 * 1024;
+
+    static size_t write(int clientSocket, Context& context, bool keepAlive, const Config& config,
+                        std::string& headers, Backlog* backlog) {
       context.res.commit();
+      headers.clear();
+      const int timeoutMs = config.server().timeout_seconds * 1000;
 
       // Check if body is Stream first (special handling)
-      if (std::holds_alternative<Types::Stream>(context.res.getBody())) {
-        writeStream(clientSocket, context, keepAlive);
-        return;
+      if (const auto* stream = std::get_if<Types::Stream>(&context.res.getBody())) {
+        if (backlog && stream->longLived) backlog = nullptr;
+        if (backlog && stream->reader && stream->contentLength > 0) {
+          return pullStream(clientSocket, context, keepAlive, headers, *backlog);
+        }
+        return writeStream(clientSocket, context, keepAlive, config, headers, backlog);
       }
 
       auto bodyView = buildBodyView(context.res.getBody());
-      std::string headers = buildHeaders(context, bodyView.size, keepAlive);
+      // Moving the view out of the visitor can relocate a short (SSO) storage buffer
+      if (!bodyView.storage.empty()) bodyView.data = bodyView.storage.data();
+
+      buildHeaders(headers, context, bodyView.size, keepAlive);
+
+      if (backlog) {
+        struct iovec iov[2];
+        iov[0] = {const_cast<char*>(headers.data()), headers.size()};
+        iov[1] = {const_cast<char*>(bodyView.data), bodyView.size};
+
+        size_t sent = 0;
+        bool queued = sendOrQueue(clientSocket, iov, bodyView.size > 0 ? 2 : 1, sent, backlog->bytes);
+        return queued ? headers.size() + bodyView.size : sent;
+      }
 
       if (bodyView.size > 0) {
-        sendScatterResponse(clientSocket, headers, bodyView.data, bodyView.size);
-      } else {
-        sendAllResponse(clientSocket, headers.data(), headers.size());
+        return sendScatterResponse(clientSocket, headers, bodyView.data, bodyView.size, timeoutMs);
       }
+      return sendAllResponse(clientSocket, headers.data(), headers.size(), timeoutMs);
     }
-  
-    private:
 
-    static std::string toHex(size_t value) {
-      static const char* digits = "0123456789abcdef";
-      std::string result;
-      do {
-        result = digits[value & 0xf] + result;
-        value >>= 4;
-      } while (value);
-      return result;
-    }
+    // Chunk framing and payload leave in one gathered send; small chunks may be
+    // held back until `threshold` bytes are pending or the oldest is `interval` old.
+    // With a `backlog` nothing waits: what the socket does not take is queued there
+    class StreamSink : public Types::Stream::ChunkSink {
+      public:
+      StreamSink(int clientSocket, bool chunked, const Config& config, Backlog* backlog)
+        : clientSocket(clientSocket),
+          chunked(chunked),
+          threshold(config.server().stream_flush_threshold),
+          interval(config.server().stream_flush_interval_ms),
+          timeoutMs(config.server().timeout_seconds * 1000),
+          backlog(backlog) {}
+
+      // Response headers ride along with the first chunk
+      void queue(const std::string& data) {
+        if (pending.empty()) pendingSince = std::chrono::steady_clock::now();
+        pending += data;
+      }
+
+      bool write(const char* data, size_t len) override {
+        // A zero-length chunk would terminate a chunked body early
+        if (len == 0) return true;
+
+        char sizeLine[2 * sizeof(size_t) + 2];
+        size_t sizeLineLength = chunked ? formatChunkSize(sizeLine, len) : 0;
+        size_t framedLength = sizeLineLength + len + (chunked ? 2 : 0);
+
+        if (threshold > 0 && pending.size() + framedLength <= threshold) {
+          if (pending.empty()) pendingSince = std::chrono::steady_clock::now();
+          pending.append(sizeLine, sizeLineLength);
+          pending.append(data, len);
+          if (chunked) pending.append("\r\n", 2);
+
+          if (pending.size() >= threshold || deadlinePassed()) return flush();
+          return true;
+        }
+
+        struct iovec iov[4];
+        size_t count = 0;
+        if (!pending.empty()) iov[count++] = {const_cast<char*>(pending.data()), pending.size()};
+        if (sizeLineLength > 0) iov[count++] = {sizeLine, sizeLineLength};
+        iov[count++] = {const_cast<char*>(data), len};
+        if (chunked) iov[count++] = {const_cast<char*>("\r\n"), 2};
+
+        bool sent = send(iov, count);
+        pending.clear();
+        return sent;
+      }
+
+      bool flush() override {
+        if (pending.empty()) return true;
+
+        struct iovec iov = {const_cast<char*>(pending.data()), pending.size()};
+        bool sent = send(&iov, 1);
+        pending.clear();
+        return sent;
+      }
+
+      bool finish() {
+        if (chunked) pending.append("0\r\n\r\n", 5);
+        return flush();
+      }
+
+      size_t bytesSent() const { return sentBytes; }
+
+      private:
+      int clientSocket;
+      bool chunked;
+      size_t threshold;
+      std::chrono::milliseconds interval;
+      int timeoutMs;
+      Backlog* backlog;
+
+      std::string pending;
+      std::chrono::steady_clock::time_point pendingSince;
+      size_t sentBytes = 0;
+
+      // Queued bytes count as sent, as for buffered bodies
+      bool send(struct iovec* iov, size_t count) {
+        if (!backlog) return sendVector(clientSocket, iov, count, sentBytes, timeoutMs);
+
+        size_t sent = 0;
+        if (!sendOrQueue(clientSocket, iov, count, sent, backlog->bytes)) {
+          sentBytes += sent;
+          return false;
+        }
+        for (size_t i = 0; i < count; ++i) sentBytes += iov[i].iov_len;
+        return true;
+      }
 
-    static void writeStream(int clientSocket, const Context& context, bool keepAlive) {
+      bool deadlinePassed() const {
+        return std::chrono::steady_clock::now() - pendingSince >= interval;
+      }
+
+      static size_t formatChunkSize(char* out, size_t value) {
+        static const char* digits = "0123456789abcdef";
+        char reversed[2 * sizeof(size_t)];
+        size_t length = 0;
+        do {
+          reversed[length++] = digits[value & 0xf];
+          value >>= 4;
+        } while (value);
+
+        for (size_t i = 0; i < length; ++i) out[i] = reversed[length - 1 - i];
+        out[length] = '\r';
+        out[length + 1] = '\n';
+        return length + 2;
+      }
+    };
+
+    static size_t writeStream(int clientSocket, const Context& context, bool keepAlive, const Config& config,
+                              std::string& headers, Backlog* backlog) {
       const auto& stream = std::get<Types::Stream>(context.res.getBody());
       
       // Build headers (Stream sets Transfer-Encoding or Content-Length)
-      std::string headers = buildHeaders(context, stream.contentLength, keepAlive);
-      sendAllResponse(clientSocket, headers.data(), headers.size());
-      
+      buildHeaders(headers, context, stream.contentLength, keepAlive);
+
       bool use_chunked = (stream.contentLength == 0);
-      
+
+      StreamSink sink(clientSocket, use_chunked, config, backlog);
+      sink.queue(headers);
+
       // Execute stream writer with chunk callback
-      stream.writer([&](const char* data, size_t len) -> bool {
-        if (use_chunked) {
-          // Chunked encoding: hex(size)\r\n data \r\n
-          std::string chunkHeader = toHex(len) + "\r\n";
-          if (!sendAll(clientSocket, chunkHeader.data(), chunkHeader.size())) return false;
-          if (!sendAll(clientSocket, data, len)) return false;
-          return sendAll(clientSocket, "\r\n", 2);
-        } else {
-          // Fixed length streaming
-          return sendAll(clientSocket, data, len);
-        }
-      });
-      
-      // Send final chunk if chunked
-      if (use_chunked) {
-        sendAllResponse(clientSocket, "0\r\n\r\n", 5);
-      }
+      stream.writer(Types::Stream::ChunkWriter(sink));
+
+      // Send final chunk (if chunked) along with anything still buffered
+      sink.finish();
+      return sink.bytesSent();
+    }
+
+    // Sends the head, then as much of the body as the socket takes; flush()
+    // reads the rest as the client drains it, so memory stays at one chunk
+    static size_t pullStream(int clientSocket, const Context& context, bool keepAlive, std::string& headers, Backlog& backlog) {
+      const auto& stream = std::get<Types::Stream>(context.res.getBody());
+      buildHeaders(headers, context, stream.contentLength, keepAlive);
+
+      struct iovec iov = {const_cast<char*>(headers.data()), headers.size()};
+      size_t sent = 0;
+      if (!sendOrQueue(clientSocket, &iov, 1, sent, backlog.bytes)) return sent;
+
+      backlog.reader = stream.reader;
+      backlog.offset = 0;
+      backlog.end = stream.contentLength;
+      // A body that ends short cannot be followed by another response
+      if (!flush(clientSocket, backlog)) shutdown(clientSocket, SHUT_RDWR);
+      return headers.size() + stream.contentLength;
     }
 
     struct BodyView {
@@ -99,6 +312,9 @@ namespace Metro {
         else if constexpr (std::is_same_v<T, Types::Text>) {
           return {content.data(), content.size(), {}};
         }
+        else if constexpr (std::is_same_v<T, Types::StaticBytes>) {
+          return {content.data, content.size, {}};
+        }
         else if constexpr (std::is_same_v<T, Types::Json>) {
           BodyView view;
           view.storage = content.dump();
@@ -117,7 +333,7 @@ namespace Metro {
       }, body);
     }
 
-    static std::string getCurrentDate() {
+    static const std::string& getCurrentDate() {
       thread_local std::string cached;
       thread_local std::time_t last = 0;
       
@@ -149,103 +365,186 @@ namespace Metro {
       return result;
     }
 
-    static std::string buildHeaders(const Context& context, size_t bodySize, bool keepAlive) {
-      std::ostringstream output;
-        
+    static void buildHeaders(std::string& output, const Context& context, size_t bodySize, bool keepAlive) {
       writeStatusLine(output, context);
       writeCustomHeaders(output, context);
       writeFixedHeaders(output, context, bodySize, keepAlive);
-      output << "\r\n";
-        
-      return output.str();
+      output += "\r\n";
     }
   
-    static void writeStatusLine(std::ostream& output, const Context& context) {
-      output  << "HTTP/1.1" << " "
-              << context.res.getStatus() << " "
-              << Helpers::reasonPhrase(context.res.getStatus())
-              << "\r\n";
+    static void writeStatusLine(std::string& output, const Context& context) {
+      output += "HTTP/1.1 ";
+      output += std::to_string(context.res.getStatus());
+      output += ' ';
+      output += Helpers::reasonPhrase(context.res.getStatus());
+      output += "\r\n";
     }
   
-    static void writeCustomHeaders(std::ostream& output, const Context& context) {
+    static void writeCustomHeaders(std::string& output, const Context& context) {
       for (const auto& [headerName, headerValue] : context.res.getHeaders()) {
-        output  << headerName << ": " 
-                << headerValue 
-                << "\r\n";
+        output += headerName;
+        output += ": ";
+        output += headerValue;
+        output += "\r\n";
       }
     }
   
-    static void writeFixedHeaders(std::ostream& output, const Context& context, size_t bodySize, bool keepAlive) {
-      auto it = context.res.getHeaders().find(std::string(Constants::Http_Header::TRANSFER_ENCODING));
-      bool is_chunked = (it != context.res.getHeaders().end() && it->second.find("chunked") != std::string::npos);
-
-      if (!is_chunked) {
-        output  << Constants::Http_Header::CONTENT_LENGTH << ": " 
-                << bodySize
-                << "\r\n";
+    static void writeFixedHeaders(std::string& output, const Context& context, size_t bodySize, bool keepAlive) {
+      const auto& headers = context.res.getHeaders();
+      auto transferEncoding = headers.get(HeaderMap::Known::TransferEncoding);
+      bool is_chunked = (transferEncoding && transferEncoding->find("chunked") != std::string::npos);
+
+      // Fixed-length streams already carry the header set by Response::stream
+      bool has_length = headers.contains(HeaderMap::Known::ContentLength);
+
+      if (!is_chunked && !has_length) {
+        output += Constants::Http_Header::CONTENT_LENGTH;
+        output += ": ";
+        output += std::to_string(bodySize);
+        output += "\r\n";
       }
       
-      output  << Constants::Http_Header::CONNECTION << ": "
-              << (keepAlive ? Constants::Http_Connection::KEEP_ALIVE 
-                            : Constants::Http_Connection::CLOSE)
-              << "\r\n";
+      output += Constants::Http_Header::CONNECTION;
+      output += ": ";
+      output += keepAlive ? Constants::Http_Connection::KEEP_ALIVE : Constants::Http_Connection::CLOSE;
+      output += "\r\n";
       
-      output  << Constants::Http_Header::DATE << ": "
-              << getCurrentDate()
-              << "\r\n";
+      output += Constants::Http_Header::DATE;
+      output += ": ";
+      output += getCurrentDate();
+      output += "\r\n";
     }
 
-    static void sendScatterResponse(int clientSocket, const std::string& headers, 
-                           const char* bodyData, size_t bodySize) {
+    static size_t sendScatterResponse(int clientSocket, const std::string& headers, 
+                           const char* bodyData, size_t bodySize, int timeoutMs) {
       struct iovec iov[2];
       iov[0].iov_base = const_cast<char*>(headers.data());
       iov[0].iov_len = headers.size();
       iov[1].iov_base = const_cast<char*>(bodyData);  // Zero-copy pointer
       iov[1].iov_len = bodySize;
 
-      size_t total = headers.size() + bodySize;
-      size_t sent_total = 0;
+      size_t sent = 0;
+      sendVector(clientSocket, iov, 2, sent, timeoutMs);
+      return sent;
+    }
 
-      while (sent_total < total) {
-        ssize_t sent = writev(clientSocket, iov, 2);
-        if (sent <= 0) {
-          return; // Error or disconnect
+    // Waits out sends that would block. The deadline starts at the first stall
+    // and is shared by every later one, so a client draining a byte at a time
+    // cannot stretch it
+    class WriteStall {
+      public:
+      explicit WriteStall(int timeoutMs) : timeoutMs(timeoutMs) {}
+
+      // True once the socket can take more; false when the deadline has passed
+      bool wait(int clientSocket) {
+        auto now = std::chrono::steady_clock::now();
+        if (!stalled) {
+          stalled = true;
+          deadline = now + std::chrono::milliseconds(timeoutMs);
         }
-        sent_total += sent;
-
-        // Adjust iovec for partial writes (kernel may not consume all)
-        if (static_cast<size_t>(sent) < iov[0].iov_len) {
-          // Partial write within headers
-          iov[0].iov_base = static_cast<char*>(iov[0].iov_base) + sent;
-          iov[0].iov_len -= sent;
-        } else if (sent == static_cast<ssize_t>(iov[0].iov_len)) {
-          // Headers fully sent, body starts next
-          iov[0].iov_len = 0; // Mark as done
-        } else {
-          // Headers fully sent + partial body
-          size_t body_sent = sent - iov[0].iov_len;
-          iov[0].iov_len = 0;
-          iov[1].iov_base = static_cast<char*>(iov[1].iov_base) + body_sent;
-          iov[1].iov_len -= body_sent;
+
+        while (true) {
+          auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+          if (remaining <= 0) return false;
+
+          // Errors and hang-ups count as ready: the next send reports them
+          pollfd ready{clientSocket, POLLOUT, 0};
+          int polled = ::poll(&ready, 1, static_cast<int>(remaining));
+          if (polled > 0) return true;
+          if (polled == 0 || errno != EINTR) return false;
+          now = std::chrono::steady_clock::now();
         }
       }
+
+      private:
+      int timeoutMs;
+      bool stalled = false;
+      std::chrono::steady_clock::time_point deadline;
+    };
+
+    static bool wouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+
+    // Gathered send of every iovec, resuming after partial writes (kernel may not consume all).
+    // sendmsg rather than writev so a closed peer reports EPIPE instead of raising SIGPIPE
+    // Adds every byte accepted by the kernel to `sentBytes`, even when the send fails part way
+    static bool sendVector(int clientSocket, struct iovec* iov, size_t count, size_t& sentBytes, int timeoutMs) {
+      msghdr message{};
+      message.msg_iov = iov;
+      message.msg_iovlen = count;
+      WriteStall stall(timeoutMs);
+
+      while (message.msg_iovlen > 0) {
+        ssize_t sent = ::sendmsg(clientSocket, &message, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && wouldBlock() && stall.wait(clientSocket)) continue;
+        if (sent <= 0) return false; // Error or disconnect
+
+        sentBytes += static_cast<size_t>(sent);
+        consume(message, static_cast<size_t>(sent));
+      }
+      return true;
+    }
+
+    // sendVector() that never waits: whatever would block is appended to
+    // `backlog` instead. Bytes already queued there go out first, so
+    // everything after them queues too
+    static bool sendOrQueue(int clientSocket, struct iovec* iov, size_t count, size_t& sentBytes, std::string& backlog) {
+      msghdr message{};
+      message.msg_iov = iov;
+      message.msg_iovlen = count;
+
+      while (message.msg_iovlen > 0 && backlog.empty()) {
+        ssize_t sent = ::sendmsg(clientSocket, &message, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && wouldBlock()) break;
+        if (sent <= 0) return false;
+
+        sentBytes += static_cast<size_t>(sent);
+        consume(message, static_cast<size_t>(sent));
+      }
+
+      for (size_t i = 0; i < message.msg_iovlen; ++i) {
+        backlog.append(static_cast<const char*>(message.msg_iov[i].iov_base), message.msg_iov[i].iov_len);
+      }
+      return true;
     }
 
-    static void sendAllResponse(int clientSocket, const char* data, size_t length) {
+    // Drops `sent` bytes from the front of the message's iovecs
+    static void consume(msghdr& message, size_t sent) {
+      while (message.msg_iovlen > 0 && sent >= message.msg_iov->iov_len) {
+        sent -= message.msg_iov->iov_len;
+        message.msg_iov++;
+        message.msg_iovlen--;
+      }
+
+      if (message.msg_iovlen > 0) {
+        message.msg_iov->iov_base = static_cast<char*>(message.msg_iov->iov_base) + sent;
+        message.msg_iov->iov_len -= sent;
+      }
+    }
+
+    static size_t sendAllResponse(int clientSocket, const char* data, size_t length, int timeoutMs) {
+      size_t total = 0;
+      WriteStall stall(timeoutMs);
       while (length > 0) {
-        ssize_t sent = ::send(clientSocket, data, length, 0);
+        ssize_t sent = ::send(clientSocket, data, length, MSG_NOSIGNAL);
+        if (sent < 0 && (errno == EINTR || (wouldBlock() && stall.wait(clientSocket)))) continue;
         if (sent <= 0) {
-          return; 
+          return total; 
         }
         data += sent;
         length -= sent;
+        total += static_cast<size_t>(sent);
       }
+      return total;
     }
 
     // Helper for single write attempt (returns success bool)
-    static bool sendAll(int clientSocket, const char* data, size_t length) {
+    static bool sendAll(int clientSocket, const char* data, size_t length, int timeoutMs) {
+      WriteStall stall(timeoutMs);
       while (length > 0) {
         ssize_t sent = ::send(clientSocket, data, length, MSG_NOSIGNAL);
+        if (sent < 0 && (errno == EINTR || (wouldBlock() && stall.wait(clientSocket)))) continue;
         if (sent <= 0) return false;
         data += sent;
         length -= sent;
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "alloc_tracker.h"
+#include "context.h"
+#include "types.h"
+
+namespace Metro {
+  using namespace Types;
+
+  /**
+   * Request metrics in Prometheus text format.
+   *
+   * Every request thread updates its own shard (an uncontended lock and a
+   * handful of increments); shards are only merged when /metrics is scraped.
+   * Series are keyed by method and route pattern, never by raw path, so the
+   * label set stays bounded. Latency uses log-linear buckets: two per power of
+   * two from 1µs to ~2 minutes, i.e. at most 25% relative bucket width.
+   *
+   *   Metrics metrics;
+   *   app.get("/metrics", metrics.handler());
+   *   server.setMetrics(metrics);
+   */
+  class Metrics {
+    public:
+    static constexpr size_t BUCKETS = 54;
+
+    Metrics() : id_(nextId()) {}
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    // Called by the server once the request has been parsed
+    void begin() {
+      local().in_flight.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Called by the server after the response to a begun request was written
+    void end(const std::string& method, const std::string& route, int status,
+             uint64_t bytesIn, uint64_t bytesOut, uint64_t durationMicros) {
+      local().in_flight.fetch_sub(1, std::memory_order_relaxed);
+      record(method, route, status, bytesIn, bytesOut, durationMicros);
+    }
+
+    // Counts a completed request without touching the in-flight gauge (e.g. rejected while parsing)
+    void record(const std::string& method, const std::string& route, int status,
+                uint64_t bytesIn, uint64_t bytesOut, uint64_t durationMicros) {
+      Shard& shard = local();
+
+      // Reused per-thread key buffer: no allocation once warmed up
+      thread_local std::string key;
+      key.assign(methodLabel(method));
+      key += ' ';
+      key += route.empty() ? UNMATCHED : route;
+
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto it = shard.series.find(key);
+      if (it == shard.series.end()) it = shard.series.emplace(key, Series{}).first;
+
+      Series& series = it->second;
+      int statusClass = status / 100;
+      if (statusClass >= 1 && statusClass <= 5) series.requests[statusClass - 1]++;
+      series.bytes_in += bytesIn;
+      series.bytes_out += bytesOut;
+      series.duration_sum_us += durationMicros;
+      series.duration_count++;
+
+      size_t bucket = bucketIndex(durationMicros);
+      if (bucket < BUCKETS) series.buckets[bucket]++;
+    }
+
+    // Serves the merged snapshot in Prometheus text exposition format
+    Handler handler() {
+      return [this](Context& context) {
+        context.res.text(render());
+        context.res.header("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+      };
+    }
+
+    std::string render() {
+      std::map<std::string, Series> merged;
+      int64_t inFlight = 0;
+
+      for (auto& shard : snapshotShards()) {
+        inFlight += shard->in_flight.load(std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        for (const auto& [key, series] : shard->series) {
+          merged[key].add(series);
+        }
+      }
+
+      std::string out;
+      out.reserve(4096 + merged.size() * 4096);
+
+      out += "# HELP metro_http_requests_in_flight Requests parsed but not yet written.\n";
+      out += "# TYPE metro_http_requests_in_flight gauge\n";
+      out += "metro_http_requests_in_flight " + std::to_string(inFlight) + "\n";
+
+      out += "# HELP metro_http_requests_total Completed requests by route and status class.\n";
+      out += "# TYPE metro_http_requests_total counter\n";
+      for (const auto& [key, series] : merged) {
+        std::string labels = labelsFor(key);
+        for (int statusClass = 0; statusClass < 5; ++statusClass) {
+          if (series.requests[statusClass] == 0) continue;
+          out += "metro_http_requests_total{" + labels + ",status=\"" + std::to_string(statusClass + 1) + "xx\"} ";
+          out += std::to_string(series.requests[statusClass]) + "\n";
+        }
+      }
+
+      out += "# HELP metro_http_request_bytes_total Request bytes received, including headers.\n";
+      out += "# TYPE metro_http_request_bytes_total counter\n";
+      for (const auto& [key, series] : merged) {
+        out += "metro_http_request_bytes_total{" + labelsFor(key) + "} " + std::to_string(series.bytes_in) + "\n";
+      }
+
+      out += "# HELP metro_http_response_bytes_total Response bytes sent, including headers.\n";
+      out += "# TYPE metro_http_response_bytes_total counter\n";
+      for (const auto& [key, series] : merged) {
+        out += "metro_http_response_bytes_total{" + labelsFor(key) + "} " + std::to_string(series.bytes_out) + "\n";
+      }
+
+      out += "# HELP metro_http_request_duration_seconds Time from first request byte to response written.\n";
+      out += "# TYPE metro_http_request_duration_seconds histogram\n";
+      for (const auto& [key, series] : merged) {
+        renderHistogram(out, labelsFor(key), series);
+      }
+
+      if (AllocationTracker::enabled()) renderAllocations(out);
+
+      return out;
+    }
+
+    private:
+    static constexpr const char* UNMATCHED = "<unmatched>";
+    static constexpr const char* OTHER_METHOD = "OTHER";
+
+    // The method is client-chosen, so anything but the standard ones shares one series
+    static const char* methodLabel(const std::string& method) {
+      static constexpr const char* known[] = {
+        "GET", "HEAD", "POST", "PUT", "DELETE", "PATCH", "OPTIONS", "CONNECT", "TRACE",
+      };
+      for (const char* name : known) {
+        if (method == name) return name;
+      }
+      return OTHER_METHOD;
+    }
+
+    struct Series {
+      std::array<uint64_t, 5> requests{};   // 1xx .. 5xx
+      uint64_t bytes_in = 0;
+      uint64_t bytes_out = 0;
+      uint64_t duration_sum_us = 0;
+      uint64_t duration_count = 0;
+      std::array<uint64_t, BUCKETS> buckets{};
+
+      void add(const Series& other) {
+        for (size_t i = 0; i < requests.size(); ++i) requests[i] += other.requests[i];
+        bytes_in += other.bytes_in;
+        bytes_out += other.bytes_out;
+        duration_sum_us += other.duration_sum_us;
+        duration_count += other.duration_count;
+        for (size_t i = 0; i < BUCKETS; ++i) buckets[i] += other.buckets[i];
+      }
+    };
+
+    struct Shard {
+      std::mutex mutex;
+      std::unordered_map<std::string, Series> series;
+      std::atomic<int64_t> in_flight{0};
+    };
+
+    const uint64_t id_;
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<Shard>> shards_;
+
+    Shard& local() {
+      // Keyed by instance id rather than address so a new instance never inherits a stale shard
+      struct Registration {
+        uint64_t owner;
+        std::shared_ptr<Shard> shard;
+      };
+      thread_local std::vector<Registration> registrations;
+
+      for (auto& registration : registrations) {
+        if (registration.owner == id_) return *registration.shard;
+      }
+
+      auto shard = std::make_shared<Shard>();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shards_.push_back(shard);
+      }
+      registrations.push_back({id_, shard});
+      return *shard;
+    }
+
+    std::vector<std::shared_ptr<Shard>> snapshotShards() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return shards_;
+    }
+
+    // Values are whole microseconds; bucket i covers (upperBound(i - 1), upperBound(i)]
+    static size_t bucketIndex(uint64_t micros) {
+      uint64_t offset = micros > 0 ? micros - 1 : 0;
+      if (offset < 2) return static_cast<size_t>(offset);
+
+      size_t octave = 63 - static_cast<size_t>(__builtin_clzll(offset));
+      size_t half = static_cast<size_t>((offset >> (octave - 1)) & 1);
+      return 2 * octave + half;
+    }
+
+    static uint64_t upperBound(size_t index) {
+      if (index < 2) return index + 1;
+
+      size_t octave = index / 2;
+      uint64_t base = uint64_t(1) << octave;
+      return base + (index % 2 + 1) * (base >> 1);
+    }
+
+    static void renderHistogram(std::string& out, const std::string& labels, const Series& series) {
+      // Trailing empty buckets carry no information beyond +Inf
+      size_t last = BUCKETS;
+      while (last > 0 && series.buckets[last - 1] == 0) --last;
+
+      uint64_t cumulative = 0;
+      char bound[32];
+      for (size_t i = 0; i < last; ++i) {
+        cumulative += series.buckets[i];
+        std::snprintf(bound, sizeof(bound), "%g", static_cast<double>(upperBound(i)) / 1e6);
+        out += "metro_http_request_duration_seconds_bucket{" + labels + ",le=\"" + bound + "\"} ";
+        out += std::to_string(cumulative) + "\n";
+      }
+
+      out += "metro_http_request_duration_seconds_bucket{" + labels + ",le=\"+Inf\"} ";
+      out += std::to_string(series.duration_count) + "\n";
+
+      char sum[32];
+      std::snprintf(sum, sizeof(sum), "%.6f", static_cast<double>(series.duration_sum_us) / 1e6);
+      out += "metro_http_request_duration_seconds_sum{" + labels + "} " + sum + "\n";
+      out += "metro_http_request_duration_seconds_count{" + labels + "} " + std::to_string(series.duration_count) + "\n";
+    }
+
+    // Only present in -DMETRO_TRACK_ALLOCATIONS builds; process-wide, not per route
+    static void renderAllocations(std::string& out) {
+      auto totals = AllocationTracker::totals();
+
+      out += "# HELP metro_allocations_total Heap allocations by request phase.\n";
+      out += "# TYPE metro_allocations_total counter\n";
+      for (size_t i = 0; i < AllocationTracker::PHASES; ++i) {
+        out += "metro_allocations_total{phase=\"";
+        out += AllocationTracker::name(static_cast<AllocationTracker::Phase>(i));
+        out += "\"} " + std::to_string(totals[i].allocations) + "\n";
+      }
+
+      out += "# HELP metro_allocation_bytes_total Heap bytes requested by request phase.\n";
+      out += "# TYPE metro_allocation_bytes_total counter\n";
+      for (size_t i = 0; i < AllocationTracker::PHASES; ++i) {
+        out += "metro_allocation_bytes_total{phase=\"";
+        out += AllocationTracker::name(static_cast<AllocationTracker::Phase>(i));
+        out += "\"} " + std::to_string(totals[i].bytes) + "\n";
+      }
+
+      out += "# HELP metro_allocation_requests_total Requests written while allocations were tracked.\n";
+      out += "# TYPE metro_allocation_requests_total counter\n";
+      out += "metro_allocation_requests_total " + std::to_string(AllocationTracker::requestCount()) + "\n";
+    }
+
+    static std::string labelsFor(const std::string& key) {
+      size_t space = key.find(' ');
+      return "method=\"" + escape(key.substr(0, space)) + "\",route=\"" + escape(key.substr(space + 1)) + "\"";
+    }
+
+    static std::string escape(const std::string& value) {
+      std::string out;
+      out.reserve(value.size());
+      for (char c : value) {
+        if (c == '\\' || c == '"') {
+          out += '\\';
+          out += c;
+        } else if (c == '\n') {
+          out += "\\n";
+        } else {
+          out += c;
+        }
+      }
+      return out;
+    }
+
+    static uint64_t nextId() {
+      static std::atomic<uint64_t> counter{0};
+      return ++counter;
+    }
+  };
+}
@@ -10,6 +10,9 @@
 #include "helpers.h"
 #include "http/http_error.h"
 #include "route.h"
+#include "alloc_tracker.h"
+#include "static_files.h"
+#include "embedded.h"
 
 namespace Metro {
   using namespace Types; 
@@ -18,89 +21,112 @@ namespace Metro {
     Router router_;
     std::vector<Middleware> middlewares_;
 
-    void executeRoute(Context& context) {
-      auto result = router_.matchRoute(context.req.getPath(), context.req.getMethod(), context);
-
-      if (result.status == Router::MatchStatus::NotFound) {
-        throw HttpError(
-          Constants::Http_Status::NOT_FOUND,
-          "Route not found: " + context.req.getPath()
-        );
-      } 
-      else if (result.status == Router::MatchStatus::MethodNotAllowed) {
-        std::string allowValue;
-        for (size_t i = 0; i < result.allowedMethods.size(); ++i) {
-          if (i > 0) allowValue += ", ";
-          allowValue += result.allowedMethods[i];
+    // Routing misses are answered in place rather than thrown: under scanner
+    // traffic they are a large share of requests and unwinding is not free
+    void answerMiss(Context& context, const Router::MatchResult& match) {
+      switch (match.status) {
+        case Router::MatchStatus::Found:
+          return;
+
+        case Router::MatchStatus::NotFound:
+          context.res
+            .status(Constants::Http_Status::NOT_FOUND)
+            .text("Route not found: " + context.req.getPath());
+          return;
+
+        case Router::MatchStatus::MethodNotAllowed: {
+          std::string allowValue;
+          for (size_t i = 0; i < match.allowedMethods.size(); ++i) {
+            if (i > 0) allowValue += ", ";
+            allowValue += match.allowedMethods[i];
+          }
+
+          context.res
+            .header(Constants::Http_Header::ALLOW, allowValue)
+            .status(Constants::Http_Status::METHOD_NOT_ALLOWED)
+            .text("Method not allowed: " + context.req.getMethod());
+          return;
         }
 
-        context.res.header(Constants::Http_Header::ALLOW, allowValue);
-        throw HttpError(
-          Constants::Http_Status::METHOD_NOT_ALLOWED,
-          "Method not allowed: " + context.req.getMethod()
-        );
+        case Router::MatchStatus::TooDeep:
+          context.res
+            .status(Constants::Http_Status::URI_TOO_LONG)
+            .text("Route recursion too deep");
+          return;
       }
+    }
 
-      result.endpoint.handler(context);
+    void runHandler(const Router::Endpoint& endpoint, Context& context) {
+      Timing& timing = context.timing;
+      auto start = timing.now();
+      {
+        AllocationTracker::Scope allocationScope(AllocationTracker::Phase::Handler);
+        endpoint.handler(context);
+      }
+      timing.add(Timing::Phase::Handler, start, timing.now());
     }
 
-    void negotiateResponse(Context& context) {
+    // A 406 is answered in place, like a routing miss, rather than thrown
+    HttpFailure negotiateResponse(Context& context) {
+      HttpFailure failure;
+
       auto accept = context.req.header(Constants::Http_Header::ACCEPT);
-      if (!accept || accept->empty()) return;
+      if (!accept || accept->empty()) return failure;
 
-      auto it = context.res.getHeaders().find(Constants::Http_Header::CONTENT_TYPE);
-      if (it == context.res.getHeaders().end()) return;
+      auto contentType = context.res.getHeaders().get(HeaderMap::Known::ContentType);
+      if (!contentType) return failure;
 
-      if (accept->find("*/*") != std::string::npos) return;
-      if (accept->find(it->second) != std::string::npos) return;
+      if (accept->find("*/*") != std::string::npos) return failure;
+      if (accept->find(*contentType) != std::string::npos) return failure;
 
-      throw HttpError(
+      failure.fail(
         Constants::Http_Status::NOT_ACCEPTABLE,
         Helpers::reasonPhrase(Constants::Http_Status::NOT_ACCEPTABLE)
       );
+      return failure;
     }
 
-    void runMiddleware(Context& context) {
-      size_t index = 0;
-      
-      Next next = [&]() {
-        if (index < middlewares_.size()) {
-          auto& middleware = middlewares_[index++];
-          
-          try {
-            middleware(context, next);
-            
-            if (context.res.isCommitted()) {
-              return;
-            }
-          } catch (...) {
-            if (context.res.isCommitted()) {
-              throw;
-            }
-            throw;
-          }
-        } else {
-          try {
-            executeRoute(context);
-          } catch (...) {
-            if (context.res.isCommitted()) {
-              throw;
-            }
-            throw; 
-          }
-        }
-      };
-      
-      try {
-        next();
-      } catch (const std::exception& e) {
-        if (context.res.isCommitted()) {
-          throw;
-        }
-        throw;
+    // Per-request state behind Next: global middleware, then the matched
+    // endpoint's group and route middleware, then its handler
+    struct Dispatch {
+      App& app;
+      const Router::MatchResult& match;
+    };
+
+    // Runs the pipeline from `index` onward; each hop hands the next one a Next
+    // that points back here with index + 1, so the chain costs no allocation
+    static void runChain(void* chain, Context& context, size_t index) {
+      Dispatch& dispatch = *static_cast<Dispatch*>(chain);
+      const auto& global = dispatch.app.middlewares_;
+
+      if (index < global.size()) {
+        runStep(global[index], dispatch, context, index);
+        return;
+      }
+
+      const Router::Endpoint* endpoint = dispatch.match.endpoint;
+      if (!endpoint) {
+        dispatch.app.answerMiss(context, dispatch.match);
+        return;
+      }
+
+      const auto& scoped = endpoint->middlewares;
+      size_t position = index - global.size();
+
+      if (position < scoped.size()) {
+        runStep(scoped[position], dispatch, context, index);
+      } else {
+        dispatch.app.runHandler(*endpoint, context);
       }
     }
 
+    static void runStep(const Middleware& middleware, Dispatch& dispatch, Context& context, size_t index) {
+      AllocationTracker::Scope allocationScope(AllocationTracker::Phase::Middleware);
+      auto start = context.timing.now();
+      middleware(context, Next(&App::runChain, &dispatch, context, index + 1));
+      context.timing.add(Timing::Phase::Middleware, start, context.timing.now(), static_cast<uint16_t>(index));
+    }
+
     public:
     App() = default;
     App(const App&) = delete;
@@ -113,10 +139,33 @@ namespace Metro {
       return *this;
     }
 
+    // Serve files under `directory` for GET requests below `prefix`
+    App& serveStatic(const std::string& prefix, const std::string& directory, StaticFiles::Options options = {}) {
+      std::string mount = prefix;
+      while (!mount.empty() && mount.back() == '/') mount.pop_back();
+
+      router_.addRoute(mount + "/*path", Constants::Http_Method::GET, StaticFiles(directory, std::move(options)));
+      return *this;
+    }
+
+    // Serve a bundle generated by tools/embed_assets.py for GET requests below `prefix`
+    App& serveEmbedded(const std::string& prefix, const EmbeddedBundle& bundle, EmbeddedFiles::Options options = {}) {
+      std::string mount = prefix;
+      while (!mount.empty() && mount.back() == '/') mount.pop_back();
+
+      router_.addRoute(mount + "/*path", Constants::Http_Method::GET, EmbeddedFiles(bundle, std::move(options)));
+      return *this;
+    }
+
     RouteBuilder route(const std::string& path) {
       return RouteBuilder(router_, path);
     }
 
+    // Routes under `prefix`; middleware added to the group runs only for them
+    RouteGroup group(const std::string& prefix) {
+      return RouteGroup(router_, prefix);
+    }
+
     App& get(const std::string& path, Handler handler) { 
       router_.addRoute(path, Constants::Http_Method::GET, std::move(handler));
       return *this;
@@ -146,9 +195,38 @@ namespace Metro {
       return *this;
     }
   
+    // Matches the request before any middleware runs, so the server can see
+    // whether the endpoint is blocking; misses are answered by dispatch()
+    Router::MatchResult resolve(Context& context) {
+      Timing& timing = context.timing;
+      auto start = timing.now();
+
+      Router::MatchResult match = [&]() {
+        AllocationTracker::Scope allocationScope(AllocationTracker::Phase::Route);
+        return router_.matchRoute(context.req.getPath(), context.req.getMethod(), context);
+      }();
+
+      timing.add(Timing::Phase::RouteMatch, start, timing.now());
+
+      if (match.endpoint) context.req.setRoute(match.endpoint->pattern);
+      return match;
+    }
+
+    // Runs global middleware, then the endpoint's own middleware and handler
+    void dispatch(Context& context, const Router::MatchResult& match) {
+      if (HttpFailure failure = negotiateResponse(context)) {
+        context.res
+          .status(failure.status)
+          .text(failure.message);
+        return;
+      }
+
+      Dispatch state{*this, match};
+      runChain(&state, context, 0);
+    }
+
     void handle(Context& context) {
-      negotiateResponse(context);
-      runMiddleware(context);
+      dispatch(context, resolve(context));
     }
   };
 }
@@ -9,6 +9,8 @@
 
 #include "context.h"
 #include "types.h"
+#include "async_logger.h"
+#include "http/http_error.h"
 
 // TODO: Add middleware for common tasks (CORS, compression, etc.)
 
@@ -18,14 +20,6 @@ namespace Metro {
   class Middlewares {
   public:
     static Middleware logger() {
-      constexpr const char * GREEN  = "\033[32m";
-      constexpr const char * RED    = "\033[31m";
-      constexpr const char * GRAY   = "\033[90m";
-      constexpr const char * YELLOW = "\033[33m";
-      constexpr const char * BLUE   = "\033[34m";
-      constexpr const char * RESET  = "\033[0m";
-
-
       return [](Context& context, Next next) {
         using clock = std::chrono::high_resolution_clock;
 
@@ -37,48 +31,105 @@ namespace Metro {
 
         auto start = clock::now();
         next();
-        auto end = clock::now();
 
-        auto duration_us = std::chrono::duration_cast<std::chrono::microseconds>(
-          end - start
-        ).count();
+        // A detached response only has its status once it is complete
+        if (context.detached()) {
+          context.whenComplete([start](Context& context) { printCompleted(context, start); });
+        } else {
+          printCompleted(context, start);
+        }
+      };
+    }
 
-        std::string time_str;
-        std::stringstream ss;
-        ss << std::fixed << std::setprecision(3);
+    // One line per request, formatted and written by a background thread
+    static Middleware asyncLogger(AsyncLogger& logger = AsyncLogger::shared()) {
+      return [&logger](Context& context, Next next) {
+        auto start = std::chrono::steady_clock::now();
 
-        double duration_ms = static_cast<double>(duration_us) / 1'000.0;
-          
-        if (duration_ms < 1'000.0) {
-          ss << duration_ms << " ms";
-        } else {
-          double duration_s = duration_ms / 1'000.0;
-          ss << duration_s << " s";
+        // Errors are still logged with the status the server will answer with
+        try {
+          next();
+        } catch (const HttpError& e) {
+          record(logger, context, start, e.status());
+          throw;
+        } catch (...) {
+          record(logger, context, start, Constants::Http_Status::INTERNAL_SERVER_ERROR);
+          throw;
         }
-          
-          time_str = ss.str();
-
-        const char* color;
-        if (context.res.getStatus() >= 500) {
-          color = RED;          
-        } else if (context.res.getStatus() >= 400) {
-          color = YELLOW;       
-        } else if (context.res.getStatus() >= 300) {
-          color = BLUE;         
-        } else if (context.res.getStatus() >= 200) {
-          color = GREEN;        
+
+        // A detached response is logged once it is complete, with its final status
+        if (context.detached()) {
+          context.whenComplete([&logger, start](Context& context) {
+            record(logger, context, start, context.res.getStatus());
+          });
         } else {
-          color = GRAY;         
+          record(logger, context, start, context.res.getStatus());
         }
-
-        std::cout
-          << "<-- "
-          << context.req.getMethod() << " "
-          << context.req.getPath() << " "
-          << color << context.res.getStatus() << RESET << " "
-          << time_str
-          << std::endl;
       };
     }
+
+  private:
+    static void printCompleted(const Context& context, std::chrono::high_resolution_clock::time_point start) {
+      constexpr const char * GREEN  = "\033[32m";
+      constexpr const char * RED    = "\033[31m";
+      constexpr const char * GRAY   = "\033[90m";
+      constexpr const char * YELLOW = "\033[33m";
+      constexpr const char * BLUE   = "\033[34m";
+      constexpr const char * RESET  = "\033[0m";
+
+      using clock = std::chrono::high_resolution_clock;
+      auto end = clock::now();
+
+      auto duration_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        end - start
+      ).count();
+
+      std::string time_str;
+      std::stringstream ss;
+      ss << std::fixed << std::setprecision(3);
+
+      double duration_ms = static_cast<double>(duration_us) / 1'000.0;
+
+      if (duration_ms < 1'000.0) {
+        ss << duration_ms << " ms";
+      } else {
+        double duration_s = duration_ms / 1'000.0;
+        ss << duration_s << " s";
+      }
+
+      time_str = ss.str();
+
+      const char* color;
+      if (context.res.getStatus() >= 500) {
+        color = RED;
+      } else if (context.res.getStatus() >= 400) {
+        color = YELLOW;
+      } else if (context.res.getStatus() >= 300) {
+        color = BLUE;
+      } else if (context.res.getStatus() >= 200) {
+        color = GREEN;
+      } else {
+        color = GRAY;
+      }
+
+      std::cout
+        << "<-- "
+        << context.req.getMethod() << " "
+        << context.req.getPath() << " "
+        << color << context.res.getStatus() << RESET << " "
+        << time_str
+        << std::endl;
+    }
+
+    static void record(AsyncLogger& logger, const Context& context, std::chrono::steady_clock::time_point start, int status) {
+      AsyncLogger::Record entry;
+      entry.setMethod(context.req.getMethod());
+      entry.setPath(context.req.getPath());
+      entry.status = status;
+      entry.duration_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()
+      );
+      logger.log(entry);
+    }
   };
 }
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Metro {
+
+  /**
+   * Bounded single-producer / single-consumer ring of trivially copyable records.
+   *
+   * push() and pop() are wait-free: the producer never blocks, it reports a full
+   * ring instead so the caller can drop the record and count the loss.
+   */
+  template <typename T>
+  class RingBuffer {
+    public:
+    explicit RingBuffer(size_t capacity)
+      : mask_(roundUp(capacity) - 1), slots_(mask_ + 1) {}
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    // Producer side
+    bool push(const T& record) {
+      size_t head = head_.load(std::memory_order_relaxed);
+      if (head - cachedTail_ > mask_) {
+        cachedTail_ = tail_.load(std::memory_order_acquire);
+        if (head - cachedTail_ > mask_) return false;
+      }
+
+      slots_[head & mask_] = record;
+      head_.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Consumer side
+    bool pop(T& record) {
+      size_t tail = tail_.load(std::memory_order_relaxed);
+      if (tail == head_.load(std::memory_order_acquire)) return false;
+
+      record = slots_[tail & mask_];
+      tail_.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Consumer side
+    bool empty() const {
+      return tail_.load(std::memory_order_relaxed) == head_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+    private:
+    static size_t roundUp(size_t value) {
+      size_t power = 2;
+      while (power < value) power <<= 1;
+      return power;
+    }
+
+    const size_t mask_;
+    std::vector<T> slots_;
+
+    // Producer and consumer indices live on separate cache lines
+    alignas(64) std::atomic<size_t> head_{0};
+    size_t cachedTail_ = 0;
+    alignas(64) std::atomic<size_t> tail_{0};
+  };
+
+  /**
+   * One RingBuffer per producing thread, collected by a single consumer.
+   *
+   * A thread registers its ring on first push (one mutex acquisition per
+   * thread lifetime); afterwards pushes touch only thread-local state. Rings of
+   * exited threads are drained and then released by the consumer.
+   */
+  template <typename T>
+  class ThreadRings {
+    public:
+    explicit ThreadRings(size_t capacityPerThread)
+      : capacity_(capacityPerThread), id_(nextId()) {}
+
+    ThreadRings(const ThreadRings&) = delete;
+    ThreadRings& operator=(const ThreadRings&) = delete;
+
+    // Never blocks; a full ring drops the record and bumps dropped()
+    bool push(const T& record) {
+      if (!local().push(record)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      return true;
+    }
+
+    // Consumer side: hands every queued record to `consume`, returns how many
+    template <typename Consume>
+    size_t drain(Consume&& consume) {
+      std::vector<std::shared_ptr<RingBuffer<T>>> rings;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings = rings_;
+      }
+
+      size_t count = 0;
+      T record;
+      for (auto& ring : rings) {
+        while (ring->pop(record)) {
+          consume(record);
+          ++count;
+        }
+      }
+
+      // Producer gone (only our copy and the registry remain) and ring empty
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto it = rings_.begin(); it != rings_.end();) {
+        if (it->use_count() == 2 && (*it)->empty()) {
+          it = rings_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+
+      return count;
+    }
+
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    private:
+    const size_t capacity_;
+    const uint64_t id_;
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<RingBuffer<T>>> rings_;
+    std::atomic<uint64_t> dropped_{0};
+
+    RingBuffer<T>& local() {
+      // Keyed by instance id rather than address so a new instance never inherits a stale ring
+      struct Registration {
+        uint64_t owner;
+        std::shared_ptr<RingBuffer<T>> ring;
+      };
+      thread_local std::vector<Registration> registrations;
+
+      for (auto& registration : registrations) {
+        if (registration.owner == id_) return *registration.ring;
+      }
+
+      auto ring = std::make_shared<RingBuffer<T>>(capacity_);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings_.push_back(ring);
+      }
+      registrations.push_back({id_, ring});
+      return *ring;
+    }
+
+    static uint64_t nextId() {
+      static std::atomic<uint64_t> counter{0};
+      return ++counter;
+    }
+  };
+}
@@ -7,11 +7,11 @@
 #include <algorithm>
 #include <memory>
 #include <functional>
+#include <stdexcept>
 
 #include "helpers.h"
 #include "types.h"
 #include "constants.h"
-#include "http/http_error.h"
 
 namespace Metro { struct Context; }
 
@@ -20,24 +20,33 @@ namespace Metro {
 
   class Router {
   public:
-    enum class MatchStatus { NotFound, MethodNotAllowed, Found };
+    // TooDeep: more path segments than the matcher will recurse through (answered with 414)
+    enum class MatchStatus { NotFound, MethodNotAllowed, Found, TooDeep };
 
     struct Endpoint {
       std::string method;
       Handler handler;
       std::vector<std::string> paramNames;
+      std::string pattern;                // path as registered, e.g. "/users/:id"
+      std::vector<Middleware> middlewares; // group and route middleware, run after global middleware
+      bool blocking = false;              // runs on the server's blocking pool, off the I/O thread
     };
 
     struct MatchResult {
       MatchStatus status;
-      Endpoint endpoint;
+      Endpoint* endpoint = nullptr;       // owned by the router; set when status is Found
       std::vector<std::string> allowedMethods; 
     };
 
     Router() : root_(std::make_unique<RouteNode>()) {}
 
     // Register a handler for specific path and method
-    void addRoute(const std::string& path, const std::string& method, Handler handler) {
+    // Segments may be literal, ":name" (one segment) or a trailing "*name" (rest of the path)
+    void addRoute(
+      const std::string& path, const std::string& method, Handler handler,
+      std::vector<Middleware> middlewares = {},
+      bool blocking = false
+    ) {
       std::vector<std::string> paramNames;
       RouteNode* node = root_.get();
       std::stringstream ss(path);
@@ -46,6 +55,25 @@ namespace Metro {
       while (std::getline(ss, segment, '/')) {
         if (segment.empty()) continue;
 
+        if (segment[0] == '*') {
+          std::string paramName = segment.substr(1);
+          if (!node->wildcardChild) {
+            node->wildcardChild = std::make_unique<RouteNode>();
+            node->wildcardName = paramName;
+          } else if (node->wildcardName != paramName) {
+            throw std::invalid_argument("Conflicting wildcard name in route: " + path);
+          }
+
+          std::string rest;
+          if (std::getline(ss, rest)) {
+            throw std::invalid_argument("Wildcard must be the last segment in route: " + path);
+          }
+
+          paramNames.push_back(paramName);
+          node = node->wildcardChild.get();
+          break;
+        }
+
         if (segment[0] == ':') {
           std::string paramName = segment.substr(1);
           auto it = node->paramChildren.find(paramName);
@@ -63,12 +91,13 @@ namespace Metro {
         }
       }
 
-      node->endpoints[method] = Endpoint{method, std::move(handler), paramNames};
+      node->endpoints[method] = Endpoint{method, std::move(handler), paramNames, path, std::move(middlewares), blocking};
     }
 
-    // Match a request path to an endpoint, populating context params
+    // Match a request path to an endpoint, populating context params. The
+    // parser has decoded the path already, so segments are taken as they are
     MatchResult matchRoute(const std::string& path, const std::string& method, Context& context) {
-      std::string normalized = Helpers::PathSanitizer::normalize(path);
+      std::string normalized = Helpers::PathSanitizer::resolveDecoded(path);
       std::stringstream ss(normalized);
       std::string segment;
       std::vector<std::string> segments;
@@ -77,11 +106,11 @@ namespace Metro {
         if (!segment.empty()) segments.push_back(segment);
       }
 
-      Endpoint endpoint;
+      Endpoint* endpoint = nullptr;
       std::vector<std::string> allowedMethods;
       auto status = resolveRoute(root_.get(), segments, 0, method, context, endpoint, &allowedMethods);
 
-      return MatchResult{status, std::move(endpoint), std::move(allowedMethods)};
+      return MatchResult{status, endpoint, std::move(allowedMethods)};
     }
 
   private:
@@ -89,32 +118,29 @@ namespace Metro {
       std::unordered_map<std::string, std::unique_ptr<RouteNode>> children;
       std::unordered_map<std::string, std::unique_ptr<RouteNode>> paramChildren;
       std::unordered_map<std::string, Endpoint> endpoints;
+      std::unique_ptr<RouteNode> wildcardChild;
+      std::string wildcardName;
     };
 
     std::unique_ptr<RouteNode> root_;
 
     MatchStatus resolveRoute(
       RouteNode* node, const std::vector<std::string>& segments, size_t index,
-      const std::string& method, Context& context, Endpoint& outEndpoint,
+      const std::string& method, Context& context, Endpoint*& outEndpoint,
       std::vector<std::string>* allowedMethods
     ) {
       if (!node) return MatchStatus::NotFound;
-      if (index > 100) { 
-        throw HttpError(
-          Constants::Http_Status::URI_TOO_LONG, 
-          "Route recursion too deep"
-        );
-      }
+      if (index > 100) return MatchStatus::TooDeep;
 
       if (index == segments.size()) {
         auto it = node->endpoints.find(method);
         if (it != node->endpoints.end()) {
-          outEndpoint = it->second;
+          outEndpoint = &it->second;
           return MatchStatus::Found;
         }
 
         if (node->endpoints.empty()) {
-          return MatchStatus::NotFound;
+          return resolveWildcard(node, segments, index, method, context, outEndpoint, allowedMethods);
         }
 
         if (allowedMethods) {
@@ -139,20 +165,24 @@ namespace Metro {
       std::vector<std::string> allAllowed;
 
       for (auto& [paramName, childNode] : node->paramChildren) {
-        context.req.getParams()[paramName] = Helpers::PathSanitizer::decodeSegment(seg);
+        context.req.setParam(paramName, seg);
         
         std::vector<std::string> branchAllowed;
         auto result = resolveRoute(childNode.get(), segments, index + 1, method,
                                   context, outEndpoint, &branchAllowed);
 
-        if (result == MatchStatus::Found) {
-          return MatchStatus::Found;
+        if (result == MatchStatus::Found || result == MatchStatus::TooDeep) {
+          return result;
         } else if (result == MatchStatus::MethodNotAllowed) {
           bestResult = MatchStatus::MethodNotAllowed;
           allAllowed.insert(allAllowed.end(), branchAllowed.begin(), branchAllowed.end());
         }
         
-        context.req.getParams().erase(paramName);
+        context.req.removeParam(paramName);
+      }
+
+      if (bestResult == MatchStatus::NotFound) {
+        return resolveWildcard(node, segments, index, method, context, outEndpoint, allowedMethods);
       }
 
       if (bestResult == MatchStatus::MethodNotAllowed && allowedMethods) {
@@ -164,18 +194,62 @@ namespace Metro {
 
       return bestResult;
     }
+
+    // Catch-all match: binds the remaining segments, joined by '/', to the wildcard name
+    MatchStatus resolveWildcard(
+      RouteNode* node, const std::vector<std::string>& segments, size_t index,
+      const std::string& method, Context& context, Endpoint*& outEndpoint,
+      std::vector<std::string>* allowedMethods
+    ) {
+      RouteNode* wildcard = node->wildcardChild.get();
+      if (!wildcard || wildcard->endpoints.empty()) return MatchStatus::NotFound;
+
+      auto it = wildcard->endpoints.find(method);
+      if (it == wildcard->endpoints.end()) {
+        if (allowedMethods) {
+          allowedMethods->clear();
+          for (const auto& [method, _] : wildcard->endpoints) {
+            allowedMethods->push_back(method);
+          }
+        }
+        return MatchStatus::MethodNotAllowed;
+      }
+
+      std::string rest;
+      for (size_t i = index; i < segments.size(); ++i) {
+        if (i > index) rest += '/';
+        rest += segments[i];
+      }
+
+      context.req.setParam(node->wildcardName, rest);
+      outEndpoint = &it->second;
+      return MatchStatus::Found;
+    }
   };
 
   class RouteBuilder {
   public:
-    RouteBuilder(Router& router, std::string path) 
-      : router_(router), path_(std::move(path)) {}
+    RouteBuilder(Router& router, std::string path, std::vector<Middleware> middlewares = {}, bool blocking = false)
+      : router_(router), path_(std::move(path)), middlewares_(std::move(middlewares)), blocking_(blocking) {}
 
     RouteBuilder(const RouteBuilder&) = delete;
     RouteBuilder& operator=(const RouteBuilder&) = delete;
     RouteBuilder(RouteBuilder&&) = default;
     RouteBuilder& operator=(RouteBuilder&&) = default;
 
+    // Runs for methods registered on this route afterwards, after global and group middleware
+    RouteBuilder& use(Middleware middleware) {
+      middlewares_.push_back(std::move(middleware));
+      return *this;
+    }
+
+    // Methods registered afterwards may block (database calls, sleeps); the
+    // server runs them, middleware included, on its bounded blocking pool
+    RouteBuilder& blocking(bool enable = true) {
+      blocking_ = enable;
+      return *this;
+    }
+
     RouteBuilder& get(Handler handler) { 
       registerMethod(Constants::Http_Method::GET, std::move(handler)); 
       return *this; 
@@ -226,9 +300,90 @@ namespace Metro {
   private:
     Router& router_;
     std::string path_;
+    std::vector<Middleware> middlewares_;
+    bool blocking_ = false;
 
     void registerMethod(const std::string& method, Handler handler) {
-      router_.addRoute(path_, method, std::move(handler));
+      router_.addRoute(path_, method, std::move(handler), middlewares_, blocking_);
+    }
+  };
+
+  /**
+   * Routes sharing a path prefix and a middleware stack.
+   *
+   * Group middleware is copied into each endpoint when the route is
+   * registered, so only routes under the group pay for it and the request
+   * path does no extra lookup. Middleware therefore applies to routes
+   * registered on the group after the use() call, not before. Nested groups
+   * inherit their parent's prefix and middleware.
+   */
+  class RouteGroup {
+  public:
+    RouteGroup(Router& router, std::string prefix, std::vector<Middleware> middlewares = {}, bool blocking = false)
+      : router_(router), prefix_(std::move(prefix)), middlewares_(std::move(middlewares)), blocking_(blocking) {
+      while (!prefix_.empty() && prefix_.back() == '/') prefix_.pop_back();
+    }
+
+    RouteGroup(const RouteGroup&) = delete;
+    RouteGroup& operator=(const RouteGroup&) = delete;
+    RouteGroup(RouteGroup&&) = default;
+    RouteGroup& operator=(RouteGroup&&) = default;
+
+    RouteGroup& use(Middleware middleware) {
+      middlewares_.push_back(std::move(middleware));
+      return *this;
+    }
+
+    // Routes registered afterwards may block; see RouteBuilder::blocking()
+    RouteGroup& blocking(bool enable = true) {
+      blocking_ = enable;
+      return *this;
+    }
+
+    RouteGroup group(const std::string& prefix) const {
+      return RouteGroup(router_, join(prefix), middlewares_, blocking_);
+    }
+
+    RouteBuilder route(const std::string& path) const {
+      return RouteBuilder(router_, join(path), middlewares_, blocking_);
+    }
+
+    RouteGroup& get(const std::string& path, Handler handler) {
+      return add(path, Constants::Http_Method::GET, std::move(handler));
+    }
+    RouteGroup& post(const std::string& path, Handler handler) {
+      return add(path, Constants::Http_Method::POST, std::move(handler));
+    }
+    RouteGroup& put(const std::string& path, Handler handler) {
+      return add(path, Constants::Http_Method::PUT, std::move(handler));
+    }
+    RouteGroup& del(const std::string& path, Handler handler) {
+      return add(path, Constants::Http_Method::DELETE, std::move(handler));
+    }
+    RouteGroup& patch(const std::string& path, Handler handler) {
+      return add(path, Constants::Http_Method::PATCH, std::move(handler));
+    }
+    RouteGroup& head(const std::string& path, Handler handler) {
+      return add(path, Constants::Http_Method::HEAD, std::move(handler));
+    }
+    RouteGroup& options(const std::string& path, Handler handler) {
+      return add(path, Constants::Http_Method::OPTIONS, std::move(handler));
+    }
+
+  private:
+    Router& router_;
+    std::string prefix_;
+    std::vector<Middleware> middlewares_;
+    bool blocking_ = false;
+
+    std::string join(const std::string& path) const {
+      if (path.empty() || path == "/") return prefix_.empty() ? "/" : prefix_;
+      return path.front() == '/' ? prefix_ + path : prefix_ + "/" + path;
+    }
+
+    RouteGroup& add(const std::string& path, const std::string& method, Handler handler) {
+      router_.addRoute(join(path), method, std::move(handler), middlewares_, blocking_);
+      return *this;
     }
   };
 }
@@ -0,0 +1,417 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Metro {
+
+  /**
+   * Chase-Lev work-stealing deque of pointers (Le, Pop, Cohen, Zappa Nardelli,
+   * "Correct and Efficient Work-Stealing for Weak Memory Models", 2013).
+   *
+   * The owning thread pushes and pops at the bottom, LIFO, so it keeps working
+   * on what it touched last; any other thread steals the oldest item from the
+   * top. Only the last item is ever contended, with one CAS. The ring doubles
+   * when full; replaced rings are kept until destruction because a thief may
+   * still be reading one.
+   */
+  template <typename T>
+  class WorkDeque {
+    static_assert(std::is_pointer<T>::value, "WorkDeque holds pointers; nullptr means empty");
+
+    public:
+    explicit WorkDeque(int64_t capacity = 256) {
+      arrays_.push_back(std::make_unique<Array>(capacity));
+      array_.store(arrays_.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkDeque(const WorkDeque&) = delete;
+    WorkDeque& operator=(const WorkDeque&) = delete;
+
+    // Owner only
+    void push(T item) {
+      int64_t bottom = bottom_.load(std::memory_order_relaxed);
+      int64_t top = top_.load(std::memory_order_acquire);
+      Array* array = array_.load(std::memory_order_relaxed);
+
+      if (bottom - top > array->mask) array = grow(array, top, bottom);
+
+      array->put(bottom, item);
+      bottom_.store(bottom + 1, std::memory_order_release);
+    }
+
+    // Owner only; nullptr when empty
+    T pop() {
+      int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+      Array* array = array_.load(std::memory_order_relaxed);
+      bottom_.store(bottom, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t top = top_.load(std::memory_order_relaxed);
+
+      if (top > bottom) {
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+      }
+
+      T item = array->get(bottom);
+      if (top == bottom) {
+        // Last item: race the thieves for it
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+          item = nullptr;
+        }
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+      }
+      return item;
+    }
+
+    // Any thread; nullptr when empty or when another thread won the item
+    T steal() {
+      int64_t top = top_.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t bottom = bottom_.load(std::memory_order_acquire);
+      if (top >= bottom) return nullptr;
+
+      Array* array = array_.load(std::memory_order_acquire);
+      T item = array->get(top);
+      if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+      }
+      return item;
+    }
+
+    bool empty() const {
+      return top_.load(std::memory_order_acquire) >= bottom_.load(std::memory_order_acquire);
+    }
+
+    private:
+    struct Array {
+      explicit Array(int64_t capacity)
+        : mask(capacity - 1), slots(new std::atomic<T>[static_cast<size_t>(capacity)]) {}
+
+      const int64_t mask;                 // capacity - 1; capacity is a power of two
+      std::unique_ptr<std::atomic<T>[]> slots;
+
+      T get(int64_t index) const { return slots[index & mask].load(std::memory_order_relaxed); }
+      void put(int64_t index, T item) { slots[index & mask].store(item, std::memory_order_relaxed); }
+    };
+
+    alignas(64) std::atomic<int64_t> top_{0};
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    std::atomic<Array*> array_{nullptr};
+    std::vector<std::unique_ptr<Array>> arrays_;   // touched by the owner only
+
+    Array* grow(Array* array, int64_t top, int64_t bottom) {
+      arrays_.push_back(std::make_unique<Array>((array->mask + 1) * 2));
+      Array* bigger = arrays_.back().get();
+      for (int64_t i = top; i < bottom; ++i) bigger->put(i, array->get(i));
+      array_.store(bigger, std::memory_order_release);
+      return bigger;
+    }
+  };
+
+  /**
+   * Work-stealing executor for request handling.
+   *
+   * Every worker owns a WorkDeque for tasks it spawns itself and a small
+   * locked inbox for tasks posted to it from other threads, so there is no
+   * global queue lock. An idle worker drains its deque, then its inbox, then
+   * steals from randomly chosen victims (their deque first, then their inbox)
+   * before it sleeps.
+   *
+   * post() gives affinity: the server posts a connection's next request, and
+   * the rest of a parked request, to the worker that parsed it, and another
+   * worker only takes it over when that one is busy. Handlers reach the
+   * scheduler through TaskGroup.
+   */
+  class Scheduler {
+    public:
+    using Task = std::function<void()>;
+
+    static constexpr size_t NONE = static_cast<size_t>(-1);
+
+    explicit Scheduler(size_t threads) {
+      if (threads == 0) threads = 1;
+
+      workers_.reserve(threads);
+      for (size_t i = 0; i < threads; ++i) {
+        workers_.push_back(std::make_unique<Worker>(0x9e3779b97f4a7c15ull * (i + 1)));
+      }
+      for (size_t i = 0; i < threads; ++i) {
+        workers_[i]->thread = std::thread([this, i] { run(i); });
+      }
+    }
+
+    // Lets running tasks finish, then joins; tasks still queued are dropped
+    ~Scheduler() {
+      stopping_.store(true, std::memory_order_seq_cst);
+      {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        epoch_++;
+      }
+      sleep_.notify_all();
+
+      for (auto& worker : workers_) worker->thread.join();
+
+      for (auto& worker : workers_) {
+        while (Job* job = worker->deque.pop()) delete job;
+        for (Job* job : worker->inbox) delete job;
+      }
+    }
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    size_t size() const noexcept { return workers_.size(); }
+
+    // From any thread, to no worker in particular
+    void submit(Task task) {
+      post(next_.fetch_add(1, std::memory_order_relaxed) % workers_.size(), std::move(task));
+    }
+
+    // From any thread, to `worker` unless another worker steals it first
+    void post(size_t worker, Task task) {
+      Worker& target = *workers_[worker % workers_.size()];
+      {
+        std::lock_guard<std::mutex> lock(target.inboxMutex);
+        target.inbox.push_back(new Job{std::move(task)});
+        target.inboxSize.fetch_add(1, std::memory_order_relaxed);
+      }
+      wake();
+    }
+
+    // On a worker: onto its own deque, where idle workers can steal it. Elsewhere: submit()
+    void spawn(Task task) {
+      if (current() != this) {
+        submit(std::move(task));
+        return;
+      }
+      workers_[tlsWorker_]->deque.push(new Job{std::move(task)});
+      wake();
+    }
+
+    // On a worker: runs one spawned task (own deque, else stolen) and returns
+    // true, or false when there was none. Lets a waiting task help instead of block
+    bool runOne() {
+      if (current() != this) return false;
+
+      size_t self = tlsWorker_;
+      Job* job = workers_[self]->deque.pop();
+      if (!job) job = stealFrom(self, false);
+      if (!job) return false;
+
+      execute(job);
+      return true;
+    }
+
+    // The scheduler whose worker is running the calling thread, or nullptr
+    static Scheduler* current() noexcept { return tlsScheduler_; }
+
+    // Index of the calling worker in current(), or NONE
+    static size_t currentWorker() noexcept { return tlsScheduler_ ? tlsWorker_ : NONE; }
+
+    private:
+    struct Job {
+      Task run;
+    };
+
+    struct Worker {
+      explicit Worker(uint64_t seed) : rng(seed) {}
+
+      WorkDeque<Job*> deque;
+      std::mutex inboxMutex;
+      std::deque<Job*> inbox;
+      std::atomic<size_t> inboxSize{0};   // lets thieves and sleepers skip empty inboxes without locking
+      std::thread thread;
+      uint64_t rng;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> next_{0};
+    std::atomic<bool> stopping_{false};
+
+    std::mutex sleepMutex_;
+    std::condition_variable sleep_;
+    std::atomic<size_t> sleeping_{0};
+    uint64_t epoch_ = 0;                  // bumped under sleepMutex_ to wake sleepers
+
+    static inline thread_local Scheduler* tlsScheduler_ = nullptr;
+    static inline thread_local size_t tlsWorker_ = 0;
+
+    void run(size_t self) {
+      tlsScheduler_ = this;
+      tlsWorker_ = self;
+
+      while (!stopping_.load(std::memory_order_acquire)) {
+        if (Job* job = findWork(self)) {
+          execute(job);
+          continue;
+        }
+        idle();
+      }
+    }
+
+    static void execute(Job* job) {
+      std::unique_ptr<Job> owned(job);
+      owned->run();
+    }
+
+    Job* findWork(size_t self) {
+      Worker& worker = *workers_[self];
+      if (Job* job = worker.deque.pop()) return job;
+      if (Job* job = takeInbox(worker, false)) return job;
+      return stealFrom(self, true);
+    }
+
+    Job* takeInbox(Worker& worker, bool thief) {
+      if (worker.inboxSize.load(std::memory_order_relaxed) == 0) return nullptr;
+
+      std::unique_lock<std::mutex> lock(worker.inboxMutex, std::defer_lock);
+      if (thief) {
+        if (!lock.try_lock()) return nullptr;
+      } else {
+        lock.lock();
+      }
+
+      if (worker.inbox.empty()) return nullptr;
+      Job* job = worker.inbox.front();
+      worker.inbox.pop_front();
+      worker.inboxSize.fetch_sub(1, std::memory_order_relaxed);
+      return job;
+    }
+
+    // A few randomized victims; inboxes hold new requests, deques hold spawned subtasks
+    Job* stealFrom(size_t self, bool inboxes) {
+      const size_t count = workers_.size();
+      if (count < 2) return nullptr;
+
+      uint64_t& rng = workers_[self]->rng;
+      for (size_t attempt = 0; attempt < count * 2; ++attempt) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+
+        size_t victim = static_cast<size_t>(rng % count);
+        if (victim == self) continue;
+
+        Worker& target = *workers_[victim];
+        if (Job* job = target.deque.steal()) return job;
+        if (inboxes) {
+          if (Job* job = takeInbox(target, true)) return job;
+        }
+      }
+      return nullptr;
+    }
+
+    bool hasWork() const {
+      for (const auto& worker : workers_) {
+        if (!worker->deque.empty() || worker->inboxSize.load(std::memory_order_relaxed) > 0) return true;
+      }
+      return false;
+    }
+
+    void wake() {
+      // Pairs with the fence in idle(): either the sleeper sees the new task or we see the sleeper
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (sleeping_.load(std::memory_order_relaxed) == 0) return;
+
+      {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        epoch_++;
+      }
+      sleep_.notify_one();
+    }
+
+    void idle() {
+      std::unique_lock<std::mutex> lock(sleepMutex_);
+      uint64_t seen = epoch_;
+
+      sleeping_.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      if (!hasWork() && !stopping_.load(std::memory_order_acquire)) {
+        sleep_.wait(lock, [&] { return epoch_ != seen || stopping_.load(std::memory_order_acquire); });
+      }
+      sleeping_.fetch_sub(1, std::memory_order_relaxed);
+    }
+  };
+
+  /**
+   * Fork-join for handlers: spawn() subtasks (calls to several backends, a
+   * CPU-heavy transform split in parts), then wait() for all of them.
+   *
+   * On a scheduler worker the subtasks land on that worker's deque, where
+   * idle workers steal them, and wait() runs spawned tasks rather than
+   * blocking the thread. Anywhere else (no worker threads configured,
+   * TestClient, the blocking pool) spawn() runs the task inline.
+   *
+   *   TaskGroup group;
+   *   group.spawn([&] { user = users.fetch(id); });
+   *   group.spawn([&] { orders = orders.fetch(id); });
+   *   group.wait();
+   */
+  class TaskGroup {
+    public:
+    TaskGroup() = default;
+    ~TaskGroup() { drain(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void spawn(std::function<void()> task) {
+      Scheduler* scheduler = Scheduler::current();
+      if (!scheduler) {
+        guarded(task);
+        return;
+      }
+
+      pending_.fetch_add(1, std::memory_order_relaxed);
+      scheduler->spawn([this, task = std::move(task)] {
+        guarded(task);
+        pending_.fetch_sub(1, std::memory_order_acq_rel);
+      });
+    }
+
+    // Returns once every spawned task has finished; rethrows the first exception one of them threw
+    void wait() {
+      drain();
+
+      std::exception_ptr error;
+      {
+        std::lock_guard<std::mutex> lock(errorMutex_);
+        error = std::exchange(error_, nullptr);
+      }
+      if (error) std::rethrow_exception(error);
+    }
+
+    private:
+    std::atomic<size_t> pending_{0};
+    std::mutex errorMutex_;
+    std::exception_ptr error_;
+
+    void drain() {
+      Scheduler* scheduler = Scheduler::current();
+      while (pending_.load(std::memory_order_acquire) > 0) {
+        if (!scheduler || !scheduler->runOne()) std::this_thread::yield();
+      }
+    }
+
+    void guarded(const std::function<void()>& task) {
+      try {
+        task();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex_);
+        if (!error_) error_ = std::current_exception();
+      }
+    }
+  };
+}
@@ -1,46 +1,101 @@
 #pragma once
 
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <arpa/inet.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "metro.h"
 #include "helpers.h"
 #include "config.h"
+#include "access_log.h"
+#include "metrics.h"
+#include "alloc_tracker.h"
+#include "arena.h"
+#include "health.h"
+#include "worker_pool.h"
+#include "scheduler.h"
+#include "event_loop.h"
+#include "timer_wheel.h"
 #include "http/http_parser.h"
 #include "http/http_writer.h"
 
 namespace Metro {
+  class TestClient;
+
   class Server {
+    friend class TestClient;
+
     App& app;
     int port;
     Config config;
+    AccessLog* accessLog = nullptr;
+    Metrics* metrics = nullptr;
+    const HealthCheck* health = nullptr;
   
     public:
 
     Server(App& appInstance, int listenPort) : app(appInstance), port(listenPort) {}
+    Server(App& appInstance, int listenPort, Config serverConfig)
+      : app(appInstance), port(listenPort), config(std::move(serverConfig)) {}
+
+    // Records every request, including rejected ones; the log must outlive the server
+    Server& setAccessLog(AccessLog& log) {
+      accessLog = &log;
+      return *this;
+    }
+
+    // Feeds per-route counters and latency histograms; serve them with metrics.handler()
+    Server& setMetrics(Metrics& registry) {
+      metrics = &registry;
+      return *this;
+    }
+  
+    // Answers load balancer probes on the I/O thread, before parsing; the health check must outlive the server
+    Server& setHealthCheck(const HealthCheck& check) {
+      health = &check;
+      return *this;
+    }
   
+    // Connections wait in epoll on this thread, and requests are read here
+    // without blocking, each stage under a deadline on the loop's timer
+    // wheel. Requests are served here too, or on the work-stealing scheduler
+    // when worker_threads is set; requests on blocking routes run on the
+    // blocking pool, and coroutine handlers are resumed here
     void listen() {
       int serverSocket = createSocket();
       SocketGuard serverGuard(serverSocket);
 
       bindSocket(serverSocket);
       startListen(serverSocket);
+      setNonBlocking(serverSocket);
 
-      std::cout << "Listening on port " << port << "\n";
+      if (config.server().worker_threads > 0) {
+        scheduler = std::make_unique<Scheduler>(config.server().worker_threads);
+      }
 
-      while (true) {
-        int clientSocket = accept(serverSocket, nullptr, nullptr);
-        if (clientSocket < 0) continue;
+      spareDescriptor = open("/dev/null", O_RDONLY | O_CLOEXEC);
+      listening = true;
+      loop.watch(serverSocket, EPOLLIN, [this, serverSocket](uint32_t) { acceptConnections(serverSocket); });
 
-        handleConnection(clientSocket);
-      }
+      std::cout << "Listening on port " << port << "\n";
+      loop.run();
     }
   
     private:
@@ -103,79 +158,628 @@ namespace Metro {
       }
     }
   
-    void setTimeout(int socketFileDescriptor) {
-      timeval timeout{};
-      timeout.tv_sec = config.server().timeout_seconds;
-      timeout.tv_usec = 0;
-  
-      if (setsockopt(socketFileDescriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) {
-        std::cerr << "Warning: Failed to set receive timeout on socket: " 
-                  << std::strerror(errno) << std::endl;
+    // Reads never wait, and neither do responses: what the socket does not
+    // take is sent by the loop on EPOLLOUT. Only long-lived streams, written
+    // off the I/O thread, wait in poll() under timeout_seconds, so no socket
+    // needs SO_RCVTIMEO or SO_SNDTIMEO
+    static void setNonBlocking(int socketFileDescriptor) {
+      fcntl(socketFileDescriptor, F_SETFL, fcntl(socketFileDescriptor, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    using Clock = std::chrono::steady_clock;
+
+    enum class Outcome { KeepAlive, Close, Parked };
+
+    // Keep-alive state of one client connection
+    struct Connection {
+      int socket;
+      sockaddr_storage clientAddress{};
+      size_t requestCount = 0;
+      bool keepAlive = false;
+      bool timed = false;
+      bool parked = false;                // loop thread: a detached request is waiting under its deadline
+      size_t worker = 0;                  // scheduler worker that served its last request
+      Outcome outcome = Outcome::KeepAlive;  // of the last settled request, for serveRequest()
+      RequestArena arena;
+      // Gathers the next request, body included, while the connection waits in epoll
+      HttpRequestReader reader;
+      // Idle, header or body deadline of the request being gathered; armed on the loop thread only
+      TimerWheel::Entry deadline;
+      // Request and response heads; cleared per request, capacity kept for the connection's lifetime
+      std::string requestHead;
+      std::string responseHead;
+      // Response bytes the socket has not taken yet; sent by the loop once it is writable
+      HttpWriter::Backlog backlog;
+      // The request in flight; outlives beginRequest() while it is parked
+      std::optional<Context> context;
+
+      Connection(int socket, const sockaddr_storage& clientAddress)
+        : socket(socket), clientAddress(clientAddress) {}
+    };
+
+    // Declared first so worker threads are joined before the loop they post to goes away
+    EventLoop loop;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;   // loop thread only
+    bool listening = false;
+    std::unique_ptr<WorkerPool> blockingPool;   // started by the first blocking request
+    std::once_flag blockingPoolStarted;
+    std::unique_ptr<WorkerPool> streamPool;     // started by the first long-lived stream
+    std::once_flag streamPoolStarted;
+    std::unique_ptr<Scheduler> scheduler;       // only with worker_threads > 0
+    size_t nextWorker = 0;
+    int spareDescriptor = -1;                   // given up to shed a client when out of descriptors
+
+    // A client accept() cannot take, e.g. for want of descriptors, stays
+    // queued and keeps the listening socket readable, so the loop would spin.
+    // The spare descriptor makes room to accept and close it; without one,
+    // accepting pauses for a moment instead
+    void shedConnection(int serverSocket) {
+      int error = errno;
+      std::cerr << "accept() failed: " << std::strerror(error) << "\n";
+      if (spareDescriptor >= 0 && (error == EMFILE || error == ENFILE)) {
+        close(spareDescriptor);
+        int clientSocket = accept4(serverSocket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (clientSocket >= 0) close(clientSocket);
+        spareDescriptor = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (spareDescriptor >= 0) return;
       }
 
-      if (setsockopt(socketFileDescriptor, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0) {
-        std::cerr << "Warning: Failed to set send timeout on socket: " 
-                  << std::strerror(errno) << std::endl;
+      loop.modify(serverSocket, 0);
+      loop.after(std::chrono::milliseconds(100), [this, serverSocket] { loop.modify(serverSocket, EPOLLIN); });
+    }
+
+    void acceptConnections(int serverSocket) {
+      while (true) {
+        sockaddr_storage clientAddress{};
+        socklen_t clientAddressLength = sizeof(clientAddress);
+
+        int clientSocket = accept4(
+          serverSocket,
+          reinterpret_cast<sockaddr*>(&clientAddress),
+          &clientAddressLength,
+          SOCK_NONBLOCK | SOCK_CLOEXEC
+        );
+        if (clientSocket < 0) {
+          if (errno == EINTR || errno == ECONNABORTED) continue;
+          if (errno != EAGAIN && errno != EWOULDBLOCK) shedConnection(serverSocket);
+          return;
+        }
+
+        auto& slot = connections[clientSocket];
+        slot = std::make_unique<Connection>(clientSocket, clientAddress);
+        Connection& connection = *slot;
+        if (scheduler) connection.worker = nextWorker++ % scheduler->size();
+
+        connection.deadline.callback = [this, &connection] { expire(connection); };
+        loop.wheel().arm(connection.deadline, std::chrono::seconds(config.server().keep_alive_timeout_seconds));
+
+        // Armed for EPOLLOUT only while a response is backlogged, and for
+        // nothing but hang-ups while a detached request is parked
+        loop.watch(clientSocket, EPOLLIN | EPOLLONESHOT, [this, &connection](uint32_t) {
+          if (connection.parked) {
+            takeParked(connection, true);
+          } else if (connection.backlog.empty()) {
+            readable(connection);
+          } else {
+            writable(connection);
+          }
+        });
       }
     }
 
-    void handleConnection(int clientSocket) {
-      SocketGuard guard(clientSocket);
-      setTimeout(clientSocket);
+    // On the I/O thread: takes whatever the client has sent. A partial request
+    // waits for more under its stage's deadline; a complete one is served
+    void readable(Connection& connection) {
+      HttpRequestReader& reader = connection.reader;
+      const auto stage = reader.stage();
 
-      auto lastActivity = std::chrono::steady_clock::now();
-      const auto maxKeepAliveDuration = std::chrono::seconds(config.server().keep_alive_timeout_seconds);
-      const size_t maxRequestsPerConnection = config.server().max_keep_alive_requests;
+      auto status = reader.receive(connection.socket, connection.requestHead, HttpLimits(config), timed());
 
-      size_t requestCount = 0;
-      bool connectionOpen = true;
-      bool keepAlive      = false;
+      if (status == HttpRequestReader::Status::Closed) {
+        settle(connection, Outcome::Close);
+        return;
+      }
 
-      while (connectionOpen) {
-        auto now = std::chrono::steady_clock::now();
-        if (now - lastActivity > maxKeepAliveDuration) {
-          break;
+      if (status == HttpRequestReader::Status::NeedMore) {
+        // The header deadline runs from the request's first byte and the body
+        // deadline from the end of its head; trickling bytes extends neither
+        if (reader.stage() != stage) {
+          int seconds = reader.stage() == HttpRequestReader::Stage::Head
+            ? config.server().header_timeout_seconds
+            : config.server().timeout_seconds;
+          loop.wheel().arm(connection.deadline, std::chrono::seconds(seconds));
         }
+        loop.modify(connection.socket, EPOLLIN | EPOLLONESHOT);
+        return;
+      }
 
-        Context context;
-        bool    parseSuccess = false;
+      loop.wheel().cancel(connection.deadline);
 
-        try {
-          parseSuccess = HttpParser::parse(clientSocket, context, config);
-        } catch (HttpError& e) {
-          context.res
-            .status(e.status())
-            .text(e.what());
+      // Answered here, so probes never wait behind a busy scheduler
+      if (auto outcome = answerProbe(connection)) {
+        settle(connection, *outcome);
+        return;
+      }
 
-          HttpWriter::write(clientSocket, context, keepAlive);
-          break;
-        }
+      if (scheduler) {
+        scheduler->post(connection.worker, [this, &connection] {
+          release(connection, beginRequest(connection));
+        });
+      } else {
+        settle(connection, beginRequest(connection));
+      }
+    }
+
+    // On the I/O thread: re-arms a kept-alive connection for its next request, or
+    // closes it, once any backlogged response has gone out
+    void settle(Connection& connection, Outcome outcome) {
+      connection.outcome = outcome;
+      if (outcome == Outcome::Parked) return;
+
+      if (connection.parked) {
+        connection.parked = false;
+        loop.wheel().cancel(connection.deadline);
+      }
+      if (!listening) return;
+
+      // The deadline starts at this stall and covers the rest of the response
+      if (!connection.backlog.empty()) {
+        loop.wheel().arm(connection.deadline, std::chrono::seconds(config.server().timeout_seconds));
+        loop.modify(connection.socket, EPOLLOUT | EPOLLONESHOT);
+        return;
+      }
+
+      if (outcome == Outcome::KeepAlive) {
+        rearm(connection);
+        return;
+      }
+
+      int fd = connection.socket;
+      loop.unwatch(fd);
+      connections.erase(fd);
+      close(fd);
+    }
+
+    // On the I/O thread: sends more of a backlogged response, then settles the
+    // connection as its request decided
+    void writable(Connection& connection) {
+      if (!HttpWriter::flush(connection.socket, connection.backlog)) {
+        connection.backlog.clear();
+        settle(connection, Outcome::Close);
+        return;
+      }
+
+      if (!connection.backlog.empty()) {
+        loop.modify(connection.socket, EPOLLOUT | EPOLLONESHOT);
+        return;
+      }
+
+      // Stalls are rare, so the memory is not kept for the next one
+      connection.backlog = HttpWriter::Backlog();
+      loop.wheel().cancel(connection.deadline);
+      settle(connection, connection.outcome);
+    }
+
+    // On a scheduler worker: hands the connection back to the I/O thread,
+    // which owns the connection table and the timer wheel
+    void release(Connection& connection, Outcome outcome) {
+      if (outcome == Outcome::Parked) return;
+      loop.post([this, &connection, outcome] { settle(connection, outcome); });
+    }
+
+    // Waits for the next request, closing the connection if it stays idle past keep_alive_timeout_seconds
+    void rearm(Connection& connection) {
+      HttpRequestReader& reader = connection.reader;
+
+      // Its start is already off the socket, so epoll would not report it. The
+      // deadline is cancelled and the socket disarmed, so nothing else reaches
+      // the connection before this task runs
+      if (reader.pipelined(connection.requestHead)) {
+        reader.reset(connection.requestHead);
+        loop.post([this, &connection] { readable(connection); });
+        return;
+      }
+
+      reader.reset(connection.requestHead);
+      loop.wheel().arm(connection.deadline, std::chrono::seconds(config.server().keep_alive_timeout_seconds));
+      loop.modify(connection.socket, EPOLLIN | EPOLLONESHOT);
+    }
+
+    // Requests record phase timings only when something consumes them
+    bool timed() const { return accessLog || metrics || config.server().server_timing; }
+
+    // On the I/O thread, when a connection's deadline passes: an idle one or one
+    // whose client stopped reading its response is closed quietly, a partly
+    // received request is answered 408 first
+    void expire(Connection& connection) {
+      if (connection.parked) {
+        takeParked(connection, false);
+        return;
+      }
+
+      if (!connection.backlog.empty()) {
+        connection.backlog.clear();
+      } else if (connection.reader.stage() != HttpRequestReader::Stage::Idle) {
+        static const std::string timeout =
+          "HTTP/1.1 408 Request Timeout\r\nContent-Type: text/plain\r\nContent-Length: 15\r\n"
+          "Connection: close\r\n\r\nRequest Timeout";
+        // Never waits: the client has already had its time
+        HttpWriter::writeRaw(connection.socket, timeout, 0);
+      }
+      settle(connection, Outcome::Close);
+    }
+
+    // Serves one request start to finish, running the event loop on this
+    // thread while the request is parked; used by TestClient
+    bool serveRequest(Connection& connection) {
+      HttpRequestReader& reader = connection.reader;
+      reader.reset(connection.requestHead);
+
+      HttpRequestReader::Status status;
+      while ((status = reader.receive(connection.socket, connection.requestHead, HttpLimits(config), timed())) ==
+             HttpRequestReader::Status::NeedMore) {
+        pollfd ready{connection.socket, POLLIN, 0};
+        if (poll(&ready, 1, config.server().header_timeout_seconds * 1000) <= 0) return false;
+      }
+      if (status == HttpRequestReader::Status::Closed) return false;
+
+      Outcome outcome;
+      if (auto probe = answerProbe(connection)) {
+        outcome = *probe;
+      } else {
+        outcome = beginRequest(connection);
+      }
+      if (outcome == Outcome::Parked) {
+        connection.outcome = Outcome::Parked;
+        loop.runUntil([&connection] { return connection.outcome != Outcome::Parked; });
+        outcome = connection.outcome;
+      }
 
-        if (!parseSuccess) break;
-
-        lastActivity = std::chrono::steady_clock::now();
-        requestCount++;
-
-        try {
-          app.handle(context);
-        } catch (const HttpError& e) {
-          context.res
-            .status(e.status())
-            .text(e.what());
-        } catch (const std::exception& e) {
-          context.res
-            .status(Constants::Http_Status::INTERNAL_SERVER_ERROR)
-            .text(Helpers::reasonPhrase(Constants::Http_Status::INTERNAL_SERVER_ERROR));
+      // No loop watches the socket here, so a backlogged response is sent before returning
+      while (!connection.backlog.empty()) {
+        pollfd ready{connection.socket, POLLOUT, 0};
+        if (poll(&ready, 1, config.server().timeout_seconds * 1000) <= 0 ||
+            !HttpWriter::flush(connection.socket, connection.backlog)) {
+          connection.backlog.clear();
+          return false;
         }
+      }
+      return outcome == Outcome::KeepAlive;
+    }
+
+    // Answers a load balancer probe from its pre-serialized bytes, before the
+    // request is parsed; nullopt when the request is not one
+    std::optional<Outcome> answerProbe(Connection& connection) {
+      if (!health || connection.reader.failure()) return std::nullopt;
+
+      bool close = false;
+      bool lastRequest = connection.requestCount + 1 >= config.server().max_keep_alive_requests;
+      const std::string* probe = health->match(connection.requestHead, lastRequest, close);
+      if (!probe) return std::nullopt;
+
+      connection.requestCount++;
+      bool sent = HttpWriter::writeRaw(connection.socket, *probe, connection.backlog);
+      return sent && !close ? Outcome::KeepAlive : Outcome::Close;
+    }
+
+    // Parses and routes the request the reader gathered, then runs it inline or parks it on
+    // the blocking pool or behind a detached handler; a parked request is
+    // finished by finishRequest() once resume() hands it back
+    Outcome beginRequest(Connection& connection) {
+      const int clientSocket = connection.socket;
+      if (scheduler && Scheduler::current() == scheduler.get()) connection.worker = Scheduler::currentWorker();
+      connection.timed = timed();
+
+      // The previous request's Context is gone, so its arena memory can be reused wholesale
+      connection.context.reset();
+      connection.arena.reset();
+
+      Context& context = connection.context.emplace(connection.arena.resource());
+      context.timing.enable(connection.timed);
+      context.loop_ = &loop;
+
+      // Only an oversized head fails while gathering
+      HttpFailure& failure = connection.reader.failure();
+      bool parseSuccess = !failure;
+      {
+        AllocationTracker::Scope allocationScope(AllocationTracker::Phase::Parse);
+        HttpParser::acceptHead(context, connection.reader);
+
+        parseSuccess = parseSuccess &&
+          HttpParser::parseHead(clientSocket, context, config, connection.requestHead, failure);
+      }
+
+      // Malformed requests are answered without unwinding, then the connection closes
+      if (failure) {
+        context.res
+          .status(failure.status)
+          .text(failure.message);
+
+        size_t bytesOut = writeResponse(connection, context, connection.keepAlive);
+        if (connection.timed) observe(context, connection.clientAddress, connection.requestCount + 1, bytesOut, false);
+        return Outcome::Close;
+      }
+
+      if (!parseSuccess) return Outcome::Close;
+
+      connection.requestCount++;
+
+      if (metrics) metrics->begin();
+
+      Router::MatchResult match = app.resolve(context);
+
+      if (match.endpoint && match.endpoint->blocking) {
+        if (park(connection, std::move(match))) return Outcome::Parked;
+
+        context.res
+          .status(Constants::Http_Status::SERVICE_UNAVAILABLE)
+          .text(Helpers::reasonPhrase(Constants::Http_Status::SERVICE_UNAVAILABLE));
+        return finishRequest(connection);
+      }
+
+      runApp(context, match);
+      if (holdDetached(connection)) return Outcome::Parked;
+      return finishRequest(connection);
+    }
+
+    WorkerPool& blocking() {
+      std::call_once(blockingPoolStarted, [this] {
+        blockingPool = std::make_unique<WorkerPool>(
+          config.server().blocking_threads,
+          config.server().blocking_queue_depth
+        );
+      });
+      return *blockingPool;
+    }
+
+    // Apart from blocking(), so open event streams never starve blocking routes
+    WorkerPool& streaming() {
+      std::call_once(streamPoolStarted, [this] {
+        streamPool = std::make_unique<WorkerPool>(
+          config.server().stream_threads,
+          config.server().stream_queue_depth
+        );
+      });
+      return *streamPool;
+    }
+
+    // Queues the request on the blocking pool; false when the pool's queue is full
+    bool park(Connection& connection, Router::MatchResult match) {
+      return blocking().trySubmit([this, &connection, match = std::move(match)] {
+        runApp(*connection.context, match);
+        if (!holdDetached(connection)) resume(connection);
+      });
+    }
+
+    // Keeps a request parked after its handler detached, until Context::complete();
+    // the handler's start step runs on the event loop once the chain has unwound
+    bool holdDetached(Connection& connection) {
+      Context& context = *connection.context;
+      if (!context.detached()) return false;
+
+      // Queued ahead of park(), so it reaches the loop before anything resume() posts;
+      // once parked, the Context may be gone before this thread touches it again
+      loop.post([this, &connection] { watchParked(connection); });
+      auto start = std::move(context.start_);
+      if (!context.park([this, &connection] { resume(connection); })) return false;
+
+      if (start) loop.post(std::move(start));
+      return true;
+    }
 
-        keepAlive = shouldKeepAlive(context, requestCount, maxRequestsPerConnection);
-        
-        HttpWriter::write(clientSocket, context, keepAlive);
-        
-        if (!keepAlive) {
-          connectionOpen = false;
+    // On the I/O thread: puts a parked request under detached_timeout_seconds and
+    // watches for its client hanging up. The settle() that ends the request undoes both
+    void watchParked(Connection& connection) {
+      // Completed while its handler unwound, and already written on the I/O thread
+      if (connection.context->async_.load(std::memory_order_acquire) == Context::AsyncState::Completed) return;
+
+      connection.parked = true;
+      if (config.server().detached_timeout_seconds > 0) {
+        loop.wheel().arm(connection.deadline, std::chrono::seconds(config.server().detached_timeout_seconds));
+      }
+      // No EPOLLRDHUP: a client may shut down its sending side and still read
+      // the response, so only a hang-up or error, which epoll always reports, drops it
+      loop.modify(connection.socket, EPOLLONESHOT);
+    }
+
+    // On the I/O thread, when a parked request outlives its deadline or its
+    // client hangs up: unless complete() got there first, the request is taken
+    // from its handler and answered 504, or just closed if the client is gone
+    void takeParked(Connection& connection, bool hungUp) {
+      Context& context = *connection.context;
+      auto takeover = context.takeOver([this, &connection] {
+        loop.post([this, &connection] { settle(connection, Outcome::Close); });
+      });
+
+      switch (takeover) {
+        case Context::Takeover::Lost:
+          return;
+
+        case Context::Takeover::Pending:
+          // Still unwinding on its worker; looked at again shortly
+          loop.wheel().arm(connection.deadline, std::chrono::seconds(1));
+          return;
+
+        case Context::Takeover::Owned:
+          if (hungUp) {
+            settle(connection, Outcome::Close);
+            return;
+          }
+          context.finish_ = [](Context& c) {
+            c.res
+              .status(Constants::Http_Status::GATEWAY_TIMEOUT)
+              .text(Helpers::reasonPhrase(Constants::Http_Status::GATEWAY_TIMEOUT));
+          };
+          resume(connection);
+          return;
+
+        case Context::Takeover::Held:
+          // The handler still has the Context, so the answer bypasses it and the
+          // connection stays in the table until complete() lets go
+          loop.wheel().cancel(connection.deadline);
+          loop.unwatch(connection.socket);
+          if (!hungUp) {
+            static const std::string timeout =
+              "HTTP/1.1 504 Gateway Timeout\r\nContent-Type: text/plain\r\nContent-Length: 15\r\n"
+              "Connection: close\r\n\r\nGateway Timeout";
+            HttpWriter::writeRaw(connection.socket, timeout, 0);
+          }
+          shutdown(connection.socket, SHUT_RDWR);
+          return;
+      }
+    }
+
+    // Hands a parked request back to be written: on the worker that parsed it
+    // when there is a scheduler, otherwise on the I/O thread
+    void resume(Connection& connection) {
+      if (scheduler) {
+        scheduler->post(connection.worker, [this, &connection] {
+          release(connection, finishRequest(connection));
+        });
+      } else {
+        loop.post([this, &connection] { settle(connection, finishRequest(connection)); });
+      }
+    }
+
+    void runApp(Context& context, const Router::MatchResult& match) {
+      guard(context, [&] { app.dispatch(context, match); });
+    }
+
+    // Turns an exception escaping `step` into an error response; a request the
+    // handler detached before throwing is completed with it
+    template <typename Step>
+    void guard(Context& context, Step&& step) {
+      try {
+        step();
+      } catch (const HttpError& e) {
+        context.res
+          .status(e.status())
+          .text(e.what());
+        context.abandon();
+      } catch (const std::exception& e) {
+        context.res
+          .status(Constants::Http_Status::INTERNAL_SERVER_ERROR)
+          .text(Helpers::reasonPhrase(Constants::Http_Status::INTERNAL_SERVER_ERROR));
+        context.abandon();
+      }
+    }
+
+    // Writes the response of a request that has been handled; back on the I/O thread
+    Outcome finishRequest(Connection& connection) {
+      Context& context = *connection.context;
+
+      // The response step a Deferred was resolved with
+      if (context.finish_) {
+        auto finish = std::move(context.finish_);
+        context.finish_ = nullptr;
+        guard(context, [&] { finish(context); });
+      }
+      for (auto& step : context.completion_) guard(context, [&] { step(context); });
+
+      connection.keepAlive = shouldKeepAlive(context, connection.requestCount, config.server().max_keep_alive_requests);
+
+      // Any other body is written without waiting, but a long-lived stream's
+      // writer waits between chunks, so it gets a thread of its own
+      const auto* stream = std::get_if<Stream>(&context.res.getBody());
+      if (stream && stream->longLived) {
+        bool queued = streaming().trySubmit([this, &connection] {
+          Outcome outcome = writeFinished(connection);
+          loop.post([this, &connection, outcome] { settle(connection, outcome); });
+        });
+        if (queued) return Outcome::Parked;
+
+        // The pool is saturated: the stream's framing headers go with its body
+        context.res.removeHeader(Constants::Http_Header::CONTENT_LENGTH);
+        context.res.removeHeader(Constants::Http_Header::TRANSFER_ENCODING);
+        context.res
+          .status(Constants::Http_Status::SERVICE_UNAVAILABLE)
+          .text(Helpers::reasonPhrase(Constants::Http_Status::SERVICE_UNAVAILABLE));
+      }
+
+      return writeFinished(connection);
+    }
+
+    Outcome writeFinished(Connection& connection) {
+      Context& context = *connection.context;
+
+      size_t bytesOut = writeResponse(connection, context, connection.keepAlive);
+      if (connection.timed) observe(context, connection.clientAddress, connection.requestCount, bytesOut, true);
+
+      return connection.keepAlive ? Outcome::KeepAlive : Outcome::Close;
+    }
+
+    size_t writeResponse(Connection& connection, Context& context, bool keepAlive) {
+      Timing& timing = context.timing;
+
+      if (config.server().server_timing) {
+        context.res.header("Server-Timing", timing.serverTiming());
+      }
+
+      AllocationTracker::Scope allocationScope(AllocationTracker::Phase::Write);
+
+      auto start = timing.now();
+      size_t bytesOut = HttpWriter::write(connection.socket, context, keepAlive, config, connection.responseHead, connection.backlog);
+      timing.add(Timing::Phase::Write, start, timing.now());
+
+      if (AllocationTracker::enabled()) AllocationTracker::requestCompleted();
+      return bytesOut;
+    }
+
+    // Feeds the access log and metrics; `began` is false for requests rejected by the parser
+    void observe(
+      const Context& context,
+      const sockaddr_storage& clientAddress,
+      size_t requestIndex,
+      size_t bytesOut,
+      bool began
+    ) {
+      using Phase = Timing::Phase;
+      const Timing& timing = context.timing;
+
+      auto micros = [](Clock::duration elapsed) {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+      };
+
+      if (metrics) {
+        // A request rejected while reading headers has no spans before the write
+        Clock::time_point completedAt = Clock::now();
+        Clock::time_point receivedAt = timing.size() > 0 ? timing.start() : completedAt;
+        uint64_t durationMicros = micros(completedAt - receivedAt);
+
+        if (began) {
+          metrics->end(context.req.getMethod(), context.req.route(), context.res.getStatus(),
+                       context.req.getBytesReceived(), bytesOut, durationMicros);
+        } else {
+          metrics->record(context.req.getMethod(), context.req.route(), context.res.getStatus(),
+                          context.req.getBytesReceived(), bytesOut, durationMicros);
         }
       }
+
+      if (!accessLog) return;
+
+      AccessLog::Record record{};
+      record.timestamp_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch()
+        ).count()
+      );
+      record.bytes_in = context.req.getBytesReceived();
+      record.bytes_out = bytesOut;
+      record.parse_us = micros(
+        timing.duration(Phase::HeaderRead) + timing.duration(Phase::Parse) +
+        timing.duration(Phase::BodyRead) + timing.duration(Phase::BodyDecode)
+      );
+      record.handler_us = micros(
+        timing.duration(Phase::Middleware) + timing.duration(Phase::RouteMatch) + timing.duration(Phase::Handler)
+      );
+      record.write_us = micros(timing.duration(Phase::Write));
+      record.request_index = static_cast<uint32_t>(requestIndex);
+      record.status = static_cast<uint16_t>(context.res.getStatus());
+      record.setClient(clientAddress);
+      record.setMethod(context.req.getMethod());
+      record.setPath(context.req.getPath());
+
+      accessLog->record(record);
     }
 
     bool shouldKeepAlive(const Context& context, size_t requestCount, size_t maxRequests) {
@@ -183,7 +787,7 @@ namespace Metro {
         return false;
       }
 
-      auto connHeader = context.req.header(Constants::Http_Header::CONNECTION);
+      auto connHeader = context.req.header(HeaderMap::Known::Connection);
       const std::string& version = context.req.getHttpVersion();
 
       if (version == "1.1") {
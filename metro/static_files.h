@@ -0,0 +1,140 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "context.h"
+#include "constants.h"
+#include "helpers.h"
+#include "file_cache.h"
+#include "http/http_error.h"
+
+namespace Metro {
+
+  /**
+   * Handler serving files below a root directory, mounted with App::serveStatic.
+   *
+   * The request path is taken from the route's "*path" wildcard and normalized
+   * with Helpers::PathSanitizer, so ".." can never escape the root. When the
+   * file exists and the client accepts it, a precompressed sibling (file.br,
+   * file.zst, file.gz) is served as-is with the matching Content-Encoding;
+   * nothing is compressed at request time. All lookups, including misses, go through FileCache.
+   */
+  class StaticFiles {
+    public:
+    struct Options {
+      std::string index        = "index.html";
+      std::string cacheControl = "";
+      bool precompressed       = true;
+    };
+
+    explicit StaticFiles(std::string root)
+      : StaticFiles(std::move(root), Options()) {}
+
+    StaticFiles(std::string root, Options options)
+      : root_(std::move(root)), options_(std::move(options)) {
+      while (root_.size() > 1 && root_.back() == '/') root_.pop_back();
+    }
+
+    void operator()(Context& context) const {
+      std::string relative = Helpers::PathSanitizer::resolveDecoded(context.req.params("path"));
+      if (relative.empty()) {
+        context.res
+          .status(Constants::Http_Status::BAD_REQUEST)
+          .text(Helpers::reasonPhrase(Constants::Http_Status::BAD_REQUEST));
+        return;
+      }
+
+      std::string path = root_ + relative;
+      if (relative == "/") path += options_.index;
+
+      auto& cache = FileCache::shared();
+      auto identity = cache.open(path);
+
+      if (!identity && relative != "/" && !options_.index.empty()) {
+        auto index = cache.open(path + "/" + options_.index);
+        if (index) {
+          path += "/" + options_.index;
+          identity = std::move(index);
+        }
+      }
+
+      // A sibling is only an encoding of a file that exists, never a resource of its own
+      if (!identity) {
+        context.res
+          .status(Constants::Http_Status::NOT_FOUND)
+          .text(Helpers::reasonPhrase(Constants::Http_Status::NOT_FOUND));
+        return;
+      }
+
+      FileCache::EntryPtr selected = identity;
+      const char* encoding = nullptr;
+
+      if (options_.precompressed) {
+        context.res.header("Vary", "Accept-Encoding");
+
+        auto acceptEncoding = context.req.header(Constants::Http_Header::ACCEPT_ENCODING);
+        if (acceptEncoding) {
+          for (const auto& variant : variants()) {
+            if (!Helpers::acceptsEncoding(*acceptEncoding, variant.coding)) continue;
+
+            auto compressed = cache.open(path + variant.extension);
+            if (compressed) {
+              selected = compressed;
+              encoding = variant.coding;
+              break;
+            }
+          }
+        }
+      }
+
+      if (!options_.cacheControl.empty()) {
+        context.res.header("Cache-Control", options_.cacheControl);
+      }
+
+      if (isNotModified(context, *selected)) {
+        context.res
+          .status(Constants::Http_Status::NOT_MODIFIED)
+          .header("ETag", selected->etag)
+          .header("Last-Modified", selected->lastModified);
+        return;
+      }
+
+      if (encoding) {
+        context.res.header("Content-Encoding", encoding);
+      }
+
+      // The variant is typed after the original resource, not its .gz/.br suffix
+      context.res.file(selected, Helpers::mimeType(path));
+    }
+
+    private:
+    struct Variant {
+      const char* coding;
+      const char* extension;
+    };
+
+    std::string root_;
+    Options options_;
+
+    // Server preference when several codings are acceptable
+    static const std::vector<Variant>& variants() {
+      static const std::vector<Variant> list = {
+        {"br",   ".br"},
+        {"zstd", ".zst"},
+        {"gzip", ".gz"},
+      };
+      return list;
+    }
+
+    static bool isNotModified(const Context& context, const FileCache::Entry& entry) {
+      auto ifNoneMatch = context.req.header(Constants::Http_Header::IF_NONE_MATCH);
+      if (ifNoneMatch) {
+        return *ifNoneMatch == "*" || ifNoneMatch->find(entry.etag) != std::string::npos;
+      }
+
+      auto ifModifiedSince = context.req.header(Constants::Http_Header::IF_MODIFIED_SINCE);
+      return ifModifiedSince && *ifModifiedSince == entry.lastModified;
+    }
+  };
+}
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <system_error>
+
+#include "metro.h"
+#include "config.h"
+#include "server.h"
+#include "types.h"
+
+namespace Metro {
+  using namespace Types;
+
+  /**
+   * Drives an App through the real HttpParser -> App -> HttpWriter path
+   * without a TCP port.
+   *
+   * Requests travel over an AF_UNIX socketpair and are served synchronously
+   * on the calling thread, so tests and benchmarks are deterministic and need
+   * no server thread. Keep-alive is honoured: consecutive requests share one
+   * connection until the server closes it, then a fresh pair is opened.
+   *
+   * Each send() carries one request, or several complete pipelined ones, and
+   * requests and responses must each fit in the socket buffers (a few hundred
+   * KiB); use a real Server for larger payloads.
+   *
+   *   TestClient client(app);
+   *   auto result = client.get("/users/42");
+   *   assert(result.status == 200);
+   */
+  class TestClient {
+    public:
+    struct Result {
+      int status = 0;
+      HeaderMap headers;
+      std::string body;   // de-chunked
+      std::string raw;    // bytes exactly as written by HttpWriter
+
+      std::optional<std::string> header(const std::string& key) const {
+        if (auto value = headers.get(key)) return std::string(*value);
+        return std::nullopt;
+      }
+    };
+
+    explicit TestClient(App& app) : TestClient(app, Config()) {}
+    TestClient(App& app, Config config) : server_(app, 0, std::move(config)) {}
+
+    ~TestClient() { disconnect(); }
+
+    TestClient(const TestClient&) = delete;
+    TestClient& operator=(const TestClient&) = delete;
+
+    // Attach an access log or metrics here, as with a listening server
+    Server& server() { return server_; }
+
+    // Sends raw HTTP/1.x request bytes and returns the raw response bytes
+    std::string send(const std::string& request) {
+      if (!connection_) connect();
+
+      writeAll(request);
+      bool open = server_.serveRequest(*connection_);
+      // Further requests pipelined in the same bytes are answered in order
+      while (open && connection_->reader.pipelined(connection_->requestHead)) {
+        open = server_.serveRequest(*connection_);
+      }
+      std::string response = readAvailable();
+
+      if (!open) disconnect();
+      return response;
+    }
+
+    Result request(
+      const std::string& method,
+      const std::string& path,
+      const std::string& body = "",
+      const HeaderMap& headers = {}
+    ) {
+      std::string request = method + " " + path + " HTTP/1.1\r\nHost: localhost\r\n";
+      for (const auto& [key, value] : headers) {
+        request.append(key).append(": ").append(value).append("\r\n");
+      }
+      if (!body.empty() && !headers.contains(HeaderMap::Known::ContentLength)) {
+        request += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+      }
+      request += "\r\n";
+      request += body;
+
+      return parse(send(request));
+    }
+
+    Result get(const std::string& path, const HeaderMap& headers = {}) {
+      return request(Constants::Http_Method::GET, path, "", headers);
+    }
+
+    Result post(const std::string& path, const std::string& body, const std::string& contentType = "text/plain") {
+      return request(Constants::Http_Method::POST, path, body, {{"Content-Type", contentType}});
+    }
+
+    // Splits a raw response into status, headers and (de-chunked) body
+    static Result parse(const std::string& raw) {
+      Result result;
+      result.raw = raw;
+
+      size_t headerEnd = raw.find("\r\n\r\n");
+      if (raw.size() < 12 || headerEnd == std::string::npos) return result;
+
+      result.status = std::atoi(raw.c_str() + 9);
+
+      size_t lineStart = raw.find("\r\n") + 2;
+      while (lineStart < headerEnd) {
+        size_t lineEnd = raw.find("\r\n", lineStart);
+        size_t colon = raw.find(':', lineStart);
+        if (colon != std::string::npos && colon < lineEnd) {
+          size_t valueStart = raw.find_first_not_of(' ', colon + 1);
+          result.headers.set(
+            std::string_view(raw).substr(lineStart, colon - lineStart),
+            std::string_view(raw).substr(valueStart, lineEnd - valueStart)
+          );
+        }
+        lineStart = lineEnd + 2;
+      }
+
+      std::string body = raw.substr(headerEnd + 4);
+      auto encoding = result.header(Constants::Http_Header::TRANSFER_ENCODING);
+      result.body = encoding && *encoding == "chunked" ? dechunk(body) : std::move(body);
+      return result;
+    }
+
+    private:
+    Server server_;
+    int client_ = -1;
+    int serverSide_ = -1;
+    std::optional<Server::Connection> connection_;
+
+    void connect() {
+      int fds[2];
+      if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        throw std::system_error(
+          std::error_code(errno, std::system_category()),
+          "Failed to create socketpair"
+        );
+      }
+      client_ = fds[0];
+      serverSide_ = fds[1];
+
+      int size = 4 * 1024 * 1024;
+      for (int fd : fds) {
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+      }
+      Server::setNonBlocking(serverSide_);
+
+      // Loopback peer so access logs and metrics see a sensible client address
+      sockaddr_storage address{};
+      auto& loopback = reinterpret_cast<sockaddr_in&>(address);
+      loopback.sin_family = AF_INET;
+      loopback.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+      connection_.emplace(serverSide_, address);
+      connection_->deadline.callback = [this] { server_.expire(*connection_); };
+    }
+
+    void disconnect() {
+      connection_.reset();
+      if (client_ >= 0) close(client_);
+      if (serverSide_ >= 0) close(serverSide_);
+      client_ = serverSide_ = -1;
+    }
+
+    void writeAll(const std::string& bytes) {
+      size_t offset = 0;
+      while (offset < bytes.size()) {
+        ssize_t written = ::send(client_, bytes.data() + offset, bytes.size() - offset, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) {
+          throw std::system_error(
+            std::error_code(errno, std::system_category()),
+            "Failed to write test request"
+          );
+        }
+        offset += static_cast<size_t>(written);
+      }
+    }
+
+    // The response is complete once serveRequest() returns, so never block here
+    std::string readAvailable() {
+      std::string response;
+      char buffer[16384];
+      while (true) {
+        ssize_t got = recv(client_, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+        response.append(buffer, static_cast<size_t>(got));
+      }
+      return response;
+    }
+
+    static std::string dechunk(const std::string& body) {
+      std::string out;
+      size_t position = 0;
+      while (position < body.size()) {
+        size_t lineEnd = body.find("\r\n", position);
+        if (lineEnd == std::string::npos) break;
+
+        size_t length = std::strtoull(body.c_str() + position, nullptr, 16);
+        if (length == 0) break;
+
+        out.append(body, lineEnd + 2, length);
+        position = lineEnd + 2 + length + 2;
+      }
+      return out;
+    }
+  };
+}
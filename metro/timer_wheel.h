@@ -0,0 +1,209 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+namespace Metro {
+
+  /**
+   * Hierarchical timing wheel (Varghese and Lauck, "Hashed and Hierarchical
+   * Timing Wheels", 1987) for deadlines that are armed and cancelled far more
+   * often than they fire, such as per-connection read and idle timeouts.
+   *
+   * Entries are intrusive list nodes that live inside their owner, so arm()
+   * and cancel() are a few pointer writes: no allocation, no syscall, no
+   * heap reordering. Level 0 has 256 slots of one tick each; every further
+   * level has 64 slots covering 64 times the span of the one below, and its
+   * entries cascade down as the wheel turns. With the default 10 ms tick
+   * that reaches about 2.5 s, 2.7 min, 2.9 h and 7.8 days. Entries fire
+   * within one tick of their deadline, never before it.
+   * Deadlines beyond the horizon are clamped to it.
+   *
+   * Not thread-safe: the EventLoop that owns a wheel drives it from its thread.
+   */
+  class TimerWheel {
+    public:
+    using Clock = std::chrono::steady_clock;
+
+    class Entry;
+
+    private:
+    struct Link {
+      Link* prev = this;
+      Link* next = this;
+
+      bool empty() const noexcept { return next == this; }
+    };
+
+    public:
+    // Embedded in its owner; `callback` is set once and runs on every expiry
+    class Entry : private Link {
+      public:
+      std::function<void()> callback;
+
+      Entry() : Link{nullptr, nullptr} {}
+      ~Entry() { if (wheel_) wheel_->cancel(*this); }
+
+      Entry(const Entry&) = delete;
+      Entry& operator=(const Entry&) = delete;
+
+      bool armed() const noexcept { return wheel_ != nullptr; }
+
+      private:
+      friend class TimerWheel;
+      TimerWheel* wheel_ = nullptr;
+      uint64_t expires_ = 0;
+    };
+
+    explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds(10), Clock::time_point now = Clock::now())
+      : tick_(tick), origin_(now) {}
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // (Re)arms `entry` to fire once `timeout` has passed
+    void arm(Entry& entry, Clock::duration timeout, Clock::time_point now = Clock::now()) {
+      cancel(entry);
+
+      // Rounded up so an entry never fires early
+      uint64_t ticks = static_cast<uint64_t>((now - origin_ + timeout + tick_ - Clock::duration(1)) / tick_);
+      entry.expires_ = ticks > current_ ? ticks : current_;
+      entry.wheel_ = this;
+      place(entry);
+      ++size_;
+    }
+
+    void cancel(Entry& entry) noexcept {
+      if (!entry.wheel_) return;
+      unlink(entry);
+      entry.wheel_ = nullptr;
+      --size_;
+    }
+
+    // Fires every entry due by `now`, in deadline order tick by tick
+    void advance(Clock::time_point now = Clock::now()) {
+      uint64_t target = static_cast<uint64_t>((now - origin_) / tick_);
+
+      // Nothing to visit on the way, so jump instead of turning the wheel tick by tick
+      if (size_ == 0) {
+        if (target >= current_) current_ = target + 1;
+        return;
+      }
+
+      while (current_ <= target) {
+        size_t index = current_ & LEVEL0_MASK;
+        if (index == 0) cascadeFrom(1);
+
+        Link due;
+        splice(level0_[index], due);
+        ++current_;
+
+        while (!due.empty()) {
+          Entry& entry = static_cast<Entry&>(*due.next);
+          unlink(entry);
+          entry.wheel_ = nullptr;
+          --size_;
+
+          // A copy, since the callback may destroy the entry's owner
+          std::function<void()> callback = entry.callback;
+          callback();
+        }
+      }
+    }
+
+    // Milliseconds until the wheel next needs advance(); -1 when it is empty
+    int timeoutMs(Clock::time_point now = Clock::now()) const {
+      if (size_ == 0) return -1;
+
+      // The nearest occupied level-0 slot, or the next cascade if level 0 is empty
+      uint64_t next = current_ + (LEVEL0_SLOTS - (current_ & LEVEL0_MASK));
+      for (uint64_t tick = current_; tick < next; ++tick) {
+        if (!level0_[tick & LEVEL0_MASK].empty()) {
+          next = tick;
+          break;
+        }
+      }
+
+      auto wait = std::chrono::ceil<std::chrono::milliseconds>(origin_ + tick_ * static_cast<int64_t>(next) - now);
+      return wait.count() > 0 ? static_cast<int>(wait.count()) : 0;
+    }
+
+    size_t size() const noexcept { return size_; }
+
+    private:
+    static constexpr unsigned LEVEL0_BITS = 8;
+    static constexpr unsigned LEVEL_BITS = 6;
+    static constexpr unsigned LEVELS = 4;
+    static constexpr size_t LEVEL0_SLOTS = size_t(1) << LEVEL0_BITS;
+    static constexpr size_t LEVEL_SLOTS = size_t(1) << LEVEL_BITS;
+    static constexpr uint64_t LEVEL0_MASK = LEVEL0_SLOTS - 1;
+    static constexpr uint64_t LEVEL_MASK = LEVEL_SLOTS - 1;
+
+    Clock::duration tick_;
+    Clock::time_point origin_;
+    uint64_t current_ = 0;    // next tick to run
+    size_t size_ = 0;
+
+    std::array<Link, LEVEL0_SLOTS> level0_;
+    std::array<std::array<Link, LEVEL_SLOTS>, LEVELS - 1> levels_;
+
+    static unsigned shift(unsigned level) { return LEVEL0_BITS + (level - 1) * LEVEL_BITS; }
+
+    void place(Entry& entry) {
+      uint64_t delta = entry.expires_ - current_;
+      Link* slot;
+
+      if (delta < LEVEL0_SLOTS) {
+        slot = &level0_[entry.expires_ & LEVEL0_MASK];
+      } else {
+        unsigned level = 1;
+        while (level < LEVELS - 1 && delta >= (uint64_t(1) << shift(level + 1))) ++level;
+
+        // Beyond the last level: clamped to the wheel's horizon
+        if (delta >= (uint64_t(1) << (shift(LEVELS - 1) + LEVEL_BITS))) {
+          entry.expires_ = current_ + (uint64_t(1) << (shift(LEVELS - 1) + LEVEL_BITS)) - 1;
+        }
+        slot = &levels_[level - 1][(entry.expires_ >> shift(level)) & LEVEL_MASK];
+      }
+
+      entry.prev = slot->prev;
+      entry.next = slot;
+      slot->prev->next = &entry;
+      slot->prev = &entry;
+    }
+
+    // Level 0 wrapped: moves the current slot of `level` down, wrapping further levels first
+    void cascadeFrom(unsigned level) {
+      if (level >= LEVELS) return;
+
+      size_t index = (current_ >> shift(level)) & LEVEL_MASK;
+      if (index == 0) cascadeFrom(level + 1);
+
+      Link moving;
+      splice(levels_[level - 1][index], moving);
+      while (!moving.empty()) {
+        Entry& entry = static_cast<Entry&>(*moving.next);
+        unlink(entry);
+        place(entry);
+      }
+    }
+
+    static void unlink(Link& link) noexcept {
+      link.prev->next = link.next;
+      link.next->prev = link.prev;
+      link.prev = link.next = nullptr;
+    }
+
+    // Moves every node of `from` onto the empty list `to`
+    static void splice(Link& from, Link& to) noexcept {
+      if (from.empty()) return;
+      to.next = from.next;
+      to.prev = from.prev;
+      to.next->prev = &to;
+      to.prev->next = &to;
+      from.next = from.prev = &from;
+    }
+  };
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace Metro {
+
+  /**
+   * Per-request phase timestamps, from the first request byte to the last
+   * response byte.
+   *
+   * The server enables timing only when something consumes it (access log,
+   * metrics or the Server-Timing header); while disabled now() returns an
+   * empty time point and add() is a no-op, so no clock is read. Spans live in
+   * a fixed array inside the Context and never allocate.
+   */
+  class Timing {
+    public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Phase : uint8_t {
+      HeaderRead,     // first byte until the blank line ending the headers
+      Parse,          // request line and header fields
+      BodyRead,       // body bytes beyond the header buffer
+      BodyDecode,     // JSON / form / text decoding
+      RouteMatch,
+      Middleware,     // one span per middleware, `index` is its position
+      Handler,
+      Write,
+    };
+
+    struct Span {
+      Phase phase;
+      uint16_t index;
+      Clock::time_point start;
+      Clock::time_point end;
+
+      Clock::duration duration() const { return end - start; }
+    };
+
+    static constexpr size_t MAX_SPANS = 32;
+
+    bool enabled() const noexcept { return enabled_; }
+    void enable(bool on = true) noexcept { enabled_ = on; }
+
+    Clock::time_point now() const { return enabled_ ? Clock::now() : Clock::time_point(); }
+
+    void add(Phase phase, Clock::time_point start, Clock::time_point end, uint16_t index = 0) {
+      if (!enabled_ || count_ == MAX_SPANS) return;
+      spans_[count_++] = Span{phase, index, start, end};
+    }
+
+    const Span* begin() const noexcept { return spans_.data(); }
+    const Span* end() const noexcept { return spans_.data() + count_; }
+    size_t size() const noexcept { return count_; }
+
+    // Start of the first recorded span (the first request byte), or an empty time point
+    Clock::time_point start() const noexcept {
+      return count_ > 0 ? spans_[0].start : Clock::time_point();
+    }
+
+    // Time spent in `phase`; middleware spans count only their own work, not what ran inside next()
+    Clock::duration duration(Phase phase) const {
+      Clock::duration total{};
+      for (size_t i = 0; i < count_; ++i) {
+        if (spans_[i].phase == phase) total += selfDuration(spans_[i]);
+      }
+      return total;
+    }
+
+    Clock::duration selfDuration(const Span& span) const {
+      if (span.phase != Phase::Middleware) return span.duration();
+
+      // Nested work is the next middleware, or routing and the handler after the last one
+      Clock::duration inner{};
+      bool nextMiddleware = false;
+      for (size_t i = 0; i < count_; ++i) {
+        if (spans_[i].phase == Phase::Middleware && spans_[i].index == span.index + 1) {
+          inner += spans_[i].duration();
+          nextMiddleware = true;
+        }
+      }
+      if (!nextMiddleware) {
+        for (size_t i = 0; i < count_; ++i) {
+          if (spans_[i].phase == Phase::RouteMatch || spans_[i].phase == Phase::Handler) {
+            if (spans_[i].start >= span.start && spans_[i].end <= span.end) inner += spans_[i].duration();
+          }
+        }
+      }
+      return span.duration() - inner;
+    }
+
+    // Server-Timing header value: "hdr;dur=0.012, parse;dur=0.004, mw0;dur=0.030, ..." (milliseconds)
+    std::string serverTiming() const {
+      std::string out;
+      char entry[48];
+      for (size_t i = 0; i < count_; ++i) {
+        const Span& span = spans_[i];
+        if (span.phase == Phase::Write) continue; // still in progress when headers are built
+
+        double ms = std::chrono::duration<double, std::milli>(selfDuration(span)).count();
+        int length = span.phase == Phase::Middleware
+          ? std::snprintf(entry, sizeof(entry), "%smw%u;dur=%.3f", out.empty() ? "" : ", ", span.index, ms)
+          : std::snprintf(entry, sizeof(entry), "%s%s;dur=%.3f", out.empty() ? "" : ", ", name(span.phase), ms);
+        out.append(entry, static_cast<size_t>(length));
+      }
+      return out;
+    }
+
+    static const char* name(Phase phase) {
+      switch (phase) {
+        case Phase::HeaderRead: return "hdr";
+        case Phase::Parse:      return "parse";
+        case Phase::BodyRead:   return "body";
+        case Phase::BodyDecode: return "decode";
+        case Phase::RouteMatch: return "route";
+        case Phase::Middleware: return "mw";
+        case Phase::Handler:    return "handler";
+        case Phase::Write:      return "write";
+      }
+      return "unknown";
+    }
+
+    private:
+    bool enabled_ = false;
+    size_t count_ = 0;
+    std::array<Span, MAX_SPANS> spans_;
+  };
+}
@@ -3,6 +3,11 @@
 #include <functional>
 #include <variant>
 #include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <sys/types.h>
 
 #include "context.h"
 #include "../lib/json.hpp"
@@ -13,8 +18,49 @@ namespace Metro {
 
 namespace Metro {
   namespace Types {
-    using Next        = std::function<void()>;
-    using Handler     = std::function<void(Context&)>;
+    // Continuation handed to middleware; calling it runs the rest of the chain.
+    // Three words copied by value with no allocation, so it is only valid
+    // while the middleware that received it is running
+    class Next {
+      public:
+      using Step = void (*)(void* chain, Context& context, size_t index);
+
+      Next(Step step, void* chain, Context& context, size_t index)
+        : step_(step), chain_(chain), context_(&context), index_(index) {}
+
+      void operator()() const { step_(chain_, *context_, index_); }
+
+      private:
+      Step step_;
+      void* chain_;
+      Context* context_;
+      size_t index_;
+    };
+
+    // Turns a callable into a handler according to what it returns. Results are
+    // ignored; coroutine.h specializes this so a Task<void> is run to completion
+    template <typename Result>
+    struct HandlerResult {
+      template <typename F>
+      static std::function<void(Context&)> adapt(F&& handler) { return std::forward<F>(handler); }
+    };
+
+    // std::function<void(Context&)> that also takes coroutine handlers
+    class Handler : public std::function<void(Context&)> {
+      public:
+      Handler() = default;
+      Handler(std::nullptr_t) {}
+
+      template <
+        typename F,
+        typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Handler> && std::is_invocable_v<F&, Context&>>
+      >
+      Handler(F&& handler)
+        : std::function<void(Context&)>(
+            HandlerResult<std::invoke_result_t<F&, Context&>>::adapt(std::forward<F>(handler))
+          ) {}
+    };
+
     using Middleware  = std::function<void(Context&, Next)>;
 
     using Text        = std::string;
@@ -23,11 +69,37 @@ namespace Metro {
     using Binary      = std::vector<std::uint8_t>;
 
     struct Stream {
-      using ChunkWriter = std::function<bool(const char* data, size_t len)>;
+      // Destination of stream chunks; implemented by HttpWriter and by body-transforming middleware
+      struct ChunkSink {
+        virtual ~ChunkSink() = default;
+        virtual bool write(const char* data, size_t len) = 0;
+        virtual bool flush() = 0;
+      };
+
+      // Handed to stream writers: write(data, len) queues a chunk, write.flush() forces
+      // everything queued so far (including response headers) onto the socket
+      class ChunkWriter {
+        public:
+        explicit ChunkWriter(ChunkSink& sink) : sink_(&sink) {}
+
+        bool operator()(const char* data, size_t len) const { return sink_->write(data, len); }
+        bool flush() const { return sink_->flush(); }
+
+        private:
+        ChunkSink* sink_;
+      };
+
       using Writer = std::function<bool(ChunkWriter write)>;
+
+      // Pull side of a fixed-length stream: copies up to `len` body bytes from
+      // `offset` into `out` and returns how many, or <= 0 on error. With one
+      // the server sends the body as the client drains it, instead of running `writer`
+      using Reader = std::function<ssize_t(char* out, size_t len, size_t offset)>;
       
       Writer writer;
       size_t contentLength = 0;  // 0 = unknown/chunked encoding
+      Reader reader;             // optional, only with a contentLength
+      bool longLived = false;    // writer waits between chunks (e.g. SSE); it gets its own thread
       
       Stream(Writer w, size_t len = 0) 
         : writer(std::move(w)), contentLength(len) {}
@@ -39,44 +111,25 @@ namespace Metro {
       static Stream sse(std::function<void(std::function<void(const std::string&)> emit)> handler);
     };
 
+    // Borrowed bytes with static storage duration (e.g. embedded assets), written without copying
+    struct StaticBytes {
+      const char* data = nullptr;
+      size_t size = 0;
+    };
+
     using Body = std::variant<
       std::monostate,                   // not parsed / empty
       Text,                             // text/plain, text/html, etc
       Form,                             // application/x-www-form-urlencoded
       Json,                             // application/json
       Binary,                           // images, pdf, octet-stream
-      Stream                            // callback-based streaming
+      Stream,                           // callback-based streaming
+      StaticBytes                       // response-only, never produced by the parser
     >;
 
-    struct CaseInsensitiveHash {
-      size_t operator()(const std::string& key) const noexcept {
-        size_t h = 0;
-        for (unsigned char uc : key) {  
-          if (uc >= 'A' && uc <= 'Z') { uc |= 0x20; }
-          h = h * 131 + uc;
-        }
-        return h;
-      }
-    };
-
-    struct CaseInsensitiveEqual {
-      bool operator()(const std::string& a, const std::string& b) const noexcept {
-        if (a.size() != b.size()) return false;
-        
-        for (size_t i = 0; i < a.size(); ++i) {
-          unsigned char ca = static_cast<unsigned char>(a[i]);
-          unsigned char cb = static_cast<unsigned char>(b[i]);
-          
-          if (ca >= 'A' && ca <= 'Z') ca |= 0x20;
-          if (cb >= 'A' && cb <= 'Z') cb |= 0x20;
-          
-          if (ca != cb) return false;
-        }
-        return true;  
-      }
-    };
-    
-    using Header = std::unordered_map<std::string, std::string, CaseInsensitiveHash, CaseInsensitiveEqual>;
+    // Request-scoped storage backed by the connection's RequestArena; nodes and strings are never freed one by one
+    using ParamStore  = std::pmr::unordered_map<std::pmr::string, std::pmr::string>;
+    using QueryStore  = std::pmr::unordered_map<std::pmr::string, std::pmr::vector<std::pmr::string>>;
   }
 }
 
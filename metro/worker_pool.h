@@ -0,0 +1,87 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Metro {
+
+  /**
+   * Fixed set of threads for work that blocks: handlers on routes marked
+   * blocking, which wait on databases, files or sleeps.
+   *
+   * The queue is bounded. trySubmit() refuses work once `queueDepth` tasks
+   * are waiting, and the server turns a refusal into 503 rather than let
+   * slow routes pile up unbounded memory and latency. Tasks run in
+   * submission order; the destructor finishes queued tasks, then joins.
+   */
+  class WorkerPool {
+    public:
+    using Task = std::function<void()>;
+
+    WorkerPool(size_t threads, size_t queueDepth) : queueDepth_(queueDepth) {
+      if (threads == 0) threads = 1;
+      workers_.reserve(threads);
+      for (size_t i = 0; i < threads; ++i) {
+        workers_.emplace_back([this] { run(); });
+      }
+    }
+
+    ~WorkerPool() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+      }
+      wake_.notify_all();
+      for (auto& worker : workers_) worker.join();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // False when the queue is full; the task is dropped and the caller answers instead
+    bool trySubmit(Task task) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || queue_.size() >= queueDepth_) return false;
+        queue_.push_back(std::move(task));
+      }
+      wake_.notify_one();
+      return true;
+    }
+
+    size_t pending() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return queue_.size();
+    }
+
+    size_t size() const noexcept { return workers_.size(); }
+
+    private:
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Task> queue_;
+    std::vector<std::thread> workers_;
+    const size_t queueDepth_;
+    bool stopping_ = false;
+
+    void run() {
+      while (true) {
+        Task task;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+          if (queue_.empty()) return;
+
+          task = std::move(queue_.front());
+          queue_.pop_front();
+        }
+        task();
+      }
+    }
+  };
+}
@@ -34,10 +34,17 @@ wait_for_port() {
   done
 }
 
+# -----------------------
+# In-process transport (no port)
+# -----------------------
+echo "[TEST] In-process transport"
+"$BIN/transport_test"
+echo
+
 # -----------------------
 # Start all servers
 # -----------------------
-for server in server_404_test server_body_test server_middleware_test server_multi_query_test server_query_test server_sleep_test server_stream_test server_params_test server_content_negotiation_test server_error_test server_middleware_chain_test server_keepalive_test; do
+for server in server_404_test server_body_test server_middleware_test server_multi_query_test server_query_test server_sleep_test server_stream_test server_params_test server_content_negotiation_test server_error_test server_middleware_chain_test server_keepalive_test server_static_test server_embedded_test server_compression_test server_access_log_test server_metrics_test server_workers_test server_coroutine_test; do
   start_server "$server"
 done
 
@@ -56,12 +63,19 @@ wait_for_port 3009
 wait_for_port 3010
 wait_for_port 3011
 wait_for_port 3012
+wait_for_port 3013
+wait_for_port 3014
+wait_for_port 3015
+wait_for_port 3016
+wait_for_port 3017
+wait_for_port 3018
+wait_for_port 3019
 
 echo
 # -----------------------
 # Run curl tests
 # -----------------------
-for server in server_404_test server_body_test server_middleware_test server_multi_query_test server_query_test server_sleep_test server_stream_test server_params_test server_content_negotiation_test server_error_test server_middleware_chain_test server_keepalive_test; do
+for server in server_404_test server_body_test server_middleware_test server_multi_query_test server_query_test server_sleep_test server_stream_test server_params_test server_content_negotiation_test server_error_test server_middleware_chain_test server_keepalive_test server_static_test server_embedded_test server_compression_test server_access_log_test server_metrics_test server_workers_test server_coroutine_test; do
   echo "========== TEST: $server =========="
   echo
   case "$server" in
@@ -248,6 +262,12 @@ for server in server_404_test server_body_test server_middleware_test server_mul
       echo
       echo
 
+      # Test SSE with explicit flush per event
+      echo "[TEST] Server-Sent Events with flush"
+      curl -i --silent --show-error -N --max-time 2 http://127.0.0.1:3007/stream/sse-flush || true
+      echo
+      echo
+
       # Test chunked transfer
       echo "[TEST] Chunked encoding stream"
       curl -i --silent --show-error http://127.0.0.1:3007/stream/chunks
@@ -265,6 +285,19 @@ for server in server_404_test server_body_test server_middleware_test server_mul
       curl -i --silent --show-error http://127.0.0.1:3007/stream/fixed
       echo
       echo
+
+      # More open event streams than blocking threads
+      echo "[TEST] Blocking route and file while 6 event streams stay open (expect 200 200)"
+      (
+        for i in 1 2 3 4 5 6; do
+          curl --silent --show-error -N -o /dev/null --max-time 2 http://127.0.0.1:3007/stream/events &
+        done
+        sleep 0.5
+        curl --silent --show-error -o /dev/null -w "%{http_code} " --max-time 1 http://127.0.0.1:3007/stream/blocking
+        curl --silent --show-error -o /dev/null -w "%{http_code}\n" --max-time 1 http://127.0.0.1:3007/file/test
+        wait
+      ) 2>/dev/null
+      echo
       ;;
 
     # -----------------------
@@ -394,8 +427,226 @@ for server in server_404_test server_body_test server_middleware_test server_mul
       echo
 
       echo "[TEST] Reusing connection (pipelining test)"
-      (echo -e "GET /keepalive-test HTTP/1.1\r\nHost: localhost\r\n\r\nGET /keepalive-test HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n") | nc 127.0.0.1 3012 | head -30
+      (printf 'GET /keepalive-test HTTP/1.1\r\nHost: localhost\r\n\r\nGET /keepalive-test HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n') | nc 127.0.0.1 3012 | head -30
+      echo
+      echo
+
+      echo "[TEST] Deferred response to a half-closed client (expect 200)"
+      printf 'GET /deferred HTTP/1.1\r\nHost: localhost\r\n\r\n' | nc -N 127.0.0.1 3012 | head -1
+      echo
+
+      echo "[TEST] Request head still incomplete after header timeout (expect 408)"
+      (printf 'GET /keepalive-test HTTP/1.1\r\nHost: localhost\r\n'; sleep 3) | nc 127.0.0.1 3012 | head -1
+      echo
+
+      echo "[TEST] Request body short of Content-Length after timeout (expect 408)"
+      (printf 'POST /keepalive-test HTTP/1.1\r\nHost: localhost\r\nContent-Type: text/plain\r\nContent-Length: 10\r\n\r\nabc'; sleep 4) | nc 127.0.0.1 3012 | head -1
       echo
+
+      echo "[TEST] Idle connection closed after keep-alive timeout (expect no output)"
+      sleep 4 | nc 127.0.0.1 3012
+      echo "closed"
+      echo
+      ;;
+
+    # -----------------------
+    # Static file tests
+    # -----------------------
+    server_static_test)
+      echo "[TEST] Directory index"
+      curl -i --silent --show-error http://127.0.0.1:3013/assets/
+      echo
+      echo
+
+      echo "[TEST] Identity file without Accept-Encoding"
+      curl -i --silent --show-error http://127.0.0.1:3013/assets/app.js
+      echo
+      echo
+
+      echo "[TEST] Precompressed gzip sibling (expect Content-Encoding: gzip)"
+      curl -i --silent --show-error -H "Accept-Encoding: br, gzip" http://127.0.0.1:3013/assets/app.js
+      echo
+      echo
+
+      echo "[TEST] Conditional request (expect 304)"
+      ETAG=$(curl -si http://127.0.0.1:3013/assets/app.js | grep -i '^etag:' | head -1 | cut -d' ' -f2 | tr -d '\r')
+      curl -i --silent --show-error -H "If-None-Match: $ETAG" http://127.0.0.1:3013/assets/app.js
+      echo
+      echo
+
+      echo "[TEST] Path traversal (expect 404)"
+      curl -i --silent --show-error --path-as-is http://127.0.0.1:3013/assets/../../etc/passwd
+      echo
+      echo
+
+      echo "[TEST] Percent-encoded file name decoded once (expect 200 literal percent)"
+      curl --silent --show-error -w " %{http_code}" http://127.0.0.1:3013/assets/a%2541.txt
+      echo
+      echo
+
+      echo "[TEST] Precompressed sibling without its identity file (expect 404)"
+      curl -i --silent --show-error -H "Accept-Encoding: gzip" http://127.0.0.1:3013/assets/orphan.js
+      echo
+      echo
+      ;;
+
+    # -----------------------
+    # Embedded asset tests
+    # -----------------------
+    server_embedded_test)
+      echo "[TEST] Embedded index"
+      curl -i --silent --show-error http://127.0.0.1:3014/ui/
+      echo
+      echo
+
+      echo "[TEST] Embedded gzip variant (expect Content-Encoding: gzip)"
+      curl -i --silent --show-error --compressed http://127.0.0.1:3014/ui/css/app.css
+      echo
+      echo
+
+      echo "[TEST] Missing embedded asset (expect 404)"
+      curl -i --silent --show-error http://127.0.0.1:3014/ui/missing.js
+      echo
+      echo
+      ;;
+
+    # -----------------------
+    # Compression tests
+    # -----------------------
+    server_compression_test)
+      echo "[TEST] Gzip JSON body (expect Content-Encoding: gzip)"
+      curl -i --silent --show-error --compressed http://127.0.0.1:3015/json | head -c 400
+      echo
+      echo
+
+      echo "[TEST] Body below threshold (expect no Content-Encoding)"
+      curl -i --silent --show-error --compressed http://127.0.0.1:3015/small
+      echo
+      echo
+
+      echo "[TEST] Binary outside MIME allowlist (expect no Content-Encoding)"
+      curl -i --silent --show-error --compressed http://127.0.0.1:3015/binary | head -c 300
+      echo
+      echo
+
+      echo "[TEST] Compressed stream"
+      curl -i --silent --show-error --compressed -N http://127.0.0.1:3015/stream
+      echo
+      echo
+
+      echo "[TEST] Deferred response compressed on completion (expect Content-Encoding: gzip)"
+      curl --silent --show-error --compressed -D - -o /dev/null http://127.0.0.1:3015/deferred
+      echo
+
+      echo "[TEST] File compressed on the fly (expect a weak ETag only with Content-Encoding)"
+      curl --silent --show-error --compressed -D - -o /dev/null http://127.0.0.1:3015/file | grep -iE "^(etag|content-encoding):"
+      curl --silent --show-error -D - -o /dev/null http://127.0.0.1:3015/file | grep -iE "^(etag|content-encoding):"
+      echo
+      ;;
+
+    # -----------------------
+    # Access log tests
+    # -----------------------
+    server_access_log_test)
+      echo "[TEST] Keep-alive requests recorded with request index"
+      curl --silent --show-error http://127.0.0.1:3016/hello http://127.0.0.1:3016/hello
+      echo
+      curl --silent --show-error -X POST -H "Content-Type: text/plain" --data "ping" http://127.0.0.1:3016/echo
+      echo
+      curl --silent --show-error -o /dev/null http://127.0.0.1:3016/missing
+      curl --silent --show-error -o /dev/null -X 'GE"T' http://127.0.0.1:3016/hello
+      sleep 0.2
+      echo "[TEST] Last access log records (expect NDJSON lines, the last method escaped as GE\\\"T)"
+      tail -n 5 /tmp/metro_access.log
+      echo
+      ;;
+
+    # -----------------------
+    # Metrics tests
+    # -----------------------
+    server_metrics_test)
+      echo "[TEST] Server-Timing header (expect hdr, parse, mw0, route, handler)"
+      curl -i --silent --show-error http://127.0.0.1:3017/users/42
+      echo
+      echo
+      curl --silent --show-error -o /dev/null http://127.0.0.1:3017/users/1
+      curl --silent --show-error -o /dev/null http://127.0.0.1:3017/users/2
+      curl --silent --show-error -o /dev/null http://127.0.0.1:3017/fail
+      curl --silent --show-error -o /dev/null http://127.0.0.1:3017/missing
+      curl --silent --show-error -o /dev/null -X FROB1 http://127.0.0.1:3017/missing
+      curl --silent --show-error -o /dev/null -X FROB2 http://127.0.0.1:3017/missing
+      echo "[TEST] Metrics grouped by route pattern (expect route=\"/users/:id\" count 2, unknown methods as method=\"OTHER\")"
+      curl --silent --show-error http://127.0.0.1:3017/metrics | grep -v "_bucket"
+      echo
+      ;;
+
+    # -----------------------
+    # Work-stealing worker tests
+    # -----------------------
+    server_workers_test)
+      echo "[TEST] Request served on a worker thread"
+      curl -i --silent --show-error http://127.0.0.1:3018/hello
+      echo
+      echo
+
+      echo "[TEST] Fan-out with TaskGroup (expect sum 500500)"
+      curl -i --silent --show-error http://127.0.0.1:3018/fanout/1000
+      echo
+      echo
+
+      echo "[TEST] Liveness probe with worker threads (expect 200 OK)"
+      curl -i --silent --show-error http://127.0.0.1:3018/healthz
+      echo
+      echo
+
+      echo "[TEST] Concurrent keep-alive clients (expect 16 x 200)"
+      (
+        for i in 1 2 3 4 5 6 7 8; do
+          curl --silent --show-error -o /dev/null -o /dev/null -w "%{http_code}\n" http://127.0.0.1:3018/hello http://127.0.0.1:3018/hello &
+        done
+        wait
+      )
+      echo
+      ;;
+
+    server_coroutine_test)
+      echo "[TEST] Coroutine sleeping on a timer"
+      curl -i --silent --show-error http://127.0.0.1:3019/delay/50
+      echo
+      echo
+
+      echo "[TEST] Outbound fetch from a coroutine"
+      curl -i --silent --show-error http://127.0.0.1:3019/proxy
+      echo
+      echo
+
+      echo "[TEST] Outbound fetch past its timeout (expect 504)"
+      curl -i --silent --show-error http://127.0.0.1:3019/proxy-slow
+      echo
+      echo
+
+      echo "[TEST] Outbound fetch past its size limit (expect 502)"
+      curl -i --silent --show-error http://127.0.0.1:3019/proxy-large
+      echo
+      echo
+
+      echo "[TEST] HttpError thrown after a co_await (expect 418)"
+      curl -i --silent --show-error http://127.0.0.1:3019/teapot
+      echo
+      echo
+
+      echo "[TEST] Non-std exception thrown after a co_await (expect 500)"
+      curl -i --silent --show-error http://127.0.0.1:3019/throw-int
+      echo
+      echo
+
+      echo "[TEST] Concurrent sleepers share one thread (expect 20 x 200 in about 300 ms)"
+      (
+        for i in 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20; do
+          curl --silent --show-error -o /dev/null -w "%{http_code}\n" http://127.0.0.1:3019/delay/300 &
+        done
+        wait
+      )
       echo
       ;;
   esac
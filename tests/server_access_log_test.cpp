@@ -0,0 +1,31 @@
+#include <iostream>
+#include <string>
+
+#include "metro.h"
+#include "server.h"
+#include "access_log.h"
+
+int main() {
+    using namespace Metro;
+
+    App app;
+
+    app.get("/hello", [](Context& c) {
+        c.res.text("Hello from the access log test");
+    });
+
+    app.post("/echo", [](Context& c) {
+        c.res.text(c.req.text());
+    });
+
+    // One NDJSON line per request, flushed every 50ms
+    AccessLog::Options options;
+    options.path = "/tmp/metro_access.log";
+    options.flush_interval_ms = 50;
+    options.max_file_size = 64 * 1024;
+    AccessLog accessLog(options);
+
+    Server server(app, 3016);
+    server.setAccessLog(accessLog);
+    server.listen();
+}
@@ -0,0 +1,67 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "metro.h"
+#include "server.h"
+#include "middleware.h"
+#include "compression.h"
+
+int main() {
+    using namespace Metro;
+
+    App app;
+    app.use(Middlewares::logger());
+    app.use(Compression::middleware());
+
+    // Large JSON body (compressed when the client accepts gzip/deflate)
+    app.get("/json", [](Context& c) {
+        Json items = Json::array();
+        for (int i = 0; i < 200; ++i) {
+            items.push_back({{"id", i}, {"name", "item " + std::to_string(i)}, {"active", i % 2 == 0}});
+        }
+        c.res.json({{"items", items}});
+    });
+
+    // Below the size threshold (sent as-is)
+    app.get("/small", [](Context& c) {
+        c.res.text("tiny");
+    });
+
+    // Not in the MIME allowlist (sent as-is)
+    app.get("/binary", [](Context& c) {
+        c.res.body(Binary(4096, 0x42));
+        c.res.header("Content-Type", "application/octet-stream");
+    });
+
+    // Streamed body compressed chunk by chunk
+    app.get("/stream", [](Context& c) {
+        c.res.stream([](auto write) {
+            for (int i = 0; i < 5; ++i) {
+                std::string data = "data: compressed event " + std::to_string(i) + "\n\n";
+                if (!write(data.c_str(), data.length())) return false;
+            }
+            return true;
+        }, 0, "text/event-stream");
+    });
+
+    // Completed after the handler returns; compressed once the response exists
+    app.get("/deferred", [](Context& c) {
+        std::thread([done = c.defer()] {
+            done.resolve([](Context& c) {
+                c.res.text(std::string(4096, 'd'));
+            });
+        }).detach();
+    });
+
+    // File compressed on the fly; its strong ETag must become weak
+    const std::string file = "/tmp/metro_compression_test.txt";
+    std::ofstream(file) << std::string(4096, 'f');
+    app.get("/file", [file](Context& c) {
+        c.res.file(file, "text/plain");
+    });
+
+    Server server(app, 3015);
+    server.listen();
+}
@@ -0,0 +1,59 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "metro.h"
+#include "server.h"
+#include "coroutine.h"
+
+// Built with -std=c++20; see build_tests.sh
+int main() {
+    using namespace Metro;
+
+    App app;
+
+    app.get("/hello", [](Context& c) {
+        c.res.text("Hello from the loop");
+    });
+
+    // Many of these wait at once on the single I/O thread
+    app.get("/delay/:ms", [](Context& c) -> Task<> {
+        long ms = std::stol(c.req.params("ms"));
+        co_await Async::sleep(c.loop(), std::chrono::milliseconds(ms));
+        c.res.text("Slept " + std::to_string(ms) + " ms");
+    });
+
+    // Calls back into this server while the request stays parked
+    app.get("/proxy", [](Context& c) -> Task<> {
+        Async::ClientResponse upstream = co_await Async::fetch(c.loop(), "127.0.0.1", 3019, "GET", "/hello");
+        c.res.status(upstream.status).text("Upstream said: " + upstream.body);
+    });
+
+    // Upstream failures surface as 504 (too slow) or 502 (too large)
+    app.get("/proxy-slow", [](Context& c) -> Task<> {
+        Async::FetchLimits limits;
+        limits.timeout = std::chrono::milliseconds(100);
+        co_await Async::fetch(c.loop(), "127.0.0.1", 3019, "GET", "/delay/1000", "", {}, limits);
+        c.res.text("Upstream answered in time");
+    });
+
+    app.get("/proxy-large", [](Context& c) -> Task<> {
+        Async::FetchLimits limits;
+        limits.max_response_size = 16;
+        co_await Async::fetch(c.loop(), "127.0.0.1", 3019, "GET", "/hello", "", {}, limits);
+        c.res.text("Upstream response fit");
+    });
+
+    app.get("/teapot", [](Context& c) -> Task<> {
+        co_await Async::sleep(c.loop(), std::chrono::milliseconds(10));
+        throw HttpError(418, "I'm a teapot");
+    });
+
+    app.get("/throw-int", [](Context& c) -> Task<> {
+        co_await Async::sleep(c.loop(), std::chrono::milliseconds(10));
+        throw 42;
+    });
+
+    Server server(app, 3019);
+    server.listen();
+}
@@ -0,0 +1,20 @@
+#include <iostream>
+
+#include "metro.h"
+#include "server.h"
+#include "middleware.h"
+
+// Generated from tests/assets by build_tests.sh
+namespace Assets { extern const Metro::EmbeddedBundle test_assets; }
+
+int main() {
+    using namespace Metro;
+
+    App app;
+    app.use(Middlewares::logger());
+
+    app.serveEmbedded("/ui", Assets::test_assets, {"index.html", "public, max-age=31536000"});
+
+    Server server(app, 3014);
+    server.listen();
+}
@@ -1,4 +1,6 @@
+#include <chrono>
 #include <iostream>
+#include <thread>
 #include "metro.h"
 #include "server.h"
 #include "middleware.h"
@@ -13,11 +15,20 @@ int main() {
         c.res.text("Connection should stay open");
     });
 
+    // Resolved after the client below has shut down its sending side
+    app.get("/deferred", [](Context& c) {
+        std::thread([done = c.defer()] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            done.resolve([](Context& c) { c.res.text("Deferred after half-close"); });
+        }).detach();
+    });
+
     app.get("/close-me", [](Context& c) {
         c.res.header("Connection", "close");
         c.res.text("Goodbye");
     });
 
-    Server server(app, 3012);
+    // Short deadlines so test_routes.sh can watch slow and idle clients get cut off
+    Server server(app, 3012, Config().setHeaderTimeout(1).setTimeoutSeconds(2).setKeepAliveTimeout(2));
     server.listen();
 }
@@ -0,0 +1,39 @@
+#include <iostream>
+#include <string>
+
+#include "metro.h"
+#include "server.h"
+#include "metrics.h"
+#include "config.h"
+
+int main() {
+    using namespace Metro;
+
+    App app;
+    Metrics metrics;
+
+    // Shows up as "mw0" in the Server-Timing header
+    app.use([](Context& c, Next next) {
+        c.res.header("X-Observed", "true");
+        next();
+    });
+
+    app.get("/users/:id", [](Context& c) {
+        c.res.json({{"id", c.req.params("id")}});
+    });
+
+    app.get("/fail", [](Context&) {
+        throw std::runtime_error("boom");
+    });
+
+    // Prometheus scrape endpoint
+    app.get("/metrics", metrics.handler());
+
+    // Per-phase durations are echoed in a Server-Timing header
+    Config config;
+    config.enableServerTiming();
+
+    Server server(app, 3017, config);
+    server.setMetrics(metrics);
+    server.listen();
+}
@@ -8,6 +8,7 @@ int main() {
     using namespace Metro;
 
     App app;
+    app.use(Middlewares::asyncLogger());
     
     // Request ID middleware (adds header)
     app.use([](Context& c, Next next) {
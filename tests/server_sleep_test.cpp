@@ -12,11 +12,24 @@ int main() {
     App app;
     app.use(Middlewares::logger());
 
-    app.get("/echo", [](Context& c) {
+    // Runs on the blocking pool, so /fast keeps answering while it sleeps
+    app.route("/echo").blocking().get([](Context& c) {
         std::this_thread::sleep_for(std::chrono::seconds(1));
         c.res.text("GET OK");
     });
 
+    // Finished from another thread; meanwhile the connection is parked and holds no thread
+    app.get("/later", [](Context& c) {
+        std::thread([done = c.defer()] {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            done.resolve([](Context& c) { c.res.text("LATER OK"); });
+        }).detach();
+    });
+
+    app.get("/fast", [](Context& c) {
+        c.res.text("FAST OK");
+    });
+
     Server server(app, 3006);
     server.listen();
 }
@@ -0,0 +1,29 @@
+#include <iostream>
+#include <fstream>
+#include <sys/stat.h>
+
+#include "metro.h"
+#include "server.h"
+#include "middleware.h"
+
+int main() {
+    using namespace Metro;
+
+    // Create a small asset tree for testing
+    mkdir("/tmp/metro_static", 0755);
+    mkdir("/tmp/metro_static/docs", 0755);
+    std::ofstream("/tmp/metro_static/index.html") << "<h1>Home</h1>";
+    std::ofstream("/tmp/metro_static/app.js") << "console.log('identity');";
+    std::ofstream("/tmp/metro_static/app.js.gz") << "precompressed gzip bytes";
+    std::ofstream("/tmp/metro_static/docs/index.html") << "<h1>Docs</h1>";
+    std::ofstream("/tmp/metro_static/a%41.txt") << "literal percent";
+    std::ofstream("/tmp/metro_static/orphan.js.gz") << "sibling without identity";
+
+    App app;
+    app.use(Middlewares::logger());
+
+    app.serveStatic("/assets", "/tmp/metro_static", {"index.html", "public, max-age=60"});
+
+    Server server(app, 3013);
+    server.listen();
+}
@@ -1,5 +1,7 @@
+#include <chrono>
 #include <iostream>
 #include <fstream>
+#include <thread>
 #include "metro.h"
 #include "server.h"
 #include "middleware.h"
@@ -21,6 +23,34 @@ int main() {
         }, 0, "text/event-stream");
     });
 
+    // SSE with small-chunk coalescing and an explicit flush per event
+    app.get("/stream/sse-flush", [](Context& c) {
+        c.res.stream([](auto write) {
+            for (int i = 0; i < 3; ++i) {
+                std::string data = "event: tick\ndata: " + std::to_string(i) + "\n\n";
+                if (!write(data.c_str(), data.length())) return false;
+                if (!write.flush()) return false;
+            }
+            return true;
+        }, 0, "text/event-stream");
+    });
+
+    // Long-lived event stream: one tick every 100 ms until the client leaves
+    app.get("/stream/events", [](Context& c) {
+        c.res.eventStream([](auto write) {
+            for (int i = 0; ; ++i) {
+                std::string data = "data: tick " + std::to_string(i) + "\n\n";
+                if (!write(data.c_str(), data.length()) || !write.flush()) return false;
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        });
+    });
+
+    // Must still be served while event streams hold their threads
+    app.route("/stream/blocking").blocking().get([](Context& c) {
+        c.res.text("blocking route served");
+    });
+
     // Chunked text streaming
     app.get("/stream/chunks", [](Context& c) {
         c.res.stream([](auto write) {
@@ -48,6 +78,9 @@ int main() {
         c.res.file("/tmp/metro_test.txt", "text/plain");
     });
 
-    Server server(app, 3007);
+    Config config;
+    config.setStreamFlush(4096, 50); // Coalesce small chunks into fewer sends
+
+    Server server(app, 3007, config);
     server.listen();
 }
@@ -0,0 +1,45 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metro.h"
+#include "server.h"
+#include "health.h"
+#include "scheduler.h"
+
+int main() {
+    using namespace Metro;
+
+    App app;
+
+    app.get("/hello", [](Context& c) {
+        c.res.text("Hello from a worker");
+    });
+
+    // Fans out to four subtasks that idle workers can steal
+    app.get("/fanout/:n", [](Context& c) {
+        long n = std::stol(c.req.params("n"));
+        std::vector<long> partial(4, 0);
+
+        TaskGroup group;
+        for (size_t part = 0; part < partial.size(); ++part) {
+            group.spawn([&, part] {
+                for (long i = static_cast<long>(part); i <= n; i += 4) partial[part] += i;
+            });
+        }
+        group.wait();
+
+        long sum = 0;
+        for (long value : partial) sum += value;
+        c.res.json({{"n", n}, {"sum", sum}});
+    });
+
+    // Probes are answered on the I/O thread, never queued behind the workers
+    HealthCheck health;
+    health.liveness("GET /healthz");
+
+    Server server(app, 3018, Config().setWorkerThreads(4));
+    server.setHealthCheck(health);
+    server.listen();
+}
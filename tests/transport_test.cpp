@@ -0,0 +1,342 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metro.h"
+#include "testing.h"
+
+// Runs requests through HttpParser -> App -> HttpWriter without binding a port
+int main() {
+    using namespace Metro;
+
+    App app;
+
+    app.get("/users/:id", [](Context& c) {
+        c.res.json({{"id", c.req.params("id")}});
+    });
+
+    app.post("/echo", [](Context& c) {
+        c.res.text(c.req.text());
+    });
+
+    // Repeated query values, reported with the resource they were allocated from
+    app.get("/tags", [](Context& c) {
+        const auto& tags = c.req.queries("tag");
+        bool arena = tags.get_allocator().resource() != std::pmr::get_default_resource();
+        std::string out = arena ? "arena:" : "heap:";
+        for (const auto& tag : tags) {
+            arena = arena && tag.get_allocator() == tags.get_allocator();
+            out += tag;
+        }
+        c.res.text(arena ? out : "heap");
+    });
+
+    app.get("/stream", [](Context& c) {
+        c.res.stream([](auto write) {
+            write("Hello ", 6);
+            write("World", 5);
+            return true;
+        }, 0, "text/plain");
+    });
+
+    // Group and route middleware run only for the routes they were attached to
+    auto admin = app.group("/admin");
+    admin.use([](Context& c, Next next) {
+        if (!c.req.header("Authorization")) {
+            c.res.status(401).text("Unauthorized");
+            return;
+        }
+        next();
+    });
+    admin.get("/stats", [](Context& c) {
+        c.res.text("stats");
+    });
+
+    app.route("/tagged")
+        .use([](Context& c, Next next) {
+            c.res.header("X-Route", "tagged");
+            next();
+        })
+        .get([](Context& c) {
+            c.res.text("tagged");
+        });
+
+    // Blocking routes run on the server's pool, not the thread that parsed them
+    auto ioThread = std::this_thread::get_id();
+    app.route("/report").blocking().get([ioThread](Context& c) {
+        c.res.text(std::this_thread::get_id() == ioThread ? "inline" : "pool");
+    });
+
+    // Deferred responses are finished later, here from another thread
+    app.get("/later", [](Context& c) {
+        std::thread([done = c.defer()] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            done.resolve([](Context& c) { c.res.text("later"); });
+        }).detach();
+    });
+
+    app.get("/resolved-early", [](Context& c) {
+        Deferred done = c.defer();
+        done.resolve([](Context& c) { c.res.text("early"); });
+        bool again = done.resolve([](Context& c) { c.res.text("twice"); });
+        c.res.header("X-Again", again ? "yes" : "no");
+    });
+
+    app.get("/dropped", [](Context& c) {
+        c.defer();
+    });
+
+    // Kept but never resolved, so only the detached deadline answers it
+    std::vector<Deferred> forgotten;
+    app.get("/forgotten", [&forgotten](Context& c) {
+        forgotten.push_back(c.defer());
+    });
+
+    app.get("/deferred-error", [](Context& c) {
+        Deferred done = c.defer();
+        throw HttpError(409, "Conflict");
+    });
+
+    // Served through FileCache; rewritten in place below
+    const std::string cachedPath = "/tmp/metro_transport_" + std::to_string(getpid()) + ".txt";
+    auto writeFile = [](const std::string& path, const std::string& content) {
+        std::ofstream(path, std::ios::trunc) << content;
+    };
+    app.get("/cached", [cachedPath](Context& c) {
+        c.res.file(cachedPath);
+    });
+
+    HealthCheck health;
+    health.liveness("GET /healthz").readiness("GET /readyz");
+
+    TestClient client(app);
+    client.server().setHealthCheck(health);
+    int failures = 0;
+
+    auto expect = [&](const std::string& name, bool ok) {
+        std::cout << (ok ? "[PASS] " : "[FAIL] ") << name << "\n";
+        if (!ok) failures++;
+    };
+
+    auto user = client.get("/users/42");
+    expect("GET with params", user.status == 200 && user.body == "{\"id\":\"42\"}");
+
+    auto echo = client.post("/echo", "ping");
+    expect("POST body echo", echo.status == 200 && echo.body == "ping");
+
+    auto tags = client.get("/tags?tag=a&tag=" + std::string(40, 'b'));
+    expect("Query values in the request arena", tags.body == "arena:a" + std::string(40, 'b'));
+
+    // Path and query are percent-decoded exactly once
+    auto encodedParam = client.get("/users/100%2525");
+    auto encodedQuery = client.get("/tags?tag=a%26b");
+    expect("Percent-decoding once", encodedParam.body == "{\"id\":\"100%25\"}" && encodedQuery.body == "arena:a&b");
+
+    auto stream = client.get("/stream");
+    expect("Chunked stream", stream.status == 200 && stream.body == "Hello World");
+
+    auto missing = client.get("/missing");
+    expect("Unknown route", missing.status == 404);
+
+    auto wrongMethod = client.request("DELETE", "/echo");
+    expect("Wrong method", wrongMethod.status == 405 && wrongMethod.header("allow") == std::optional<std::string>("POST"));
+
+    auto malformed = TestClient::parse(client.send("BROKEN\r\n\r\n"));
+    expect("Malformed request line", malformed.status == 400);
+
+    auto badLength = client.request("POST", "/echo", "ping", {{"Content-Type", "text/plain"}, {"Content-Length", "4x"}});
+    expect("Invalid Content-Length", badLength.status == 400 && badLength.body == "Invalid Content-Length");
+
+    auto badJson = client.post("/echo", "{nope", "application/json");
+    expect("Malformed JSON body", badJson.status == 400 && badJson.body == "Malformed JSON body");
+
+    auto blocked = client.get("/admin/stats");
+    expect("Group middleware short-circuits", blocked.status == 401);
+
+    auto allowed = client.get("/admin/stats", {{"Authorization", "Bearer token"}});
+    expect("Group middleware passes", allowed.status == 200 && allowed.body == "stats");
+
+    auto tagged = client.get("/tagged");
+    expect("Route middleware", tagged.status == 200 && tagged.header("x-route") == std::optional<std::string>("tagged"));
+    expect("Route middleware stays scoped", !user.header("x-route"));
+
+    auto live = client.get("/healthz");
+    expect("Liveness probe", live.status == 200 && live.body == "OK");
+
+    health.setReady(false);
+    auto draining = client.get("/readyz?full=1");
+    health.setReady(true);
+    auto ready = client.get("/readyz");
+    expect("Readiness flag", draining.status == 503 && ready.status == 200);
+
+    auto nearMiss = client.get("/healthzz");
+    expect("Probe prefix is exact", nearMiss.status == 404);
+
+    auto report = client.get("/report");
+    expect("Blocking route", report.status == 200 && report.body == "pool");
+
+    auto later = client.get("/later");
+    expect("Deferred response", later.status == 200 && later.body == "later");
+
+    auto early = client.get("/resolved-early");
+    expect("Deferred resolved before return", early.body == "early" && early.header("x-again") == std::optional<std::string>("no"));
+
+    expect("Dropped deferred answers 500", client.get("/dropped").status == 500);
+    expect("Throw after defer", client.get("/deferred-error").status == 409);
+
+    // Requests pipelined in one write, a body among them, are all answered in order
+    std::string pipelined = client.send(
+        "GET /users/1 HTTP/1.1\r\nHost: localhost\r\n\r\n"
+        "POST /echo HTTP/1.1\r\nHost: localhost\r\nContent-Type: text/plain\r\nContent-Length: 4\r\n\r\npong"
+        "GET /users/2 HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    size_t first = pipelined.find("{\"id\":\"1\"}");
+    size_t second = pipelined.find("\r\n\r\npong");
+    size_t third = pipelined.find("{\"id\":\"2\"}");
+    expect("Pipelined requests", third != std::string::npos && first < second && second < third);
+
+    // Repeat opens share one entry; an in-place rewrite is served whole, with
+    // a matching length, once the watcher has dropped the stale entry
+    writeFile(cachedPath, "first version");
+    auto cached = client.get("/cached");
+    bool sharedEntry = FileCache::shared().open(cachedPath) == FileCache::shared().open(cachedPath);
+    expect("File cache hit", cached.status == 200 && cached.body == "first version" && sharedEntry);
+
+    writeFile(cachedPath, "second, longer version");
+    bool consistent = true;
+    for (int i = 0; i < 200 && cached.body != "second, longer version"; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        cached = client.get("/cached");
+        consistent = consistent && cached.header("content-length") == std::optional<std::string>(std::to_string(cached.body.size()));
+    }
+    expect("File cache invalidation", consistent && cached.body == "second, longer version");
+
+    // Two 22-byte snapshots do not fit a 32-byte budget, so the older one goes
+    {
+        const std::string otherPath = cachedPath + ".other";
+        writeFile(otherPath, "second, longer version");
+        FileCache::Options options;
+        options.snapshot_bytes = 32;
+        FileCache budgeted(options);
+        auto older = budgeted.open(cachedPath);
+        auto newer = budgeted.open(otherPath);
+        expect("File cache snapshot budget", older && newer && newer->snapshot && budgeted.size() == 1);
+        std::remove(otherPath.c_str());
+    }
+    std::remove(cachedPath.c_str());
+
+    TestClient saturated(app, Config().setBlockingPool(1, 0));
+    expect("Blocking pool overflow", saturated.get("/report").status == 503);
+
+    TestClient impatient(app, Config().setDetachedTimeout(1));
+    auto abandoned = impatient.get("/forgotten");
+    bool inert = !forgotten.back().resolve([](Context& c) { c.res.text("too late"); });
+    expect("Unresolved deferred times out", abandoned.status == 504 && inert);
+
+    // Past max_keep_alive_requests the server closes and the client reconnects
+    bool allOk = true;
+    for (int i = 0; i < 250; ++i) {
+        allOk = allOk && client.get("/users/" + std::to_string(i)).status == 200;
+    }
+    expect("Keep-alive reconnects", allOk);
+
+    // Connection deadlines: fired on time, in order, across cascades; cancelled ones never
+    {
+        using namespace std::chrono_literals;
+        TimerWheel::Clock::time_point t0{};
+        TimerWheel wheel(10ms, t0);
+        std::string fired;
+
+        TimerWheel::Entry header, body, idle;
+        header.callback = [&] { fired += "h"; };
+        body.callback = [&] { fired += "b"; };
+        idle.callback = [&] { fired += "i"; };
+
+        wheel.arm(header, 50ms, t0);
+        wheel.arm(body, 30s, t0);
+        wheel.arm(idle, 40ms, t0);
+        wheel.cancel(idle);
+
+        wheel.advance(t0 + 49ms);
+        bool early = fired.empty();
+        wheel.advance(t0 + 50ms);
+        bool onTime = fired == "h";
+        wheel.advance(t0 + 29999ms);
+        bool notYet = fired == "h" && wheel.size() == 1;
+        wheel.advance(t0 + 30s);
+        expect("Timer wheel deadlines", early && onTime && notYet && fired == "hb" && wheel.size() == 0);
+    }
+
+    // A callback that unwatches its own fd may still use its captures afterwards
+    {
+        EventLoop loop;
+        int fds[2];
+        if (pipe(fds) != 0) return 1;
+        struct { int fd; int calls = 0; bool drained = false; } pipeState{fds[0]};
+
+        loop.watch(fds[0], EPOLLIN, [&loop, &pipeState](uint32_t) {
+            loop.unwatch(pipeState.fd);
+            char byte;
+            pipeState.drained = read(pipeState.fd, &byte, 1) == 1;
+            pipeState.calls++;
+        });
+        if (write(fds[1], "x", 1) != 1) return 1;
+        loop.runUntil([&] { return pipeState.calls > 0; });
+
+        close(fds[0]);
+        close(fds[1]);
+        expect("Event loop unwatch from its own callback", pipeState.calls == 1 && pipeState.drained);
+    }
+
+    // A log file that cannot be reopened is retried without rotating; its records count as dropped
+    {
+        const std::string directory = "/tmp/metro_access_" + std::to_string(getpid());
+        mkdir(directory.c_str(), 0755);
+
+        AccessLog::Options options;
+        options.path = directory + "/access.log";
+        options.max_file_size = 1;
+        options.flush_interval_ms = 10;
+        AccessLog log(options);
+
+        auto settle = [&log](uint64_t total) {
+            for (int i = 0; i < 200 && log.written() + log.dropped() < total; ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        };
+
+        AccessLog::Record entry{};
+        entry.setMethod("GET");
+        entry.setPath("/lost");
+
+        // The rotation finds no directory to reopen the file in
+        std::remove(options.path.c_str());
+        rmdir(directory.c_str());
+        log.record(entry);
+        settle(1);
+        bool discarded = log.dropped() == 1 && log.written() == 0;
+
+        mkdir(directory.c_str(), 0755);
+        std::ofstream(options.path) << "kept\n";
+        entry.setPath("/kept");
+        log.record(entry);
+        settle(2);
+
+        std::ifstream file(options.path);
+        std::string first, second;
+        std::getline(file, first);
+        std::getline(file, second);
+        std::ifstream rotated(options.path + ".1");
+        expect("Access log reopen after a failed rotation",
+            discarded && log.written() == 1 && first == "kept" &&
+            second.find("/kept") != std::string::npos && !rotated);
+
+        std::remove(options.path.c_str());
+        rmdir(directory.c_str());
+    }
+
+    return failures == 0 ? 0 : 1;
+}
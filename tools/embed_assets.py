@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""
+Generate a C++ translation unit embedding a directory as a Metro::EmbeddedBundle.
+
+Every file becomes a constexpr byte array together with a strong content-hash
+ETag and precompressed variants (gzip always; brotli and zstd when the `brotli`
+/ `zstandard` modules are installed). A variant is only kept when it is
+meaningfully smaller than the original, which rules out already compressed
+formats such as PNG or WOFF2. Content types are not generated: EmbeddedFiles
+looks them up with Helpers::mimeType, the table StaticFiles uses.
+
+Usage:
+  tools/embed_assets.py <directory> <output.cpp> [--name ui_assets] [--namespace Assets]
+
+Declare the bundle where it is used and mount it:
+  namespace Assets { extern const Metro::EmbeddedBundle ui_assets; }
+  app.serveEmbedded("/ui", Assets::ui_assets);
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+import sys
+
+# Variants below this fraction of the original size are kept
+MIN_RATIO = 0.9
+
+
+def etag(data):
+    return '"' + hashlib.sha256(data).hexdigest()[:32] + '"'
+
+
+def compressors():
+    # Listed in server preference order
+    available = []
+
+    try:
+        import brotli
+        available.append(("br", lambda data: brotli.compress(data, quality=11)))
+    except ImportError:
+        pass
+
+    try:
+        import zstandard
+        available.append(("zstd", lambda data: zstandard.ZstdCompressor(level=19).compress(data)))
+    except ImportError:
+        pass
+
+    # mtime=0 keeps output reproducible across builds
+    available.append(("gzip", lambda data: gzip.compress(data, compresslevel=9, mtime=0)))
+    return available
+
+
+def byte_array(name, data):
+    lines = []
+    for offset in range(0, len(data), 16):
+        lines.append("    " + ", ".join("0x%02x" % b for b in data[offset:offset + 16]) + ",")
+    return "  alignas(16) constexpr unsigned char %s[] = {\n%s\n  };\n" % (name, "\n".join(lines))
+
+
+def cpp_string(value):
+    return '"' + value.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def collect(root):
+    files = []
+    for directory, subdirectories, names in os.walk(root):
+        subdirectories.sort()
+        for name in sorted(names):
+            full = os.path.join(directory, name)
+            relative = "/" + os.path.relpath(full, root).replace(os.sep, "/")
+            files.append((relative, full))
+    # EmbeddedBundle::find binary-searches with strcmp ordering
+    files.sort(key=lambda item: item[0].encode("utf-8"))
+    return files
+
+
+def generate(root, name, namespace):
+    out = []
+    out.append("// Generated by tools/embed_assets.py from %s. Do not edit.\n" % root)
+    out.append('#include "embedded.h"\n\n')
+    out.append("namespace {\n")
+
+    codecs = compressors()
+    entries = []
+
+    for index, (path, full) in enumerate(collect(root)):
+        with open(full, "rb") as handle:
+            data = handle.read()
+
+        symbol = "asset_%d" % index
+
+        if data:
+            out.append(byte_array(symbol, data))
+
+        variants = []
+        if data:
+            for coding, compress in codecs:
+                compressed = compress(data)
+                if len(compressed) >= len(data) * MIN_RATIO:
+                    continue
+                variant_symbol = "%s_%s" % (symbol, coding)
+                out.append(byte_array(variant_symbol, compressed))
+                variants.append((coding, variant_symbol, len(compressed), etag(compressed)))
+
+        if variants:
+            out.append("  constexpr Metro::EmbeddedVariant %s_variants[] = {\n" % symbol)
+            for coding, variant_symbol, size, tag in variants:
+                out.append("    {%s, %s, %d, %s},\n" % (cpp_string(coding), variant_symbol, size, cpp_string(tag)))
+            out.append("  };\n")
+
+        out.append("\n")
+        entries.append("    {%s, %s, %d, %s, %s, %d},\n" % (
+            cpp_string(path),
+            symbol if data else "nullptr",
+            len(data),
+            cpp_string(etag(data)),
+            symbol + "_variants" if variants else "nullptr",
+            len(variants),
+        ))
+
+    if entries:
+        out.append("  constexpr Metro::EmbeddedAsset assets[] = {\n")
+        out.extend(entries)
+        out.append("  };\n")
+    out.append("}\n\n")
+
+    assets = "assets" if entries else "nullptr"
+    definition = "extern const Metro::EmbeddedBundle %s;\nconst Metro::EmbeddedBundle %s = {%s, %d};\n" % (
+        name, name, assets, len(entries))
+
+    if namespace:
+        indented = "".join("  " + line + "\n" for line in definition.splitlines())
+        out.append("namespace %s {\n%s}\n" % (namespace, indented))
+    else:
+        out.append(definition)
+
+    return "".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Embed a directory as a Metro::EmbeddedBundle")
+    parser.add_argument("directory")
+    parser.add_argument("output")
+    parser.add_argument("--name", default="embedded_assets")
+    parser.add_argument("--namespace", default="")
+    args = parser.parse_args()
+
+    if not os.path.isdir(args.directory):
+        sys.exit("embed_assets: not a directory: " + args.directory)
+
+    source = generate(args.directory, args.name, args.namespace)
+
+    os.makedirs(os.path.dirname(os.path.abspath(args.output)), exist_ok=True)
+    with open(args.output, "w") as handle:
+        handle.write(source)
+
+
+if __name__ == "__main__":
+    main()